@@ -0,0 +1,192 @@
+#include "aArena.h"
+
+
+static usize aArena_classIdx(usize bytes)
+{
+	usize idx = 0;
+	for (usize sz = ATTO_ARENA_MIN_CLASS; sz < bytes; sz <<= 1)
+	{
+		++idx;
+	}
+	return idx;
+}
+static usize aArena_align(usize bytes)
+{
+	return (bytes + (ATTO_ARENA_MIN_CLASS - 1)) & ~(ATTO_ARENA_MIN_CLASS - 1);
+}
+static vptr aArena_bumpAlloc(aArena_t * restrict self, usize bytes)
+{
+	if ((usize)(self->bumpEnd - self->bump) < bytes)
+	{
+		// Remainder of old slab is abandoned, it's released on clear
+		const usize slabSize = sizeof(aArenaSlab_t) + ((bytes > ATTO_ARENA_SLAB_SIZE) ? bytes : ATTO_ARENA_SLAB_SIZE);
+		aArenaSlab_t * slab = malloc(slabSize);
+		if (slab == NULL)
+		{
+			return NULL;
+		}
+		slab->next   = self->slabs;
+		slab->u.size = slabSize;
+		self->slabs  = slab;
+		self->slabBytes += slabSize;
+
+		self->bump    = (u8 *)(slab + 1);
+		self->bumpEnd = (u8 *)slab + slabSize;
+	}
+
+	vptr mem = self->bump;
+	self->bump += bytes;
+	return mem;
+}
+
+void aArena_init(aArena_t * restrict self, usize nodeSize)
+{
+	*self = (aArena_t){
+		.slabs     = NULL,
+		.bump      = NULL,
+		.bumpEnd   = NULL,
+		.nodeSize  = aArena_align(nodeSize),
+		.freeNodes = NULL,
+		.bigs      = NULL
+	};
+}
+
+vptr aArena_allocNode(aArena_t * restrict self)
+{
+	if (self->freeNodes != NULL)
+	{
+		aArenaFree_t * node = self->freeNodes;
+		self->freeNodes = node->next;
+		return node;
+	}
+	return aArena_bumpAlloc(self, self->nodeSize);
+}
+void aArena_freeNode(aArena_t * restrict self, vptr node)
+{
+	if (node == NULL)
+	{
+		return;
+	}
+	aArenaFree_t * restrict f = node;
+	f->next = self->freeNodes;
+	self->freeNodes = f;
+}
+
+usize aArena_capacity(usize bytes)
+{
+	if (bytes > ATTO_ARENA_MAX_CLASS)
+	{
+		return aArena_align(bytes);
+	}
+	return ATTO_ARENA_MIN_CLASS << aArena_classIdx(bytes);
+}
+vptr aArena_alloc(aArena_t * restrict self, usize bytes, usize * restrict cap)
+{
+	const usize realCap = aArena_capacity(bytes);
+	if (cap != NULL)
+	{
+		*cap = realCap;
+	}
+
+	if (realCap > ATTO_ARENA_MAX_CLASS)
+	{
+		aArenaBig_t * big = malloc(sizeof(aArenaBig_t) + realCap);
+		if (big == NULL)
+		{
+			return NULL;
+		}
+		big->prev   = NULL;
+		big->next   = self->bigs;
+		big->u.size = realCap;
+		if (self->bigs != NULL)
+		{
+			self->bigs->prev = big;
+		}
+		self->bigs = big;
+		self->bigBytes += realCap;
+		return big + 1;
+	}
+
+	aArenaFree_t ** restrict list = &self->freeLists[aArena_classIdx(realCap)];
+	if (*list != NULL)
+	{
+		aArenaFree_t * mem = *list;
+		*list = mem->next;
+		return mem;
+	}
+	return aArena_bumpAlloc(self, realCap);
+}
+vptr aArena_realloc(aArena_t * restrict self, vptr mem, usize oldBytes, usize bytes, usize * restrict cap)
+{
+	if (mem == NULL)
+	{
+		return aArena_alloc(self, bytes, cap);
+	}
+	// Same class, nothing to do
+	if (aArena_capacity(bytes) == oldBytes)
+	{
+		if (cap != NULL)
+		{
+			*cap = oldBytes;
+		}
+		return mem;
+	}
+
+	vptr newmem = aArena_alloc(self, bytes, cap);
+	if (newmem == NULL)
+	{
+		return NULL;
+	}
+	memcpy(newmem, mem, (oldBytes < bytes) ? oldBytes : bytes);
+	aArena_free(self, mem, oldBytes);
+	return newmem;
+}
+void aArena_free(aArena_t * restrict self, vptr mem, usize bytes)
+{
+	if (mem == NULL)
+	{
+		return;
+	}
+
+	if (bytes > ATTO_ARENA_MAX_CLASS)
+	{
+		aArenaBig_t * restrict big = (aArenaBig_t *)mem - 1;
+		if (big->prev != NULL)
+		{
+			big->prev->next = big->next;
+		}
+		else
+		{
+			self->bigs = big->next;
+		}
+		if (big->next != NULL)
+		{
+			big->next->prev = big->prev;
+		}
+		self->bigBytes -= big->u.size;
+		free(big);
+		return;
+	}
+
+	aArenaFree_t * restrict f = mem;
+	aArenaFree_t ** restrict list = &self->freeLists[aArena_classIdx(bytes)];
+	f->next = *list;
+	*list   = f;
+}
+
+void aArena_clear(aArena_t * restrict self)
+{
+	for (aArenaSlab_t * slab = self->slabs; slab != NULL;)
+	{
+		aArenaSlab_t * next = slab->next;
+		free(slab);
+		slab = next;
+	}
+	for (aArenaBig_t * big = self->bigs; big != NULL;)
+	{
+		aArenaBig_t * next = big->next;
+		free(big);
+		big = next;
+	}
+	aArena_init(self, self->nodeSize);
+}
@@ -0,0 +1,135 @@
+#ifndef ATTO_ARENA_H
+#define ATTO_ARENA_H
+
+#include "aCommon.h"
+
+/*
+	Document-scoped allocator. Memory is carved from big slabs, freed
+	blocks are kept in per-size-class free lists and everything is
+	released at once with aArena_clear.
+
+	Size classes are powers of 2 from ATTO_ARENA_MIN_CLASS up to
+	ATTO_ARENA_MAX_CLASS bytes, bigger blocks are allocated separately
+	(still tracked by the arena). Line nodes have their own exact-size class.
+*/
+
+#define ATTO_ARENA_SLAB_SIZE   (64 * 1024)
+#define ATTO_ARENA_MIN_SHIFT   4
+#define ATTO_ARENA_MAX_SHIFT   12
+#define ATTO_ARENA_MIN_CLASS   ((usize)1 << ATTO_ARENA_MIN_SHIFT)
+#define ATTO_ARENA_MAX_CLASS   ((usize)1 << ATTO_ARENA_MAX_SHIFT)
+#define ATTO_ARENA_NUM_CLASSES (ATTO_ARENA_MAX_SHIFT - ATTO_ARENA_MIN_SHIFT + 1)
+
+typedef struct aArenaFree
+{
+	struct aArenaFree * next;
+
+} aArenaFree_t;
+
+typedef struct aArenaBig
+{
+	struct aArenaBig * prev, * next;
+	// Keeps payload aligned the same way as malloc
+	union
+	{
+		usize size;
+		f128 align;
+	} u;
+
+} aArenaBig_t;
+
+typedef struct aArenaSlab
+{
+	struct aArenaSlab * next;
+	union
+	{
+		usize size;
+		f128 align;
+	} u;
+
+} aArenaSlab_t;
+
+typedef struct aArena
+{
+	aArenaSlab_t * slabs;
+	u8 * bump, * bumpEnd;
+
+	usize nodeSize;
+	aArenaFree_t * freeNodes;
+	aArenaFree_t * freeLists[ATTO_ARENA_NUM_CLASSES];
+
+	aArenaBig_t * bigs;
+
+	// Statistics
+	usize slabBytes, bigBytes;
+
+} aArena_t;
+
+/**
+ * @brief Initialises empty arena
+ *
+ * @param self Pointer to aArena_t structure
+ * @param nodeSize Size of a single node in bytes, used by aArena_allocNode
+ */
+void aArena_init(aArena_t * restrict self, usize nodeSize);
+
+/**
+ * @brief Allocates a single node
+ *
+ * @param self Pointer to aArena_t structure
+ * @return vptr Pointer to node memory, NULL on failure
+ */
+vptr aArena_allocNode(aArena_t * restrict self);
+/**
+ * @brief Returns a node back to the arena
+ *
+ * @param self Pointer to aArena_t structure
+ * @param node Pointer to node memory, can be NULL
+ */
+void aArena_freeNode(aArena_t * restrict self, vptr node);
+
+/**
+ * @brief Allocates memory block, size is rounded up to the size class
+ *
+ * @param self Pointer to aArena_t structure
+ * @param bytes Requested size in bytes
+ * @param cap Address of actual usable block size in bytes, can be NULL
+ * @return vptr Pointer to block, NULL on failure
+ */
+vptr aArena_alloc(aArena_t * restrict self, usize bytes, usize * restrict cap);
+/**
+ * @brief Resizes memory block, contents are preserved up to the smaller size
+ *
+ * @param self Pointer to aArena_t structure
+ * @param mem Pointer to block, can be NULL
+ * @param oldBytes Usable size of old block in bytes, as received from cap
+ * @param bytes Requested size in bytes
+ * @param cap Address of actual usable block size in bytes, can be NULL
+ * @return vptr Pointer to block, NULL on failure, old block is left untouched
+ */
+vptr aArena_realloc(aArena_t * restrict self, vptr mem, usize oldBytes, usize bytes, usize * restrict cap);
+/**
+ * @brief Returns memory block back to the arena
+ *
+ * @param self Pointer to aArena_t structure
+ * @param mem Pointer to block, can be NULL
+ * @param bytes Usable size of block in bytes, as received from cap
+ */
+void aArena_free(aArena_t * restrict self, vptr mem, usize bytes);
+/**
+ * @brief Calculates usable size of a block for a requested size
+ *
+ * @param bytes Requested size in bytes
+ * @return usize Usable size in bytes
+ */
+usize aArena_capacity(usize bytes);
+
+/**
+ * @brief Releases all memory at once, every pointer received from arena
+ * becomes invalid
+ *
+ * @param self Pointer to aArena_t structure
+ */
+void aArena_clear(aArena_t * restrict self);
+
+#endif
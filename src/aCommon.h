@@ -1,14 +1,21 @@
 #ifndef ATTO_COMMON_H
 #define ATTO_COMMON_H
 
-#define WIN32_LEAN_AND_MEAN
-#define WIN32_EXTRA_LEAN
-#define NOMINMAX
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define WIN32_EXTRA_LEAN
+	#define NOMINMAX
+
+	#include <windows.h>
+#else
+	// Platform-independent modules can be built & tested headlessly elsewhere
+	#include <sys/types.h>
+#endif
 
-#include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <wchar.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <assert.h>
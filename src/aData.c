@@ -7,14 +7,39 @@ void aData_reset(aData_t * restrict self)
 	*self = (aData_t){
 		.conIn  = INVALID_HANDLE_VALUE,
 		.conOut = INVALID_HANDLE_VALUE,
+		.screen = {
+			.backend = NULL,
+			.conOut  = INVALID_HANDLE_VALUE,
+			.handle  = INVALID_HANDLE_VALUE,
+			.out     = NULL
+		},
 		.scrbuf = {
-			.handle = INVALID_HANDLE_VALUE,
-			.mem    = NULL,
-			.w      = 0,
-			.h      = 0
+			.mem       = NULL,
+			.shown     = NULL,
+			.attr      = NULL,
+			.shownAttr = NULL,
+			.w         = 0,
+			.h         = 0
+		},
+		.cursorpos = { 0, 0 },
+		.drawn     = {
+			.pcury = NULL,
+			.curx  = 0,
+			.gen   = 0,
+			.valid = false
 		},
-		.cursorpos = { 0, 0 }
+		.find = {
+			.useRegex = false,
+			.error    = NULL,
+			.len      = 0,
+			.active   = false,
+			.show     = false,
+			.line     = 0,
+			.col      = 0
+		}
 	};
+	aFind_init(&self->find.needle);
+	aRegex_init(&self->find.regex);
 	aFile_reset(&self->file);
 }
 bool aData_init(aData_t * restrict self)
@@ -33,63 +58,106 @@ bool aData_init(aData_t * restrict self)
 
 	self->scrbuf.w = (u32)(csbi.srWindow.Right  - csbi.srWindow.Left + 1);
 	self->scrbuf.h = (u32)(csbi.srWindow.Bottom - csbi.srWindow.Top  + 1);
-	// Create screen buffer
-	self->scrbuf.handle = CreateConsoleScreenBuffer(
-		GENERIC_WRITE,
-		0,
-		NULL,
-		CONSOLE_TEXTMODE_BUFFER,
-		NULL
-	);
-	if (self->scrbuf.handle == INVALID_HANDLE_VALUE)
-	{
-		return false;
-	}
-
-	self->scrbuf.mem = malloc((usize)self->scrbuf.w * (usize)self->scrbuf.h * sizeof(wchar));
-	if (self->scrbuf.mem == NULL)
+	self->scrbuf.mem   = malloc((usize)self->scrbuf.w * (usize)self->scrbuf.h * sizeof(wchar));
+	self->scrbuf.shown = malloc((usize)self->scrbuf.w * (usize)self->scrbuf.h * sizeof(wchar));
+	self->scrbuf.attr      = calloc((usize)self->scrbuf.w * (usize)self->scrbuf.h, sizeof(u8));
+	self->scrbuf.shownAttr = calloc((usize)self->scrbuf.w * (usize)self->scrbuf.h, sizeof(u8));
+	if ((self->scrbuf.mem == NULL) || (self->scrbuf.shown == NULL) ||
+		(self->scrbuf.attr == NULL) || (self->scrbuf.shownAttr == NULL))
 	{
 		return false;
 	}
 
+	// New screen buffer is blank
 	for (usize i = 0, sz = (usize)self->scrbuf.w * (usize)self->scrbuf.h; i < sz; ++i)
 	{
-		self->scrbuf.mem[i] = L' ';
+		self->scrbuf.mem[i]   = L' ';
+		self->scrbuf.shown[i] = L' ';
 	}
-	if (!SetConsoleScreenBufferSize(self->scrbuf.handle, (COORD){ .X = (SHORT)self->scrbuf.w, .Y = (SHORT)self->scrbuf.h }))
+
+	// Console backend is the fallback, if the chosen one can't be used
+	const aScreenBackend_t * backend = aScreen_pick();
+	if (aScreen_init(&self->screen, backend, self->conOut, self->scrbuf.w, self->scrbuf.h))
 	{
-		return false;
+		return true;
 	}
-	if (!SetConsoleActiveScreenBuffer(self->scrbuf.handle))
+	return (backend != &aScreen_console) && aScreen_init(&self->screen, &aScreen_console, self->conOut, self->scrbuf.w, self->scrbuf.h);
+}
+static void aData_writeRows(aData_t * restrict self, u32 from, u32 to)
+{
+	// Changed cells of a row are written in runs, runs are split only by
+	// at least ATTO_SCREEN_GAP unchanged cells
+	const usize w = self->scrbuf.w;
+	for (u32 y = from; y < to; ++y)
 	{
-		return false;
-	}
+		const wchar * restrict row = self->scrbuf.mem + (usize)y * w;
+		wchar * restrict shown = self->scrbuf.shown + (usize)y * w;
+		const u8 * restrict attr = self->scrbuf.attr + (usize)y * w;
+		u8 * restrict shownAttr = self->scrbuf.shownAttr + (usize)y * w;
+		for (usize x = 0; x < w;)
+		{
+			while ((x < w) && (row[x] == shown[x]) && (attr[x] == shownAttr[x]))
+			{
+				++x;
+			}
+			if (x == w)
+			{
+				break;
+			}
+			usize end = x + 1, same = 0;
+			for (usize i = end; (i < w) && (same < ATTO_SCREEN_GAP); ++i)
+			{
+				if ((row[i] == shown[i]) && (attr[i] == shownAttr[i]))
+				{
+					++same;
+				}
+				else
+				{
+					end = i + 1;
+					same = 0;
+				}
+			}
+
+			// Attributes are sent only if some cell isn't or wasn't normal
+			bool plain = true;
+			for (usize i = x; plain && (i < end); ++i)
+			{
+				plain = (attr[i] == asaNORMAL) && (shownAttr[i] == asaNORMAL);
+			}
 
-	return true;
+			aScreen_put(&self->screen, (u32)x, y, row + x, plain ? NULL : (attr + x), end - x);
+			memcpy(shown + x, row + x, sizeof(wchar) * (end - x));
+			memcpy(shownAttr + x, attr + x, sizeof(u8) * (end - x));
+			x = end;
+		}
+	}
+}
+static void aData_flush(aData_t * restrict self)
+{
+	aScreen_flush(&self->screen, (u32)self->cursorpos.X, (u32)self->cursorpos.Y);
+}
+void aData_invalidate(aData_t * restrict self)
+{
+	self->drawn.valid = false;
 }
 void aData_refresh(aData_t * restrict self)
 {
 	atto_updateScrbuf(self);
-	DWORD dwBytes;
-	WriteConsoleOutputCharacterW(
-		self->scrbuf.handle,
-		self->scrbuf.mem,
-		(DWORD)((usize)self->scrbuf.w * (usize)(self->scrbuf.h - 1)),
-		(COORD){ 0, 0 },
-		&dwBytes
-	);
+	aData_writeRows(self, 0, self->scrbuf.h - 1);
+	aData_flush(self);
 }
 void aData_refreshAll(aData_t * restrict self)
 {
+	aData_invalidate(self);
 	atto_updateScrbuf(self);
-	DWORD dwBytes;
-	WriteConsoleOutputCharacterW(
-		self->scrbuf.handle,
-		self->scrbuf.mem,
-		(DWORD)((usize)self->scrbuf.w * (usize)self->scrbuf.h),
-		(COORD){ 0, 0 },
-		&dwBytes
-	);
+	const usize w = self->scrbuf.w;
+	for (u32 y = 0; y < self->scrbuf.h; ++y)
+	{
+		aScreen_put(&self->screen, 0, y, self->scrbuf.mem + (usize)y * w, self->scrbuf.attr + (usize)y * w, w);
+	}
+	memcpy(self->scrbuf.shown, self->scrbuf.mem, sizeof(wchar) * w * (usize)self->scrbuf.h);
+	memcpy(self->scrbuf.shownAttr, self->scrbuf.attr, sizeof(u8) * w * (usize)self->scrbuf.h);
+	aData_flush(self);
 }
 void aData_statusDraw(aData_t * restrict self, const wchar * restrict message)
 {
@@ -108,14 +176,8 @@ void aData_statusDraw(aData_t * restrict self, const wchar * restrict message)
 }
 void aData_statusRefresh(aData_t * restrict self)
 {
-	DWORD dwBytes;
-	WriteConsoleOutputCharacterW(
-		self->scrbuf.handle,
-		self->scrbuf.mem + (usize)(self->scrbuf.h - 1) * (usize)self->scrbuf.w,
-		(DWORD)self->scrbuf.w,
-		(COORD){ .X = 0, .Y = (SHORT)(self->scrbuf.h - 1) },
-		&dwBytes
-	);
+	aData_writeRows(self, self->scrbuf.h - 1, self->scrbuf.h);
+	aData_flush(self);
 }
 
 void aData_destroy(aData_t * restrict self)
@@ -125,9 +187,17 @@ void aData_destroy(aData_t * restrict self)
 		free(self->scrbuf.mem);
 		self->scrbuf.mem = NULL;
 	}
-	if (self->scrbuf.handle != INVALID_HANDLE_VALUE)
+	if (self->scrbuf.shown != NULL)
 	{
-		SetConsoleActiveScreenBuffer(self->conOut);
+		free(self->scrbuf.shown);
+		self->scrbuf.shown = NULL;
 	}
+	free(self->scrbuf.attr);
+	self->scrbuf.attr = NULL;
+	free(self->scrbuf.shownAttr);
+	self->scrbuf.shownAttr = NULL;
+	aFind_destroy(&self->find.needle);
+	aRegex_destroy(&self->find.regex);
+	aScreen_destroy(&self->screen);
 	aFile_destroy(&self->file);
 }
@@ -3,18 +3,44 @@
 
 #include "aCommon.h"
 #include "aFile.h"
+#include "aScreen.h"
 
 
 typedef struct aData
 {
 	HANDLE conIn, conOut;
+	aScreen_t screen;
 	struct
 	{
-		HANDLE handle;
-		wchar * mem;
+		// Frame being drawn & frame on the console, only cells that differ are written
+		wchar * mem, * shown;
+		// Cell attributes, aScreenAttr_e values
+		u8 * attr, * shownAttr;
 		u32 w, h;
 	} scrbuf;
 	COORD cursorpos;
+	// View & file generation of the last drawn frame, see atto_updateScrbuf
+	struct
+	{
+		const aLine_t * pcury;
+		usize curx, gen;
+		bool valid;
+	} drawn;
+	// Incremental find, see atto_find
+	struct
+	{
+		aFind_t needle;
+		// Query is a regular expression, error of compiling it
+		aRegex_t regex;
+		bool useRegex;
+		const wchar * error;
+		wchar query[ATTO_FIND_MAX];
+		usize len;
+		// Typing query, matches are highlighted
+		bool active, show;
+		// Cursor position find started from
+		usize line, col;
+	} find;
 
 	aFile_t file;
 
@@ -35,13 +61,20 @@ void aData_reset(aData_t * restrict self);
  */
 bool aData_init(aData_t * restrict self);
 /**
- * @brief Refreshes the screen's editing part only
+ * @brief Makes the next refresh draw every line again, needed for changes
+ * that don't bump the file's generation, like loading
+ * 
+ * @param self Pointer to aData_t structure
+ */
+void aData_invalidate(aData_t * restrict self);
+/**
+ * @brief Refreshes the screen's editing part only, writes changed cells
  * 
  * @param self Pointer to aData_t structure
  */
 void aData_refresh(aData_t * restrict self);
 /**
- * @brief Refreshes whole screen
+ * @brief Refreshes whole screen, writes every cell
  * 
  * @param self Pointer to aData_t structure
  */
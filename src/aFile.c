@@ -1,46 +1,90 @@
 #include "aFile.h"
 #include "atto.h"
+#include "aProf.h"
+#include "aUtf.h"
+#include "aThread.h"
+#include "aSave.h"
 
+// Marks column map checkpoints, which point to the middle of a surrogate pair
+#define ATTO_U8MAP_MID ((u32)1 << 31)
 
-aLine_t * aLine_create(aLine_t * restrict curnode, aLine_t * restrict nextnode)
+// Tab stop cache of lines without tabs, shared
+static u32 aLine_noTabs[1] = { 0 };
+
+
+static usize aLine_len(const aLine_t * restrict self)
+{
+	return self->lineEndx - self->freeSpaceLen;
+}
+static void aLine_dropTabs(aArena_t * restrict arena, aLine_t * restrict self)
+{
+	if ((self->tabs != NULL) && (self->tabs != aLine_noTabs))
+	{
+		aArena_free(arena, self->tabs, sizeof(u32) * (1 + 2 * (usize)self->tabs[0]));
+	}
+	self->tabs = NULL;
+}
+static void aLine_attachIdx(aLine_t * restrict node)
+{
+	aLineIdx_init(&node->idx, aLine_len(node));
+	if ((node->prevNode != NULL) && aLineIdx_attached(&node->prevNode->idx))
+	{
+		aLineIdx_setChars(&node->prevNode->idx, aLine_len(node->prevNode));
+		aLineIdx_insertAfter(&node->prevNode->idx, &node->idx);
+	}
+	else if ((node->nextNode != NULL) && aLineIdx_attached(&node->nextNode->idx))
+	{
+		aLineIdx_insertBefore(&node->nextNode->idx, &node->idx);
+	}
+}
+
+static wchar * aLine_allocLine(aArena_t * restrict arena, usize chars, usize * restrict lineEndx)
+{
+	usize cap;
+	wchar * mem = aArena_alloc(arena, sizeof(wchar) * chars, &cap);
+	*lineEndx = cap / sizeof(wchar);
+	return mem;
+}
+
+aLine_t * aLine_create(aArena_t * restrict arena, aLine_t * restrict curnode, aLine_t * restrict nextnode)
 {
-	aLine_t * node = malloc(sizeof(aLine_t));
+	aLine_t * node = aArena_allocNode(arena);
 	if (node == NULL)
 	{
 		return NULL;
 	}
 
-	if (curnode != NULL)
+	// Create normal empty line
+	if ((curnode == NULL) || ((curnode->curx + curnode->freeSpaceLen) == curnode->lineEndx))
 	{
-		// Create normal empty line
-		if ((curnode->curx + curnode->freeSpaceLen) == curnode->lineEndx)
+		node->line = aLine_allocLine(arena, ATTO_LNODE_DEFAULT_FREE, &node->lineEndx);
+		if (node->line == NULL)
 		{
-			node->line = malloc(sizeof(wchar) * ATTO_LNODE_DEFAULT_FREE);
-			if (node->line == NULL)
-			{
-				free(node);
-				return NULL;
-			}
-			node->lineEndx = ATTO_LNODE_DEFAULT_FREE;
+			aArena_freeNode(arena, node);
+			return NULL;
 		}
-		// Copy contents after cursor to this line
-		else
+		node->freeSpaceLen = node->lineEndx;
+	}
+	// Copy contents after cursor to this line
+	else
+	{
+		const usize contStart = curnode->curx + curnode->freeSpaceLen, contLen = curnode->lineEndx - contStart;
+		node->line = aLine_allocLine(arena, contLen + ATTO_LNODE_DEFAULT_FREE, &node->lineEndx);
+		if (node->line == NULL)
 		{
-			const usize contStart = curnode->curx + curnode->freeSpaceLen, contLen = curnode->lineEndx - contStart;
-			node->lineEndx = contLen + ATTO_LNODE_DEFAULT_FREE;
-			node->line = malloc(sizeof(wchar) * node->lineEndx);
-			if (node->line == NULL)
-			{
-				free(node);
-				return NULL;
-			}
-			memcpy(node->line + ATTO_LNODE_DEFAULT_FREE, curnode->line + contStart, sizeof(wchar) * contLen);
-			curnode->freeSpaceLen += contLen;
+			aArena_freeNode(arena, node);
+			return NULL;
 		}
+		node->freeSpaceLen = node->lineEndx - contLen;
+		memcpy(node->line + node->freeSpaceLen, curnode->line + contStart, sizeof(wchar) * contLen);
+		curnode->freeSpaceLen += contLen;
+		aLine_dropTabs(arena, curnode);
 	}
 
 	node->curx = 0;
-	node->freeSpaceLen = ATTO_LNODE_DEFAULT_FREE;
+	node->u8   = NULL;
+	node->u8len = 0;
+	node->tabs = NULL;
 	node->prevNode = curnode;
 	node->nextNode = nextnode;
 	if (curnode != NULL)
@@ -51,11 +95,13 @@ aLine_t * aLine_create(aLine_t * restrict curnode, aLine_t * restrict nextnode)
 	{
 		nextnode->prevNode = node;
 	}
+	aLine_attachIdx(node);
 
 	return node;
 }
 
 aLine_t * aLine_createText(
+	aArena_t * restrict arena,
 	aLine_t * restrict curnode,
 	aLine_t * restrict nextnode,
 	const wchar * restrict lineText,
@@ -64,24 +110,26 @@ aLine_t * aLine_createText(
 {
 	const usize maxText = mText == -1 ? wcslen(lineText) : (usize)mText;
 
-	aLine_t * node = malloc(sizeof(aLine_t));
+	aLine_t * node = aArena_allocNode(arena);
 	if (node == NULL)
 	{
 		return NULL;
 	}
 
-	node->lineEndx = maxText + ATTO_LNODE_DEFAULT_FREE;
-	node->line = malloc(sizeof(wchar) * node->lineEndx);
+	node->line = aLine_allocLine(arena, maxText + ATTO_LNODE_DEFAULT_FREE, &node->lineEndx);
 	if (node->line == NULL)
 	{
-		free(node);
+		aArena_freeNode(arena, node);
 		return NULL;
 	}
 	
 	memcpy(node->line, lineText, sizeof(wchar) * maxText);
 
 	node->curx = maxText;
-	node->freeSpaceLen = ATTO_LNODE_DEFAULT_FREE;
+	node->freeSpaceLen = node->lineEndx - maxText;
+	node->u8   = NULL;
+	node->u8len = 0;
+	node->tabs = NULL;
 
 	node->prevNode = curnode;
 	node->nextNode = nextnode;
@@ -93,701 +141,3389 @@ aLine_t * aLine_createText(
 	{
 		nextnode->prevNode = node;
 	}
+	aLine_attachIdx(node);
+
 	return node;
 }
 
-bool aLine_getText(const aLine_t * restrict self, wchar ** restrict text, usize * restrict tarrsz)
+static usize aLine_mapLen(const aLine_t * restrict self)
 {
-	const usize totalLen = self->lineEndx - self->freeSpaceLen + 1;
-
-	if ((tarrsz != NULL) && (*tarrsz < totalLen))
+	// Pure ASCII lines map columns 1:1 to bytes
+	return (self->u8len == self->lineEndx) ? 0 : (self->lineEndx / ATTO_U8MAP_STEP);
+}
+static usize aLine_packedSize(const aLine_t * restrict self)
+{
+	const usize aligned = (self->u8len + (sizeof(u32) - 1)) & ~(sizeof(u32) - 1);
+	return aligned + sizeof(u32) * aLine_mapLen(self);
+}
+static u32 * aLine_map(const aLine_t * restrict self)
+{
+	return (u32 *)(vptr)(self->u8 + (aLine_packedSize(self) - sizeof(u32) * aLine_mapLen(self)));
+}
+static void aLine_buildMap(aLine_t * restrict self)
+{
+	const usize mapLen = aLine_mapLen(self);
+	u32 * restrict map = aLine_map(self);
+	usize col = 0, pos = 0, k = 0;
+	wchar tmp[2];
+	while ((pos < self->u8len) && (k < mapLen))
 	{
-		wchar * mem = realloc(*text, sizeof(wchar) * totalLen);
-		if (mem == NULL)
+		const usize start = pos;
+		const usize units = aUtf_decodeCh(self->u8, self->u8len, &pos, tmp);
+		for (; (k < mapLen) && (((k + 1) * ATTO_U8MAP_STEP) < (col + units)); ++k)
 		{
-			return false;
+			map[k] = (u32)start | ((((k + 1) * ATTO_U8MAP_STEP) != col) ? ATTO_U8MAP_MID : 0);
 		}
-		*text   = mem;
-		*tarrsz = totalLen;
+		col += units;
 	}
-	else if (tarrsz == NULL)
+	for (; k < mapLen; ++k)
 	{
-		*text = malloc(sizeof(wchar) * totalLen);
-		if (*text == NULL)
-		{
-			return false;
-		}
+		map[k] = (u32)self->u8len;
+	}
+}
+static usize aLine_u8Seek(const aLine_t * restrict self, usize col, usize * restrict startCol)
+{
+	if (self->u8len == self->lineEndx)
+	{
+		*startCol = (col < self->u8len) ? col : self->u8len;
+		return *startCol;
 	}
 
-	wchar * restrict t = *text;
-	for (usize i = 0; i < self->lineEndx;)
+	const usize k = min_usize(col / ATTO_U8MAP_STEP, aLine_mapLen(self));
+	usize pos = 0, c = 0;
+	if (k > 0)
+	{
+		const u32 v = aLine_map(self)[k - 1];
+		pos = (usize)(v & ~ATTO_U8MAP_MID);
+		c   = k * ATTO_U8MAP_STEP - ((v & ATTO_U8MAP_MID) ? 1 : 0);
+	}
+	// Walk to the code point containing the column
+	wchar tmp[2];
+	while (pos < self->u8len)
 	{
-		if (i == self->curx)
+		usize next = pos;
+		const usize units = aUtf_decodeCh(self->u8, self->u8len, &next, tmp);
+		if ((c + units) > col)
 		{
-			i += self->freeSpaceLen;
-			continue;
+			break;
 		}
-
-		*t = self->line[i];
-		++t;
-		++i;
+		c  += units;
+		pos = next;
 	}
-	*t = L'\0';
-
-	return true;
+	*startCol = c;
+	return pos;
 }
-
-bool aLine_realloc(aLine_t * restrict self)
+static bool aLine_setU8(aArena_t * restrict arena, aLine_t * restrict self, usize u8len, usize cols)
 {
-	if (self->freeSpaceLen == ATTO_LNODE_DEFAULT_FREE)
-	{
-		return true;
-	}
-	const usize totalLen = self->lineEndx - self->freeSpaceLen;
-	vptr newmem = realloc(self->line, sizeof(wchar) * (totalLen + ATTO_LNODE_DEFAULT_FREE));
-	if (newmem == NULL)
+	self->u8len    = u8len;
+	self->lineEndx = cols;
+	// Offsets of the column map are 32-bit
+	if ((aLine_mapLen(self) > 0) && (u8len >= (usize)ATTO_U8MAP_MID))
 	{
+		self->u8len = 0;
 		return false;
 	}
-	self->line = newmem;
-	if (self->curx < totalLen)
-	{
-		memmove(
-			self->line + self->curx + ATTO_LNODE_DEFAULT_FREE,
-			self->line + self->curx + self->freeSpaceLen,
-			sizeof(wchar) * (totalLen - self->curx)
-		);
-	}
-
-	self->lineEndx     = totalLen + ATTO_LNODE_DEFAULT_FREE;
-	self->freeSpaceLen = ATTO_LNODE_DEFAULT_FREE;
-
-	return true;
+	self->u8 = aArena_alloc(arena, aLine_packedSize(self), NULL);
+	return self->u8 != NULL;
 }
 
-bool aLine_mergeNext(aLine_t * restrict self, aLine_t ** restrict ppcury)
+aLine_t * aLine_createU8(
+	aArena_t * restrict arena,
+	aLine_t * restrict curnode,
+	aLine_t * restrict nextnode,
+	const char * restrict bytes,
+	usize len
+)
 {
-	if (self->nextNode == NULL)
+	aLine_t * node = aArena_allocNode(arena);
+	if (node == NULL)
 	{
-		return false;
+		return NULL;
 	}
-	
-	aLine_t * restrict n = self->nextNode;
-	*ppcury = (*ppcury == n) ? self : *ppcury;
 
-	// Allocate more memory for first line
-	vptr linemem = realloc(
-		self->line,
-		sizeof(wchar) * (self->lineEndx - self->freeSpaceLen + n->lineEndx - n->freeSpaceLen + ATTO_LNODE_DEFAULT_FREE)
-	);
-	if (linemem == NULL)
+	node->line = NULL;
+	if (!aLine_setU8(arena, node, len, aUtf_wLen(bytes, len)))
 	{
-		return false;
+		aArena_freeNode(arena, node);
+		return NULL;
 	}
-	self->line = linemem;
-
-	// Move cursor to end, if needed
-	aLine_moveCursor(self, (isize)self->lineEndx);
-	aLine_moveCursor(n,    (isize)n->lineEndx);
-
-	self->freeSpaceLen = ATTO_LNODE_DEFAULT_FREE;
-	self->lineEndx     = self->curx + n->curx + ATTO_LNODE_DEFAULT_FREE;
-
-	memcpy(self->line + self->curx + self->freeSpaceLen, n->line, sizeof(wchar) * n->curx);
-	self->nextNode = n->nextNode;
-	if (self->nextNode != NULL)
+	if (len > 0)
 	{
-		self->nextNode->prevNode = self;
+		memcpy(node->u8, bytes, len);
 	}
-	aLine_destroy(n); 
-
-	return true;
-}
+	aLine_buildMap(node);
+	node->curx = node->lineEndx;
+	node->freeSpaceLen = 0;
+	// Most lines have no tabs at all, so they never need a cache
+	node->tabs = ((len > 0) && (memchr(bytes, '\t', len) != NULL)) ? NULL : aLine_noTabs;
 
-void aLine_moveCursor(aLine_t * restrict self, isize delta)
-{
-	if (delta < 0)
+	node->prevNode = curnode;
+	node->nextNode = nextnode;
+	if (curnode != NULL)
 	{
-		for (usize idx = self->curx + self->freeSpaceLen; delta < 0 && self->curx > 0; ++delta)
-		{
-			--idx;
-			--self->curx;
-			self->line[idx] = self->line[self->curx];
-		}
+		curnode->nextNode  = node;
 	}
-	else
+	if (nextnode != NULL)
 	{
-		for (usize total = self->lineEndx - self->freeSpaceLen, idx = self->curx + self->freeSpaceLen; delta > 0 && self->curx < total; --delta)
-		{
-			self->line[self->curx] = self->line[idx];
-			++idx;
-			++self->curx;
-		}
+		nextnode->prevNode = node;
 	}
-}
+	aLine_attachIdx(node);
 
-void aLine_destroy(aLine_t * restrict self)
-{
-	if (self->line != NULL)
-	{
-		free(self->line);
-		self->line = NULL;
-	}
-	free(self);
+	return node;
 }
 
-void aFile_reset(aFile_t * restrict self)
+bool aLine_isPacked(const aLine_t * restrict self)
 {
-	(*self) = (aFile_t){
-		.fileName = NULL,
-		.hFile    = INVALID_HANDLE_VALUE,
-		.canWrite = false,
-		.eolSeq   = eolNOT,
-		.data     = {
-			.firstNode   = NULL,
-			.currentNode = NULL,
-			.pcury       = NULL,
-			.curx        = 0
-		}
-	};
+	return self->line == NULL;
 }
-bool aFile_open(aFile_t * restrict self, const wchar * restrict fileName, bool writemode)
+bool aLine_isSpan(const aLine_t * restrict self)
 {
-	fileName = (fileName == NULL) ? self->fileName : fileName;
-
-	// try to open file
-	self->hFile = CreateFileW(
-		fileName,
-		writemode ? GENERIC_WRITE : GENERIC_READ,
-		FILE_SHARE_READ,
-		NULL,
-		writemode ? CREATE_ALWAYS : OPEN_ALWAYS,
-		FILE_ATTRIBUTE_NORMAL,
-		NULL
-	);
-	if (self->hFile == INVALID_HANDLE_VALUE)
-	{
-		self->canWrite = false;
-		return false;
-	}
-	else
-	{
-		self->canWrite = writemode;
-		self->fileName = fileName;
-		return true;
-	}
+	return (self->line == NULL) && (self->u8 == NULL);
 }
-void aFile_close(aFile_t * restrict self)
+usize aLine_pack(aArena_t * restrict arena, aLine_t * restrict self)
 {
-	if (self->hFile != INVALID_HANDLE_VALUE)
+	if (aLine_isPacked(self))
 	{
-		CloseHandle(self->hFile);
-		self->hFile = INVALID_HANDLE_VALUE;
+		return 0;
 	}
-}
-void aFile_clearLines(aFile_t * restrict self)
-{
-	aLine_t * restrict node  = self->data.firstNode;
-	self->data.firstNode   = NULL;
-	self->data.currentNode = NULL;
-	self->data.pcury       = NULL;
-	while (node != NULL)
+
+	const usize tailStart = self->curx + self->freeSpaceLen, tailLen = self->lineEndx - tailStart;
+	const usize u8len = aUtf_u8Len(self->line, self->curx) + aUtf_u8Len(self->line + tailStart, tailLen);
+	const usize oldBytes = sizeof(wchar) * self->lineEndx;
+
+	aLine_t packed = *self;
+	if (!aLine_setU8(arena, &packed, u8len, aLine_len(self)))
 	{
-		aLine_t * restrict next = node->nextNode;
-		aLine_destroy(node);
-		node = next;
+		return 0;
 	}
+	const usize headBytes = aUtf_toU8(self->line, self->curx, packed.u8);
+	aUtf_toU8(self->line + tailStart, tailLen, packed.u8 + headBytes);
+	aLine_buildMap(&packed);
+
+	aArena_free(arena, self->line, oldBytes);
+	self->line         = NULL;
+	self->u8           = packed.u8;
+	self->u8len        = packed.u8len;
+	self->lineEndx     = packed.lineEndx;
+	self->freeSpaceLen = 0;
+
+	const usize newBytes = aArena_capacity(aLine_packedSize(self));
+	return (oldBytes > newBytes) ? (oldBytes - newBytes) : 0;
 }
-const wchar * aFile_readBytes(aFile_t * restrict self, char ** restrict bytes, usize * restrict bytesLen)
+bool aLine_unpack(aArena_t * restrict arena, aLine_t * restrict self)
 {
-	if (aFile_open(self, NULL, false) == false)
+	if (!aLine_isPacked(self))
 	{
-		return L"File opening error!";
+		return true;
 	}
-	DWORD fileSize = GetFileSize(self->hFile, NULL);
-	if ((fileSize >= *bytesLen) || (*bytes == NULL))
+	else if (aLine_isSpan(self))
 	{
-		vptr mem = realloc(*bytes, fileSize + 1);
-		if (mem == NULL)
-		{
-			return L"Memory error!";
-		}
-		*bytes    = mem;
-		*bytesLen = fileSize + 1;
+		return false;
 	}
 
-	BOOL readFileRes = ReadFile(
-		self->hFile,
-		*bytes,
-		fileSize,
-		NULL,
-		NULL
-	);
-	aFile_close(self);
-	if (!readFileRes)
+	const usize cols = self->lineEndx, curx = (self->curx < cols) ? self->curx : cols;
+	usize lineEndx;
+	wchar * line = aLine_allocLine(arena, cols + ATTO_LNODE_DEFAULT_FREE, &lineEndx);
+	if (line == NULL)
 	{
-		return L"File read error!";
+		return false;
 	}
-	// Add null terminator
-	(*bytes)[fileSize] = '\0';
 
-	return NULL;
-}
-const wchar * aFile_read(aFile_t * restrict self)
-{
-	char * bytes = NULL;
-	usize size;
-	const wchar * res;
-	if ((res = aFile_readBytes(self, &bytes, &size)) != NULL)
-	{
-		return res;
-	}
+	// Text before the cursor goes to the front, rest after the gap
+	const usize freeSpaceLen = lineEndx - cols;
+	aUtf_toW(self->u8, self->u8len, line + freeSpaceLen);
+	memmove(line, line + freeSpaceLen, sizeof(wchar) * curx);
 
-	// Convert to UTF-16
-	wchar * utf16 = NULL;
-	usize chars = (usize)atto_toutf16(bytes, (int)size, &utf16, NULL);
-	free(bytes);
+	aArena_free(arena, self->u8, aLine_packedSize(self));
+	self->u8    = NULL;
+	self->u8len = 0;
+	self->line  = line;
+	self->lineEndx     = lineEndx;
+	self->curx         = curx;
+	self->freeSpaceLen = freeSpaceLen;
 
-	if (utf16 == NULL)
+	return true;
+}
+bool aLine_find(const aLine_t * restrict self, const aFind_t * restrict find, usize from, usize * restrict col)
+{
+	const usize m = find->wlen;
+	if (aLine_isSpan(self) || (m == 0))
 	{
-		return L"Unicode conversion error!";
+		return false;
 	}
-
-	// Convert tabs to spaces
-	atto_tabsToSpaces(&utf16, &chars);
-
-	// Save lines to structure
-	wchar ** lines = NULL;
-	const usize numLines = atto_strnToLines(utf16, chars, &lines, &self->eolSeq);
-	if (lines == NULL)
+	else if (aLine_isPacked(self))
 	{
-		free(utf16);
-		return L"Line reading error!";
+		usize startCol;
+		for (usize pos = aLine_u8Seek(self, from, &startCol), start = pos; pos < self->u8len; ++pos)
+		{
+			pos += aFind_inU8(find, self->u8 + pos, self->u8len - pos);
+			if (pos == self->u8len)
+			{
+				break;
+			}
+			// Column is counted from the code point the search has started at
+			*col = startCol + aUtf_wLen(self->u8 + start, pos - start);
+			if (*col >= from)
+			{
+				return true;
+			}
+		}
+		return false;
 	}
 
-	aFile_clearLines(self);
-	if (numLines == 0)
+	// Text before the gap, matches spanning the gap, text after the gap
+	const wchar * restrict tail = self->line + self->curx + self->freeSpaceLen;
+	const usize headLen = self->curx, tailLen = self->lineEndx - self->curx - self->freeSpaceLen;
+	if (from < headLen)
 	{
-		self->data.firstNode = aLine_create(NULL, NULL);
-		if (self->data.firstNode == NULL)
+		const usize at = aFind_inW(find, self->line + from, headLen - from);
+		if (at < (headLen - from))
 		{
-			free(lines);
-			free(utf16);
-			return L"Line creation error!";
+			*col = from + at;
+			return true;
 		}
 	}
-	else
+	for (usize at = max_usize(from, (headLen >= m) ? (headLen - m + 1) : 0); (at < headLen) && ((at + m) <= (headLen + tailLen)); ++at)
 	{
-		self->data.firstNode = aLine_createText(NULL, NULL, lines[0], -1);
-		if (self->data.firstNode == NULL)
+		usize k = 0;
+		while ((k < m) && ((((at + k) < headLen) ? self->line[at + k] : tail[at + k - headLen]) == find->w[k]))
 		{
-			free(lines);
-			free(utf16);
-			return L"Line creation error!";
+			++k;
+		}
+		if (k == m)
+		{
+			*col = at;
+			return true;
 		}
 	}
-	self->data.currentNode = self->data.firstNode;
-	for (usize i = 1; i < numLines; ++i)
+	const usize tailFrom = (from > headLen) ? (from - headLen) : 0;
+	if (tailFrom < tailLen)
 	{
-		aLine_t * node = aLine_createText(self->data.currentNode, NULL, lines[i], -1);
-		if (node == NULL)
+		const usize at = aFind_inW(find, tail + tailFrom, tailLen - tailFrom);
+		if (at < (tailLen - tailFrom))
 		{
-			free(lines);
-			free(utf16);
-			return L"Line creation error!";
+			*col = headLen + tailFrom + at;
+			return true;
 		}
-		self->data.currentNode = node;
 	}
-	free(lines);
-	free(utf16);
-
-	return NULL;
+	return false;
 }
-isize aFile_write(aFile_t * restrict self)
+bool aLine_setRegex(const aLine_t * restrict self, aRegex_t * restrict re)
 {
-	// Generate lines
-	wchar * lines = NULL, * line = NULL;
-	usize linesCap = 0, linesLen = 0, lineCap = 0;
-
-	const aLine_t * node = self->data.firstNode;
-
-	const eolSeq_e eolSeq = self->eolSeq;
-	const bool isCRLF = (self->eolSeq == eolCRLF);
+	if (aLine_isSpan(self))
+	{
+		return false;
+	}
+	else if (aLine_isPacked(self))
+	{
+		return aRegex_setLine(re, self->u8, self->u8len);
+	}
 
-	while (node != NULL)
+	const usize tailStart = self->curx + self->freeSpaceLen;
+	return aRegex_setLineW(
+		re,
+		self->line, self->curx,
+		self->line + tailStart, self->lineEndx - tailStart
+	);
+}
+usize aLine_getCols(const aLine_t * restrict self, usize col, wchar * restrict dest, usize maxCols)
+{
+	usize j = 0;
+	if (aLine_isSpan(self))
+	{
+		return 0;
+	}
+	else if (aLine_isPacked(self))
 	{
-		if (aLine_getText(node, &line, &lineCap) == false)
+		usize c;
+		usize pos = aLine_u8Seek(self, col, &c);
+		wchar tmp[2];
+		while (j < maxCols)
 		{
-			if (line != NULL)
+			const usize units = aUtf_decodeCh(self->u8, self->u8len, &pos, tmp);
+			if (units == 0)
 			{
-				free(line);
+				break;
 			}
-			if (lines != NULL)
+			for (usize k = 0; (k < units) && (j < maxCols); ++k, ++c)
 			{
-				free(lines);
+				if (c >= col)
+				{
+					dest[j] = tmp[k];
+					++j;
+				}
 			}
-			return afwrMEM_ERROR;
 		}
+		return j;
+	}
 
-		const usize lineLen = wcsnlen(line, lineCap);
-		const usize addnewline = (node->nextNode != NULL) ? 1 + (usize)isCRLF : 0;
-		const usize newLinesLen = linesLen + lineLen + addnewline;
-
-		// Add line to lines, concatenate \n character, if necessary
-
-		if (newLinesLen >= linesCap)
-		{
-			// Resize lines array
-			const usize newCap = (newLinesLen + 1) * 2;
+	// Text before the gap, then text after it
+	if (col < self->curx)
+	{
+		const usize n = min_usize(self->curx - col, maxCols);
+		memcpy(dest, self->line + col, sizeof(wchar) * n);
+		j   += n;
+		col += n;
+	}
+	const usize idx = min_usize(col + self->freeSpaceLen, self->lineEndx);
+	if (j < maxCols)
+	{
+		const usize n = min_usize(self->lineEndx - idx, maxCols - j);
+		memcpy(dest + j, self->line + idx, sizeof(wchar) * n);
+		j += n;
+	}
+	return j;
+}
 
-			vptr mem = realloc(lines, sizeof(wchar) * newCap);
-			if (mem == NULL)
-			{
-				if (line != NULL)
-				{
-					free(line);
-				}
-				if (lines != NULL)
-				{
-					free(lines);
-				}
-				return afwrMEM_ERROR;
-			}
+static usize aLine_tabEnd(usize scol)
+{
+	return scol + ATTO_TAB_WIDTH - (scol % ATTO_TAB_WIDTH);
+}
 
-			lines    = mem;
-			linesCap = newCap;
-		}
+typedef struct aTabScan
+{
+	usize tabs, col, scol;
+	u32 * pairs;
 
-		// Copy line
-		memcpy(lines + linesLen, line, sizeof(wchar) * lineLen);
-		linesLen = newLinesLen;
+} aTabScan_t;
 
-		if (addnewline)
+static void aLine_scanTabsW(aTabScan_t * restrict scan, const wchar * restrict chs, usize len)
+{
+	for (usize i = 0; i < len; ++i, ++scan->col)
+	{
+		if (chs[i] != L'\t')
 		{
-			switch (eolSeq)
-			{
-			case eolCR:
-				lines[linesLen - 1] = L'\r';
-				break;
-			case eolLF:
-				lines[linesLen - 1] = L'\n';
-				break;
-			case eolCRLF:
-				lines[linesLen - 2] = L'\r';
-				lines[linesLen - 1] = L'\n';
-				break;
-			case eolNOT:
-				assert(!"EOL sequence not selected!");
-				break;
-			}
+			++scan->scol;
+			continue;
 		}
-		lines[linesLen] = L'\0';
-
-		node = node->nextNode;
-	}
-	free(line);
-
-	// Try to convert lines string to UTF-8
-	char * utf8 = NULL;
-	usize utf8sz = 0;
-	atto_toutf8(lines, (int)linesLen + 1, &utf8, &utf8sz);
-
-	// Free UTF-16 lines string
-	free(lines);
-
-	// Error-check conversion
-	if (utf8 == NULL)
-	{
-		return afwrMEM_ERROR;
+		if (scan->pairs != NULL)
+		{
+			scan->pairs[2 * scan->tabs]     = (u32)scan->col;
+			scan->pairs[2 * scan->tabs + 1] = (u32)scan->scol;
+		}
+		++scan->tabs;
+		scan->scol = aLine_tabEnd(scan->scol);
 	}
-
-	// Check if anything has changed, for that load original file again
-	char * compFile = NULL;
-	usize compSize;
-	if (aFile_readBytes(self, &compFile, &compSize) == NULL)
+}
+static usize aLine_scanTabs(const aLine_t * restrict self, u32 * restrict pairs)
+{
+	aTabScan_t scan = { .tabs = 0, .col = 0, .scol = 0, .pairs = pairs };
+	if (aLine_isPacked(self))
 	{
-		// Reading was successful
-		bool areEqual = strncmp(utf8, compFile, min_usize(utf8sz, compSize)) == 0;
-		free(compFile);
-
-		if (areEqual)
+		wchar tmp[2];
+		for (usize pos = 0, units; (units = aUtf_decodeCh(self->u8, self->u8len, &pos, tmp)) > 0;)
 		{
-			// Free all resources before returning
-			free(utf8);
-			return afwrNOTHING_NEW;
+			aLine_scanTabsW(&scan, tmp, units);
 		}
 	}
-
-	// Try to open file for writing
-	if (aFile_open(self, NULL, true) == false)
+	else
 	{
-		return afwrOPEN_ERROR;
+		const usize tailStart = self->curx + self->freeSpaceLen;
+		aLine_scanTabsW(&scan, self->line, self->curx);
+		aLine_scanTabsW(&scan, self->line + tailStart, self->lineEndx - tailStart);
 	}
-
-	if (self->canWrite == false)
+	return scan.tabs;
+}
+static const u32 * aLine_getTabs(aArena_t * restrict arena, aLine_t * restrict self)
+{
+	if (self->tabs != NULL)
 	{
-		aFile_close(self);
-		return afwrWRITE_ERROR;
+		return self->tabs;
+	}
+	else if (aLine_isSpan(self) || (aLine_len(self) > (usize)UINT32_MAX / 2))
+	{
+		return NULL;
 	}
 
-	// Try to write UTF-8 lines string to file
-	DWORD dwWritten;
-	// Write everything except the null terminator
-	const BOOL res = WriteFile(
-		self->hFile,
-		utf8,
-		(DWORD)(utf8sz - (usize)1),
-		&dwWritten,
-		NULL
-	);
-	// Close file
-	aFile_close(self);
-	// Free utf8 string
-	free(utf8);
-
-	// Do error checking
-	if (!res)
+	const usize tabs = aLine_scanTabs(self, NULL);
+	if (tabs == 0)
 	{
-		return afwrWRITE_ERROR;
+		self->tabs = aLine_noTabs;
+		return self->tabs;
 	}
-	else
+	u32 * restrict mem = aArena_alloc(arena, sizeof(u32) * (1 + 2 * tabs), NULL);
+	if (mem == NULL)
 	{
-		return (i32)dwWritten;
+		return NULL;
 	}
+	mem[0] = (u32)tabs;
+	aLine_scanTabs(self, mem + 1);
+	self->tabs = mem;
+	return mem;
 }
-void aFile_setConTitle(const aFile_t * restrict self)
-{
-	wchar wndName[MAX_PATH];
-	const usize fnamelen = min_usize(MAX_PATH - 1, wcslen(self->fileName));
-	memcpy(wndName, self->fileName, fnamelen * sizeof(wchar));
-	wcscpy_s(wndName + fnamelen, MAX_PATH - fnamelen, L" - atto");
-	SetConsoleTitleW(wndName);
-}
-
-
-bool aFile_addNormalCh(aFile_t * restrict self, wchar ch)
+usize aLine_toScreenCol(aArena_t * restrict arena, aLine_t * restrict self, usize col)
 {
-	aLine_t * restrict node = self->data.currentNode;
-	if ((node->freeSpaceLen == 0) && !aLine_realloc(node))
+	const u32 * restrict tabs = aLine_getTabs(arena, self);
+	if ((tabs == NULL) || (tabs[0] == 0))
 	{
-		return false;
+		return col;
 	}
 
-	node->line[node->curx] = ch;
-	++node->curx;
-	--node->freeSpaceLen;
-	return true;
-}
-bool aFile_addSpecialCh(aFile_t * restrict self, wchar ch)
-{
-	switch (ch)
+	// Find number of tabs before col
+	const u32 * restrict pairs = tabs + 1;
+	usize lo = 0, hi = tabs[0];
+	while (lo < hi)
 	{
-	case VK_TAB:
-		for (u8 i = 0; i < 4; ++i)
+		const usize mid = lo + (hi - lo) / 2;
+		if ((usize)pairs[2 * mid] < col)
 		{
-			if (aFile_addNormalCh(self, ' ') == false)
-			{
-				return false;
-			}
+			lo = mid + 1;
 		}
-		break;
-	case VK_OEM_BACKTAB:
-		// Check if there's 4 spaces before the caret
-		if (aFile_checkLineAt(self, -4, L"    ", 4))
+		else
 		{
-			for (u8 i = 0; i < 4; ++i)
-			{
-				aFile_deleteBackward(self);
-			}
+			hi = mid;
 		}
-		// If there isn't, check if there's 4 spaces after the caret
-		else if (aFile_checkLineAt(self, 0, L"    ", 4))
+	}
+	if (lo == 0)
+	{
+		return col;
+	}
+	const usize tabCol = pairs[2 * (lo - 1)];
+	return aLine_tabEnd(pairs[2 * (lo - 1) + 1]) + (col - tabCol - 1);
+}
+usize aLine_getScreenCols(aArena_t * restrict arena, aLine_t * restrict self, usize scol, wchar * restrict dest, usize maxCols)
+{
+	const u32 * restrict tabs = aLine_getTabs(arena, self);
+	if ((tabs == NULL) || (tabs[0] == 0))
+	{
+		// No cache, tabs are shown as single spaces
+		const usize n = aLine_getCols(self, scol, dest, maxCols);
+		for (usize i = 0; (tabs == NULL) && (i < n); ++i)
 		{
-			for (int i = 0; i < 4; ++i)
-			{
-				aFile_deleteForward(self);
-			}
+			dest[i] = (dest[i] == L'\t') ? L' ' : dest[i];
 		}
-		break;
-	case VK_RETURN:	// Enter key
-		aFile_addNewLine(self);
-		break;
-	case VK_BACK:	// Backspace
-		aFile_deleteBackward(self);
-		break;
-	case VK_DELETE:	// Delete
-		aFile_deleteForward(self);
-		break;
-	// Move cursor
-	case VK_LEFT:	// Left arrow
-		if (self->data.currentNode->curx > 0)
+		return n;
+	}
+
+	// Find last tab starting at or before scol
+	const u32 * restrict pairs = tabs + 1;
+	const usize numTabs = tabs[0];
+	usize lo = 0, hi = numTabs;
+	while (lo < hi)
+	{
+		const usize mid = lo + (hi - lo) / 2;
+		if ((usize)pairs[2 * mid + 1] <= scol)
 		{
-			aLine_moveCursor(self->data.currentNode, -1);
+			lo = mid + 1;
 		}
-		else if (self->data.currentNode->prevNode != NULL)
+		else
 		{
-			self->data.currentNode = self->data.currentNode->prevNode;
+			hi = mid;
 		}
-		break;
-	case VK_RIGHT:	// Right arrow
-		if ((self->data.currentNode->curx + self->data.currentNode->freeSpaceLen) < self->data.currentNode->lineEndx)
+	}
+
+	usize j = 0, k = lo, col = scol;
+	if (lo > 0)
+	{
+		const usize tabScol = pairs[2 * (lo - 1) + 1], end = aLine_tabEnd(tabScol);
+		if (scol < end)
 		{
-			aLine_moveCursor(self->data.currentNode, 1);
+			// Starts inside of a tab
+			for (; (j < maxCols) && ((scol + j) < end); ++j)
+			{
+				dest[j] = L' ';
+			}
+			col = (usize)pairs[2 * (lo - 1)] + 1;
 		}
-		else if (self->data.currentNode->nextNode != NULL)
+		else
 		{
-			self->data.currentNode = self->data.currentNode->nextNode;
+			col = (usize)pairs[2 * (lo - 1)] + 1 + (scol - end);
 		}
-		break;
-	case VK_UP:		// Up arrow
-		if (self->data.currentNode->prevNode != NULL)
+	}
+
+	// Runs between tabs are copied as they are
+	while (j < maxCols)
+	{
+		const usize runEnd = (k < numTabs) ? (usize)pairs[2 * k] : (usize)-1;
+		const usize run = min_usize(runEnd - col, maxCols - j);
+		const usize n = (run > 0) ? aLine_getCols(self, col, dest + j, run) : 0;
+		j   += n;
+		col += n;
+		if ((n < run) || (k >= numTabs))
 		{
-			self->data.currentNode = self->data.currentNode->prevNode;
+			break;
 		}
-		break;
-	case VK_DOWN:	// Down arrow
-		if (self->data.currentNode->nextNode != NULL)
+		if (col == runEnd)
 		{
-			self->data.currentNode = self->data.currentNode->nextNode;
+			const usize tabScol = pairs[2 * k + 1], end = aLine_tabEnd(tabScol);
+			for (usize c = tabScol; (c < end) && (j < maxCols); ++c, ++j)
+			{
+				dest[j] = L' ';
+			}
+			++col;
+			++k;
 		}
-		break;
-	default:
-		return false;
 	}
-
-	return true;
+	return j;
 }
-
-bool aFile_checkLineAt(const aFile_t * restrict self, isize maxdelta, const wchar * restrict string, usize maxString)
+bool aLine_textFind(const wchar * restrict text, usize len, const aFind_t * restrict find, usize from, usize * restrict col)
 {
-	const aLine_t * restrict node = self->data.currentNode;
-	if (node == NULL)
+	if ((find->wlen == 0) || (from >= len))
 	{
 		return false;
 	}
+	*col = from + aFind_inW(find, text + from, len - from);
+	return *col < len;
+}
+usize aLine_textToScreenCol(const wchar * restrict text, usize len, usize col)
+{
+	usize scol = 0;
+	for (usize i = 0; (i < col) && (i < len); ++i)
+	{
+		scol = (text[i] == L'\t') ? aLine_tabEnd(scol) : (scol + 1);
+	}
+	return scol;
+}
+usize aLine_textScreenCols(const wchar * restrict text, usize len, usize scol, wchar * restrict dest, usize maxCols)
+{
+	// Text is walked from its start, tabs are expanded as they're met
+	usize j = 0, c = 0;
+	for (usize i = 0; (i < len) && (j < maxCols); ++i)
+	{
+		const bool tab = (text[i] == L'\t');
+		for (const usize end = tab ? aLine_tabEnd(c) : (c + 1); (c < end) && (j < maxCols); ++c)
+		{
+			if (c >= scol)
+			{
+				dest[j] = tab ? L' ' : text[i];
+				++j;
+			}
+		}
+	}
+	return j;
+}
 
-	isize idx = (isize)node->curx + maxdelta, i = 0;
-	const isize m = (isize)maxString;
-	if (idx < 0)
+bool aLine_getText(const aLine_t * restrict self, wchar ** restrict text, usize * restrict tarrsz)
+{
+	if (aLine_isSpan(self))
 	{
 		return false;
 	}
-	for (; idx < (isize)node->lineEndx && i < m && *string != '\0';)
+	const usize totalLen = self->lineEndx - self->freeSpaceLen + 1;
+
+	if ((tarrsz != NULL) && (*tarrsz < totalLen))
 	{
-		if ((idx == (isize)node->curx) && (node->freeSpaceLen > 0))
+		wchar * mem = realloc(*text, sizeof(wchar) * totalLen);
+		if (mem == NULL)
 		{
-			idx += (isize)node->freeSpaceLen;
-			continue;
+			return false;
 		}
-		
-		if (node->line[idx] != *string)
+		*text   = mem;
+		*tarrsz = totalLen;
+	}
+	else if (tarrsz == NULL)
+	{
+		*text = malloc(sizeof(wchar) * totalLen);
+		if (*text == NULL)
 		{
 			return false;
 		}
+	}
 
-		++string;
-		++i;
-		++idx;
+	if (aLine_isPacked(self))
+	{
+		(*text)[aUtf_toW(self->u8, self->u8len, *text)] = L'\0';
+		return true;
 	}
-	if (*string != '\0' && i < m)
+
+	wchar * restrict t = *text;
+	for (usize i = 0; i < self->lineEndx;)
 	{
-		return false;
+		if ((i == self->curx) && (self->freeSpaceLen > 0))
+		{
+			i += self->freeSpaceLen;
+			continue;
+		}
+
+		*t = self->line[i];
+		++t;
+		++i;
 	}
+	*t = L'\0';
 
 	return true;
 }
-bool aFile_deleteForward(aFile_t * restrict self)
+
+static bool aLine_resizeGap(aArena_t * restrict arena, aLine_t * restrict self, usize freeSpace)
 {
-	aLine_t * restrict node = self->data.currentNode;
-	if ((node->curx + node->freeSpaceLen) < node->lineEndx)
+	const usize totalLen = aLine_len(self), tailLen = totalLen - self->curx;
+	const usize newEndx  = aArena_capacity(sizeof(wchar) * (totalLen + freeSpace)) / sizeof(wchar);
+	const usize newFree  = newEndx - totalLen;
+	if (newEndx == self->lineEndx)
 	{
-		++node->freeSpaceLen;
 		return true;
 	}
-	else if (node->nextNode != NULL)
+
+	// Shrinking gap, contents after the gap have to be moved before resizing
+	if (newFree < self->freeSpaceLen)
 	{
-		return aLine_mergeNext(node, &self->data.pcury);
+		memmove(
+			self->line + self->curx + newFree,
+			self->line + self->curx + self->freeSpaceLen,
+			sizeof(wchar) * tailLen
+		);
 	}
-	else
+	vptr newmem = aArena_realloc(
+		arena,
+		self->line,
+		sizeof(wchar) * self->lineEndx,
+		sizeof(wchar) * newEndx,
+		NULL
+	);
+	if (newmem == NULL)
 	{
+		if (newFree < self->freeSpaceLen)
+		{
+			// Restore previous layout
+			memmove(
+				self->line + self->curx + self->freeSpaceLen,
+				self->line + self->curx + newFree,
+				sizeof(wchar) * tailLen
+			);
+		}
 		return false;
 	}
+	self->line = newmem;
+	if (newFree > self->freeSpaceLen)
+	{
+		memmove(
+			self->line + self->curx + newFree,
+			self->line + self->curx + self->freeSpaceLen,
+			sizeof(wchar) * tailLen
+		);
+	}
+
+	self->lineEndx     = newEndx;
+	self->freeSpaceLen = newFree;
+
+	return true;
 }
-bool aFile_deleteBackward(aFile_t * restrict self)
+bool aLine_realloc(aArena_t * restrict arena, aLine_t * restrict self)
 {
-	aLine_t * restrict node = self->data.currentNode;
-	if (node->curx > 0)
+	// Gap grows with the line, long runs of typing stay amortised O(1)
+	const usize freeSpace = max_usize(ATTO_LNODE_DEFAULT_FREE, aLine_len(self) / ATTO_LNODE_GROWTH_DIV);
+	if (self->freeSpaceLen >= ATTO_LNODE_DEFAULT_FREE)
 	{
-		--node->curx;
-		++node->freeSpaceLen;
 		return true;
 	}
-	else if (node->prevNode != NULL)
+	return aLine_resizeGap(arena, self, freeSpace);
+}
+usize aLine_compact(aArena_t * restrict arena, aLine_t * restrict self)
+{
+	if (self->freeSpaceLen <= ATTO_LNODE_COMPACT_FREE)
 	{
-		// Add current node data to previous node data
-		self->data.currentNode = node->prevNode;
-		return aLine_mergeNext(self->data.currentNode, &self->data.pcury);
+		return 0;
 	}
-	else
+	const usize oldEndx = self->lineEndx;
+	if (!aLine_resizeGap(arena, self, ATTO_LNODE_DEFAULT_FREE))
 	{
-		return false;
+		return 0;
 	}
+	return sizeof(wchar) * (oldEndx - self->lineEndx);
 }
-bool aFile_addNewLine(aFile_t * restrict self)
+static bool aLine_insert(aArena_t * restrict arena, aLine_t * restrict self, const wchar * restrict text, usize len)
 {
-	aLine_t * restrict node = aLine_create(self->data.currentNode, self->data.currentNode->nextNode);
-	if (node == NULL)
+	// Gap is resized at most once for the whole text
+	if (self->freeSpaceLen < len)
 	{
-		return false;
+		const usize freeSpace = len + max_usize(ATTO_LNODE_DEFAULT_FREE, (aLine_len(self) + len) / ATTO_LNODE_GROWTH_DIV);
+		if (!aLine_resizeGap(arena, self, freeSpace))
+		{
+			return false;
+		}
 	}
-
-	self->data.currentNode->nextNode = node;
-	self->data.currentNode = node;
+	memcpy(self->line + self->curx, text, sizeof(wchar) * len);
+	self->curx         += len;
+	self->freeSpaceLen -= len;
+	aLine_dropTabs(arena, self);
+	aLineIdx_setChars(&self->idx, aLine_len(self));
 	return true;
 }
 
-void aFile_updateCury(aFile_t * restrict self, u32 height)
+bool aLine_mergeNext(aArena_t * restrict arena, aLine_t * restrict self, aLine_t ** restrict ppcury)
 {
-	if (self->data.pcury == NULL)
+	if (self->nextNode == NULL)
 	{
-		aLine_t * restrict node = self->data.currentNode;
-		for (u32 i = 0; (i < height) && (node->prevNode != NULL); ++i)
-		{
-			node = node->prevNode;
+		return false;
+	}
+	
+	aLine_t * restrict n = self->nextNode;
+	if (!aLine_unpack(arena, self) || !aLine_unpack(arena, n))
+	{
+		return false;
+	}
+	*ppcury = (*ppcury == n) ? self : *ppcury;
+
+	// Move cursor to end, if needed, before the buffer can get shrunk
+	aLine_moveCursor(self, (isize)self->lineEndx);
+	aLine_moveCursor(n,    (isize)n->lineEndx);
+
+	// Allocate more memory for first line
+	usize cap;
+	vptr linemem = aArena_realloc(
+		arena,
+		self->line,
+		sizeof(wchar) * self->lineEndx,
+		sizeof(wchar) * (self->curx + n->curx + ATTO_LNODE_DEFAULT_FREE),
+		&cap
+	);
+	if (linemem == NULL)
+	{
+		return false;
+	}
+	self->line = linemem;
+
+	self->lineEndx     = cap / sizeof(wchar);
+	self->freeSpaceLen = self->lineEndx - self->curx - n->curx;
+
+	memcpy(self->line + self->curx + self->freeSpaceLen, n->line, sizeof(wchar) * n->curx);
+	aLine_dropTabs(arena, self);
+	self->nextNode = n->nextNode;
+	if (self->nextNode != NULL)
+	{
+		self->nextNode->prevNode = self;
+	}
+	if (aLineIdx_attached(&n->idx))
+	{
+		aLineIdx_remove(&n->idx);
+		aLineIdx_setChars(&self->idx, aLine_len(self));
+	}
+	aLine_destroy(arena, n);
+
+	return true;
+}
+
+void aLine_moveCursor(aLine_t * restrict self, isize delta)
+{
+	if (delta < 0)
+	{
+		for (usize idx = self->curx + self->freeSpaceLen; delta < 0 && self->curx > 0; ++delta)
+		{
+			--idx;
+			--self->curx;
+			self->line[idx] = self->line[self->curx];
+		}
+	}
+	else
+	{
+		for (usize total = self->lineEndx - self->freeSpaceLen, idx = self->curx + self->freeSpaceLen; delta > 0 && self->curx < total; --delta)
+		{
+			self->line[self->curx] = self->line[idx];
+			++idx;
+			++self->curx;
+		}
+	}
+}
+
+void aLine_destroy(aArena_t * restrict arena, aLine_t * restrict self)
+{
+	aLine_dropTabs(arena, self);
+	if (self->line != NULL)
+	{
+		aArena_free(arena, self->line, sizeof(wchar) * self->lineEndx);
+		self->line = NULL;
+	}
+	else if (self->u8 != NULL)
+	{
+		aArena_free(arena, self->u8, aLine_packedSize(self));
+		self->u8 = NULL;
+	}
+	aArena_freeNode(arena, self);
+}
+
+static usize aFile_packLine(aFile_t * restrict self, aLine_t * restrict node)
+{
+	const usize reclaimed = aLine_pack(&self->data.arena, node);
+	return aLine_isPacked(node) ? reclaimed : aLine_compact(&self->data.arena, node);
+}
+static void aFile_queueCompact(aFile_t * restrict self, aLine_t * restrict node)
+{
+	if ((node == NULL) || aLine_isPacked(node))
+	{
+		return;
+	}
+	for (usize i = 0; i < self->data.numCompact; ++i)
+	{
+		if (self->data.compactQueue[i] == node)
+		{
+			return;
+		}
+	}
+	if (self->data.numCompact == ATTO_COMPACT_QUEUE)
+	{
+		// Queue is full, oldest line gets packed right away
+		self->data.reclaimed += aFile_packLine(self, self->data.compactQueue[0]);
+		--self->data.numCompact;
+		memmove(self->data.compactQueue, self->data.compactQueue + 1, sizeof(aLine_t *) * self->data.numCompact);
+	}
+	self->data.compactQueue[self->data.numCompact] = node;
+	++self->data.numCompact;
+}
+static void aFile_unqueueCompact(aFile_t * restrict self, const aLine_t * restrict node)
+{
+	for (usize i = 0; i < self->data.numCompact; ++i)
+	{
+		if (self->data.compactQueue[i] == node)
+		{
+			--self->data.numCompact;
+			memmove(self->data.compactQueue + i, self->data.compactQueue + i + 1, sizeof(aLine_t *) * (self->data.numCompact - i));
+			return;
+		}
+	}
+}
+static bool aFile_setCurrent(aFile_t * restrict self, aLine_t * restrict node)
+{
+	if (node == NULL)
+	{
+		return false;
+	}
+	else if (node != self->data.currentNode)
+	{
+		// Current line is always editable
+		if (!aLine_unpack(&self->data.arena, node))
+		{
+			return false;
+		}
+		aFile_unqueueCompact(self, node);
+		aFile_queueCompact(self, self->data.currentNode);
+		self->data.currentNode = node;
+	}
+	return true;
+}
+
+static eolSeq_e aFile_spanLine(const char * restrict mem, usize end, usize * restrict pos, usize * restrict lineEnd)
+{
+	// Finds end of line starting at *pos, *pos is moved to the next line
+	*lineEnd = *pos + aUtf_findEol(mem + *pos, end - *pos);
+	if (*lineEnd == end)
+	{
+		*pos = end;
+		return eolNOT;
+	}
+	else if (mem[*lineEnd] == '\n')
+	{
+		*pos = *lineEnd + 1;
+		return eolLF;
+	}
+	else if (((*lineEnd + 1) < end) && (mem[*lineEnd + 1] == '\n'))
+	{
+		*pos = *lineEnd + 2;
+		return eolCRLF;
+	}
+	*pos = *lineEnd + 1;
+	return eolCR;
+}
+static void aFile_countEol(aEolCensus_t * restrict eols, eolSeq_e eol)
+{
+	switch (eol)
+	{
+	case eolCRLF:
+		++eols->crlf;
+		break;
+	case eolLF:
+		++eols->lf;
+		break;
+	case eolCR:
+		++eols->cr;
+		break;
+	case eolNOT:
+		break;
+	}
+}
+static void aFile_pickEol(aFile_t * restrict self)
+{
+	// Most common EOL sequence is used for saving
+	const aEolCensus_t * restrict c = &self->eols;
+	if ((c->crlf == 0) && (c->lf == 0) && (c->cr == 0))
+	{
+		self->eolSeq = eolDEF;
+	}
+	else if ((c->crlf >= c->lf) && (c->crlf >= c->cr))
+	{
+		self->eolSeq = eolCRLF;
+	}
+	else
+	{
+		self->eolSeq = (c->lf >= c->cr) ? eolLF : eolCR;
+	}
+}
+static aLine_t * aFile_createSpan(aFile_t * restrict self, aLine_t * restrict prev, usize start, usize end, usize lines)
+{
+	aLine_t * node = aArena_allocNode(&self->data.arena);
+	if (node == NULL)
+	{
+		return NULL;
+	}
+
+	*node = (aLine_t){
+		.line         = NULL,
+		.lineEndx     = 0,
+		.curx         = start,
+		.freeSpaceLen = 0,
+		.u8           = NULL,
+		.u8len        = end - start,
+		.tabs         = NULL,
+		.prevNode     = prev,
+		.nextNode     = NULL
+	};
+	// Character counts are known only after the lines have been created
+	aLineIdx_init(&node->idx, 0);
+	aLineIdx_update(&node->idx, lines, 0);
+	if (prev == NULL)
+	{
+		aLineIdx_insertFirst(&self->data.lineIdx, &node->idx);
+	}
+	else
+	{
+		prev->nextNode = node;
+		aLineIdx_insertAfter(&prev->idx, &node->idx);
+	}
+	return node;
+}
+static usize aFile_putEol(eolSeq_e eolSeq, char * restrict dst)
+{
+	switch (eolSeq)
+	{
+	case eolCR:
+		dst[0] = '\r';
+		return 1;
+	case eolLF:
+		dst[0] = '\n';
+		return 1;
+	case eolCRLF:
+		dst[0] = '\r';
+		dst[1] = '\n';
+		return 2;
+	case eolNOT:
+		assert(!"EOL sequence not selected!");
+		break;
+	}
+	return 0;
+}
+typedef struct aFileOut
+{
+	char * buf;
+	usize len, total;
+	HANDLE hFile;
+	// Instead of writing, output is compared with cmp (if not NULL)
+	const char * cmp;
+	usize cmpSize;
+	// Cleared on error or mismatch
+	bool ok;
+
+} aFileOut_t;
+
+static bool aFile_outRaw(aFileOut_t * restrict out, const char * restrict src, usize len)
+{
+	if (out->cmp != NULL)
+	{
+		out->ok = out->ok && ((out->total + len) <= out->cmpSize) && (memcmp(src, out->cmp + out->total, len) == 0);
+		out->total += len;
+		return out->ok;
+	}
+
+	usize written = 0;
+	while (out->ok && (written < len))
+	{
+		DWORD dwWritten = 0;
+		out->ok = WriteFile(out->hFile, src + written, (DWORD)min_usize(len - written, ATTO_IO_CHUNK), &dwWritten, NULL) != FALSE;
+		written += dwWritten;
+	}
+	out->total += len;
+	return out->ok;
+}
+static bool aFile_outFlush(aFileOut_t * restrict out)
+{
+	const usize len = out->len;
+	out->len = 0;
+	return aFile_outRaw(out, out->buf, len);
+}
+static void aFile_outBytes(aFileOut_t * restrict out, const char * restrict src, usize len)
+{
+	// Long runs of encoded text skip the buffer
+	if ((len >= ATTO_WRITE_BUF) && aFile_outFlush(out))
+	{
+		aFile_outRaw(out, src, len);
+		return;
+	}
+	while (out->ok && (len > 0))
+	{
+		const usize n = min_usize(len, ATTO_WRITE_BUF - out->len);
+		memcpy(out->buf + out->len, src, n);
+		out->len += n;
+		src += n;
+		len  -= n;
+		if (out->len == ATTO_WRITE_BUF)
+		{
+			aFile_outFlush(out);
+		}
+	}
+}
+static void aFile_outW(aFileOut_t * restrict out, const wchar * restrict src, usize len)
+{
+	while (out->ok && (len > 0))
+	{
+		usize n = min_usize(len, (ATTO_WRITE_BUF - out->len) / ATTO_UTF_MAX_U8);
+		// Surrogate pairs are encoded in one go
+		if ((n > 0) && (n < len) && (src[n - 1] >= 0xD800) && (src[n - 1] < 0xDC00))
+		{
+			--n;
+		}
+		if (n == 0)
+		{
+			aFile_outFlush(out);
+			continue;
+		}
+		out->len += aUtf_toU8(src, n, out->buf + out->len);
+		src += n;
+		len -= n;
+	}
+}
+static usize aFile_spanU8(const aFile_t * restrict self, const aLine_t * restrict span, aFileOut_t * restrict out)
+{
+	// Outputs span bytes (if out is not NULL) with current EOL sequence, returns number of bytes
+	const char * restrict mem = self->map.mem + span->curx;
+	if (self->eolSeq == self->data.spanEol)
+	{
+		if (out != NULL)
+		{
+			aFile_outBytes(out, mem, span->u8len);
+		}
+		return span->u8len;
+	}
+
+	char eol[2];
+	const usize eolLen = aFile_putEol(self->eolSeq, eol);
+	usize pos = 0, bytes = 0;
+	for (usize i = 0, lines = span->idx.lines; i < lines; ++i)
+	{
+		const usize start = pos;
+		usize lineEnd;
+		aFile_spanLine(mem, span->u8len, &pos, &lineEnd);
+		const usize addEol = ((i + 1) < lines) ? eolLen : 0;
+		if (out != NULL)
+		{
+			aFile_outBytes(out, mem + start, lineEnd - start);
+			aFile_outBytes(out, eol, addEol);
+		}
+		bytes += lineEnd - start + addEol;
+	}
+	return bytes;
+}
+static usize aFile_lineU8(const aFile_t * restrict self, const aLine_t * restrict node, aFileOut_t * restrict out)
+{
+	// Outputs encoded line (if out is not NULL), returns number of bytes
+	if (aLine_isSpan(node))
+	{
+		return aFile_spanU8(self, node, out);
+	}
+	else if (aLine_isPacked(node))
+	{
+		if (out != NULL)
+		{
+			aFile_outBytes(out, node->u8, node->u8len);
+		}
+		return node->u8len;
+	}
+
+	const usize tailStart = node->curx + node->freeSpaceLen, tailLen = node->lineEndx - tailStart;
+	if (out == NULL)
+	{
+		return aUtf_u8Len(node->line, node->curx) + aUtf_u8Len(node->line + tailStart, tailLen);
+	}
+	const usize before = out->total + out->len;
+	aFile_outW(out, node->line, node->curx);
+	aFile_outW(out, node->line + tailStart, tailLen);
+	return out->total + out->len - before;
+}
+static bool aFile_outputPieces(aFile_t * restrict self, aFileOut_t * restrict out)
+{
+	// Pieces are encoded as they are, line breaks are replaced by the EOL sequence
+	char eol[2];
+	const usize eolLen = aFile_putEol(self->eolSeq, eol);
+	const aPTable_t * restrict pt = &self->data.ptable;
+	for (usize i = 0; (i < pt->numPieces) && out->ok; ++i)
+	{
+		const aPiece_t * restrict p = &pt->pieces[i];
+		const wchar * restrict text = (p->isAdd ? pt->add.mem : pt->orig.mem) + p->start;
+		for (usize pos = 0; pos < p->len;)
+		{
+			const wchar * restrict brk = wmemchr(text + pos, L'\n', p->len - pos);
+			const usize end = (brk != NULL) ? (usize)(brk - text) : p->len;
+			aFile_outW(out, text + pos, end - pos);
+			if (brk != NULL)
+			{
+				aFile_outBytes(out, eol, eolLen);
+			}
+			pos = end + 1;
+		}
+	}
+	return aFile_outFlush(out);
+}
+static bool aFile_output(aFile_t * restrict self, aFileOut_t * restrict out)
+{
+	if (self->pieceTable)
+	{
+		return aFile_outputPieces(self, out);
+	}
+
+	// Streams whole document through out, stops early on error
+	char eol[2];
+	const usize eolLen = aFile_putEol(self->eolSeq, eol);
+	for (const aLine_t * node = self->data.firstNode; (node != NULL) && out->ok; node = node->nextNode)
+	{
+		aFile_lineU8(self, node, out);
+		if (node->nextNode != NULL)
+		{
+			aFile_outBytes(out, eol, eolLen);
+		}
+	}
+	return aFile_outFlush(out);
+}
+
+typedef struct aFileScan
+{
+	struct aFileLoad * load;
+	const char * mem;
+	usize start, end;
+	bool last;
+
+	// Start offset, end offset & number of lines of each span
+	usize * spans;
+	usize numSpans, capSpans;
+	usize scanned;
+	// Valid only when done is set
+	aEolCensus_t eols;
+	bool ok, done;
+
+} aFileScan_t;
+
+/*
+	Mapped files are scanned by worker threads, that publish spans under
+	the lock as they find them. Only the editor thread touches the document,
+	it takes published spans in file order, see aFile_pollLoad.
+*/
+typedef struct aFileLoad
+{
+	aThreadLock_t lock;
+	bool stop;
+
+	aFileScan_t scans[ATTO_LOAD_THREADS];
+	aThread_t threads[ATTO_LOAD_THREADS];
+	usize numParts, size;
+	// Part being taken in & number of its spans taken so far
+	usize part, adopted;
+
+} aFileLoad_t;
+
+static void aFile_endLoad(aFile_t * restrict self)
+{
+	aFileLoad_t * restrict load = self->data.load;
+	if (load == NULL)
+	{
+		return;
+	}
+
+	aThread_lock(&load->lock);
+	load->stop = true;
+	aThread_unlock(&load->lock);
+	for (usize i = 0; i < load->numParts; ++i)
+	{
+		aThread_join(&load->threads[i]);
+		free(load->scans[i].spans);
+	}
+	aThread_lockDestroy(&load->lock);
+	free(load);
+	self->data.load = NULL;
+}
+
+static void aFile_getStamp(const aFile_t * restrict self, aFileStamp_t * restrict stamp)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!GetFileAttributesExW(self->fileName, GetFileExInfoStandard, &attr))
+	{
+		*stamp = (aFileStamp_t){ .size = 0, .time = 0, .exists = false };
+		return;
+	}
+	*stamp = (aFileStamp_t){
+		.size   = ((u64)attr.nFileSizeHigh << 32) | (u64)attr.nFileSizeLow,
+		.time   = ((u64)attr.ftLastWriteTime.dwHighDateTime << 32) | (u64)attr.ftLastWriteTime.dwLowDateTime,
+		.exists = true
+	};
+}
+static bool aFile_sameStamp(const aFileStamp_t * restrict a, const aFileStamp_t * restrict b)
+{
+	return (a->exists == b->exists) && (a->size == b->size) && (a->time == b->time);
+}
+
+void aFile_reset(aFile_t * restrict self)
+{
+	(*self) = (aFile_t){
+		.fileName = NULL,
+		.hFile    = INVALID_HANDLE_VALUE,
+		.canWrite = false,
+		.eolSeq   = eolNOT,
+		.gen         = 0,
+		.savedGen    = 0,
+		.durableSave = false,
+		.pieceTable  = false,
+		.data        = {
+			.firstNode   = NULL,
+			.currentNode = NULL,
+			.pcury       = NULL,
+			.curx        = 0,
+			.load        = NULL,
+			.save        = NULL,
+			.saveGen     = 0,
+			.saveEol     = eolNOT,
+			.editNode    = NULL,
+			.editFrom    = 0,
+			.editGen     = 0
+		}
+	};
+	aMap_reset(&self->map);
+	self->eols  = (aEolCensus_t){ .crlf = 0, .lf = 0, .cr = 0 };
+	self->stamp = (aFileStamp_t){ .size = 0, .time = 0, .exists = false };
+	self->data.spanEol = eolNOT;
+	aLineIdx_reset(&self->data.lineIdx);
+	aArena_init(&self->data.arena, sizeof(aLine_t));
+	aUndo_init(&self->data.undo, ATTO_UNDO_BUDGET);
+	aJournal_init(&self->data.journal);
+	aPTable_init(&self->data.ptable, NULL, 0);
+	self->data.ptTop     = 0;
+	self->data.ptLine    = NULL;
+	self->data.ptLineCap = 0;
+}
+bool aFile_open(aFile_t * restrict self, const wchar * restrict fileName, bool writemode)
+{
+	fileName = (fileName == NULL) ? self->fileName : fileName;
+
+	// try to open file
+	self->hFile = CreateFileW(
+		fileName,
+		writemode ? GENERIC_WRITE : GENERIC_READ,
+		FILE_SHARE_READ,
+		NULL,
+		writemode ? CREATE_ALWAYS : OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+	if (self->hFile == INVALID_HANDLE_VALUE)
+	{
+		self->canWrite = false;
+		return false;
+	}
+	else
+	{
+		self->canWrite = writemode;
+		self->fileName = fileName;
+		return true;
+	}
+}
+void aFile_close(aFile_t * restrict self)
+{
+	if (self->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(self->hFile);
+		self->hFile = INVALID_HANDLE_VALUE;
+	}
+}
+void aFile_clearLines(aFile_t * restrict self)
+{
+	// Workers read the mapping, they have to be stopped first
+	aFile_finishSave(self);
+	aFile_endLoad(self);
+	self->data.firstNode   = NULL;
+	self->data.currentNode = NULL;
+	self->data.pcury       = NULL;
+	self->data.numCompact  = 0;
+	aLineIdx_reset(&self->data.lineIdx);
+	// All nodes & line buffers are released at once
+	aArena_clear(&self->data.arena);
+	aMap_close(&self->map);
+	self->eols = (aEolCensus_t){ .crlf = 0, .lf = 0, .cr = 0 };
+	aUndo_clear(&self->data.undo);
+	aPTable_destroy(&self->data.ptable);
+	aPTable_init(&self->data.ptable, NULL, 0);
+	self->data.ptTop = 0;
+}
+const wchar * aFile_readBytes(aFile_t * restrict self, char ** restrict bytes, usize * restrict bytesLen)
+{
+	if (aFile_open(self, NULL, false) == false)
+	{
+		return L"File opening error!";
+	}
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(self->hFile, &size))
+	{
+		aFile_close(self);
+		return L"File read error!";
+	}
+	const usize fileSize = (usize)size.QuadPart;
+	if ((fileSize >= *bytesLen) || (*bytes == NULL))
+	{
+		vptr mem = realloc(*bytes, fileSize + 1);
+		if (mem == NULL)
+		{
+			aFile_close(self);
+			return L"Memory error!";
+		}
+		*bytes    = mem;
+		*bytesLen = fileSize + 1;
+	}
+
+	// ReadFile can only read up to 4 GiB at a time
+	BOOL readFileRes = TRUE;
+	for (usize total = 0; readFileRes && (total < fileSize);)
+	{
+		DWORD dwRead = 0;
+		readFileRes = ReadFile(
+			self->hFile,
+			*bytes + total,
+			(DWORD)min_usize(fileSize - total, ATTO_IO_CHUNK),
+			&dwRead,
+			NULL
+		);
+		readFileRes = readFileRes && (dwRead > 0);
+		total += dwRead;
+	}
+	aFile_close(self);
+	if (!readFileRes)
+	{
+		return L"File read error!";
+	}
+	// Add null terminator
+	(*bytes)[fileSize] = '\0';
+
+	return NULL;
+}
+static bool aFile_carry(char ** restrict carry, usize * restrict carryLen, usize * restrict carryCap, const char * restrict bytes, usize len)
+{
+	if (len == 0)
+	{
+		return true;
+	}
+	else if ((*carryLen + len) > *carryCap)
+	{
+		const usize newCap = (*carryLen + len) * 2;
+		vptr mem = realloc(*carry, newCap);
+		if (mem == NULL)
+		{
+			return false;
+		}
+		*carry    = mem;
+		*carryCap = newCap;
+	}
+	memcpy(*carry + *carryLen, bytes, len);
+	*carryLen += len;
+	return true;
+}
+static bool aFile_appendLine(aFile_t * restrict self, const char * restrict bytes, usize len)
+{
+	// Lines are stored packed until the cursor visits them
+	aLine_t * node = aLine_createU8(&self->data.arena, self->data.currentNode, NULL, bytes, len);
+	if (node == NULL)
+	{
+		return false;
+	}
+	else if (self->data.firstNode == NULL)
+	{
+		self->data.firstNode = node;
+		aLineIdx_insertFirst(&self->data.lineIdx, &node->idx);
+	}
+	self->data.currentNode = node;
+	return true;
+}
+static void aFile_emptyLines(aFile_t * restrict self)
+{
+	// Leave a consistent, empty document behind
+	aFile_clearLines(self);
+	self->data.firstNode = aLine_create(&self->data.arena, NULL, NULL);
+	if (self->data.firstNode != NULL)
+	{
+		aLineIdx_insertFirst(&self->data.lineIdx, &self->data.firstNode->idx);
+	}
+	self->data.currentNode = self->data.firstNode;
+}
+static bool aFile_addSpan(aFileScan_t * restrict self, usize start, usize end, usize lines)
+{
+	if (self->numSpans == self->capSpans)
+	{
+		const usize newCap = (self->capSpans == 0) ? 64 : (self->capSpans * 2);
+		vptr mem = realloc(self->spans, sizeof(usize) * 3 * newCap);
+		if (mem == NULL)
+		{
+			return false;
+		}
+		self->spans    = mem;
+		self->capSpans = newCap;
+	}
+	usize * restrict span = &self->spans[3 * self->numSpans];
+	span[0] = start;
+	span[1] = end;
+	span[2] = lines;
+	++self->numSpans;
+	return true;
+}
+static void aFile_scanPart(vptr arg)
+{
+	aFileScan_t * restrict self = arg;
+	aFileLoad_t * restrict load = self->load;
+	// Only line boundaries of every ATTO_MAP_SPAN_LINES-th line are remembered,
+	// every part but the last one ends right after an EOL sequence
+	bool ok = true;
+	aEolCensus_t eols = { .crlf = 0, .lf = 0, .cr = 0 };
+	for (usize pos = self->start, start = pos, lines = 0; self->last || (pos < self->end);)
+	{
+		usize lineEnd;
+		const eolSeq_e eol = aFile_spanLine(self->mem, self->end, &pos, &lineEnd);
+		aFile_countEol(&eols, eol);
+		++lines;
+		if ((eol == eolNOT) || (lines == ATTO_MAP_SPAN_LINES) || (!self->last && (pos == self->end)))
+		{
+			aThread_lock(&load->lock);
+			ok = !load->stop && aFile_addSpan(self, start, lineEnd, lines);
+			self->scanned = pos - self->start;
+			aThread_unlock(&load->lock);
+			if (!ok || (eol == eolNOT))
+			{
+				break;
+			}
+			start = pos;
+			lines = 0;
+		}
+	}
+
+	aThread_lock(&load->lock);
+	self->eols = eols;
+	self->ok   = ok;
+	self->done = true;
+	aThread_unlock(&load->lock);
+}
+static usize aFile_splitScan(aFileLoad_t * restrict load, const char * restrict mem, usize size)
+{
+	const usize parts = min_usize(min_usize(aThread_cpus(), ATTO_LOAD_THREADS), max_usize(1, size / ATTO_LOAD_PART_MIN));
+
+	// Parts are cut right after an EOL sequence, a CRLF is never split
+	usize numParts = 0;
+	for (usize i = 0, start = 0; i < parts; ++i)
+	{
+		usize end = size;
+		if ((i + 1) < parts)
+		{
+			usize pos = max_usize(start, size / parts * (i + 1)), lineEnd;
+			pos -= ((pos > start) && (mem[pos - 1] == '\r')) ? 1 : 0;
+			aFile_spanLine(mem, size, &pos, &lineEnd);
+			end = pos;
+		}
+		load->scans[numParts] = (aFileScan_t){
+			.load     = load,
+			.mem      = mem,
+			.start    = start,
+			.end      = end,
+			.last     = (end == size),
+			.spans    = NULL,
+			.numSpans = 0,
+			.capSpans = 0,
+			.eols     = { .crlf = 0, .lf = 0, .cr = 0 },
+			.scanned  = 0,
+			.ok       = false,
+			.done     = false
+		};
+		++numParts;
+		start = end;
+		if (end == size)
+		{
+			break;
+		}
+	}
+	return numParts;
+}
+static const wchar * aFile_readMapped(aFile_t * restrict self)
+{
+	aFile_clearLines(self);
+	if (!aMap_open(&self->map, self->fileName))
+	{
+		aFile_emptyLines(self);
+		return L"File mapping error!";
+	}
+
+	aFileLoad_t * restrict load = malloc(sizeof(aFileLoad_t));
+	if (load == NULL)
+	{
+		aFile_emptyLines(self);
+		return L"Memory error!";
+	}
+	aThread_lockInit(&load->lock);
+	load->stop     = false;
+	load->size     = self->map.size;
+	load->part     = 0;
+	load->adopted  = 0;
+	load->numParts = aFile_splitScan(load, self->map.mem, self->map.size);
+	self->data.load = load;
+	aPROF_START(prof);
+	for (usize i = 0; i < load->numParts; ++i)
+	{
+		// Parts, that didn't get a thread, are scanned right away
+		if (!aThread_create(&load->threads[i], &aFile_scanPart, &load->scans[i]))
+		{
+			aFile_scanPart(&load->scans[i]);
+		}
+	}
+
+	// Rest of the file keeps loading in the background
+	const wchar * res = NULL;
+	while ((res == NULL) && (self->data.currentNode == NULL))
+	{
+		res = aFile_pollLoad(self);
+		if ((res == NULL) && (self->data.currentNode == NULL))
+		{
+			Sleep(1);
+		}
+	}
+	aPROF_END(prof, "aFile_readMapped (first lines)", 0, "");
+	return res;
+}
+const wchar * aFile_pollLoad(aFile_t * restrict self)
+{
+	aFileLoad_t * restrict load = self->data.load;
+	if (load == NULL)
+	{
+		return NULL;
+	}
+
+	// New spans go after the last line, even if it was added while loading
+	aLine_t * tail = NULL;
+	if (self->data.firstNode != NULL)
+	{
+		tail = aLine_fromIdx(aLineIdx_at(&self->data.lineIdx, aLineIdx_lines(&self->data.lineIdx) - 1, NULL));
+	}
+
+	const wchar * res = NULL;
+	aThread_lock(&load->lock);
+	while (load->part < load->numParts)
+	{
+		aFileScan_t * restrict scan = &load->scans[load->part];
+		for (; load->adopted < scan->numSpans; ++load->adopted)
+		{
+			const usize * restrict span = &scan->spans[3 * load->adopted];
+			tail = aFile_createSpan(self, tail, span[0], span[1], span[2]);
+			if (tail == NULL)
+			{
+				res = L"Line creation error!";
+				break;
+			}
+			self->data.firstNode = (self->data.firstNode == NULL) ? tail : self->data.firstNode;
+		}
+		if ((res != NULL) || !scan->done)
+		{
+			break;
+		}
+		else if (!scan->ok)
+		{
+			res = L"Line creation error!";
+			break;
+		}
+		self->eols.crlf += scan->eols.crlf;
+		self->eols.lf   += scan->eols.lf;
+		self->eols.cr   += scan->eols.cr;
+		++load->part;
+		load->adopted = 0;
+	}
+	const bool finished = (load->part == load->numParts);
+	aThread_unlock(&load->lock);
+
+	// First lines are shown as soon as they exist
+	if ((res == NULL) && (self->data.currentNode == NULL) && (self->data.firstNode != NULL))
+	{
+		self->data.currentNode = aFile_materialise(self, self->data.firstNode, 0);
+		if ((self->data.currentNode == NULL) || !aLine_unpack(&self->data.arena, self->data.currentNode))
+		{
+			res = L"Line creation error!";
+		}
+	}
+	if (res != NULL)
+	{
+		aFile_emptyLines(self);
+		return res;
+	}
+	else if (finished)
+	{
+		aFile_endLoad(self);
+		aFile_pickEol(self);
+		// Spans with mixed EOL sequences are always converted when saving
+		self->data.spanEol = aFile_mixedEol(self) ? eolNOT : self->eolSeq;
+	}
+	return NULL;
+}
+const wchar * aFile_finishLoad(aFile_t * restrict self)
+{
+	const wchar * res = NULL;
+	while ((res == NULL) && aFile_loading(self))
+	{
+		res = aFile_pollLoad(self);
+		if ((res == NULL) && aFile_loading(self))
+		{
+			Sleep(1);
+		}
+	}
+	return res;
+}
+bool aFile_loading(const aFile_t * restrict self)
+{
+	return self->data.load != NULL;
+}
+usize aFile_loadProgress(const aFile_t * restrict self)
+{
+	aFileLoad_t * restrict load = self->data.load;
+	if (load == NULL)
+	{
+		return 100;
+	}
+
+	usize scanned = 0;
+	aThread_lock(&load->lock);
+	for (usize i = 0; i < load->numParts; ++i)
+	{
+		scanned += load->scans[i].scanned;
+	}
+	aThread_unlock(&load->lock);
+	return (usize)((f64)scanned * 100.0 / (f64)load->size);
+}
+static usize aFile_normaliseEols(wchar * restrict text, usize len)
+{
+	// CRLF & lone CR become LF in place
+	usize out = 0;
+	for (usize i = 0; i < len; ++i)
+	{
+		if (text[i] == L'\r')
+		{
+			text[out++] = L'\n';
+			i += (((i + 1) < len) && (text[i + 1] == L'\n')) ? 1 : 0;
+		}
+		else
+		{
+			text[out++] = text[i];
+		}
+	}
+	return out;
+}
+static const wchar * aFile_readPieces(aFile_t * restrict self)
+{
+	aPROF_START(prof);
+	char * bytes = NULL;
+	usize bytesLen = 0;
+	const wchar * res = aFile_readBytes(self, &bytes, &bytesLen);
+	if (res != NULL)
+	{
+		free(bytes);
+		return res;
+	}
+	aFile_clearLines(self);
+
+	const usize size = bytesLen - 1;
+	wchar * text = malloc(sizeof(wchar) * max_usize(1, aUtf_wLen(bytes, size)));
+	if (text == NULL)
+	{
+		free(bytes);
+		return L"Memory error!";
+	}
+	usize len = aUtf_toW(bytes, size, text);
+	free(bytes);
+
+	// Table only breaks lines on LF, other EOL sequences are counted & replaced
+	for (usize i = 0; i < len; ++i)
+	{
+		if (text[i] == L'\n')
+		{
+			aFile_countEol(&self->eols, eolLF);
+		}
+		else if (text[i] == L'\r')
+		{
+			const bool isLF = ((i + 1) < len) && (text[i + 1] == L'\n');
+			aFile_countEol(&self->eols, isLF ? eolCRLF : eolCR);
+			i += isLF ? 1 : 0;
+		}
+	}
+	aFile_pickEol(self);
+	len = aFile_normaliseEols(text, len);
+
+	if (!aPTable_init(&self->data.ptable, text, len))
+	{
+		aPTable_init(&self->data.ptable, NULL, 0);
+		return L"Memory error!";
+	}
+	aPROF_END(prof, "aFile_readPieces", size, "bytes");
+	return NULL;
+}
+const wchar * aFile_read(aFile_t * restrict self)
+{
+	LARGE_INTEGER size;
+	BOOL sizeRes = FALSE;
+	if (aFile_open(self, NULL, false))
+	{
+		sizeRes = GetFileSizeEx(self->hFile, &size);
+		aFile_close(self);
+	}
+	// Contents are in sync with the file from now on
+	aFile_getStamp(self, &self->stamp);
+	self->savedGen = self->gen;
+
+	if (self->pieceTable)
+	{
+		return aFile_readPieces(self);
+	}
+	// Big files are mapped, their lines are created only when needed
+	else if (sizeRes && ((usize)size.QuadPart >= ATTO_MAP_MIN_SIZE))
+	{
+		return aFile_readMapped(self);
+	}
+
+	aPROF_START(prof);
+	if (aFile_open(self, NULL, false) == false)
+	{
+		return L"File opening error!";
+	}
+	char * chunk = malloc(ATTO_READ_CHUNK);
+	if (chunk == NULL)
+	{
+		aFile_close(self);
+		return L"Memory error!";
+	}
+
+	aFile_clearLines(self);
+
+	// Bytes are split to lines as they arrive, only the unfinished line is carried over
+	const wchar * res = NULL;
+	char * carry = NULL;
+	usize carryLen = 0, carryCap = 0, total = 0;
+	bool pendingCR = false;
+	while (res == NULL)
+	{
+		DWORD dwRead = 0;
+		if (!ReadFile(self->hFile, chunk, ATTO_READ_CHUNK, &dwRead, NULL))
+		{
+			res = L"File read error!";
+			break;
+		}
+		else if (dwRead == 0)
+		{
+			break;
+		}
+		total += dwRead;
+
+		usize start = 0;
+		// CRLF pair straddles chunks
+		if (pendingCR)
+		{
+			const bool isLF = (chunk[0] == '\n');
+			aFile_countEol(&self->eols, isLF ? eolCRLF : eolCR);
+			start = isLF ? 1 : 0;
+			pendingCR = false;
+		}
+
+		for (usize i = start; i < dwRead; ++i)
+		{
+			i += aUtf_findEol(chunk + i, dwRead - i);
+			if (i == dwRead)
+			{
+				break;
+			}
+
+			const char * line = chunk + start;
+			usize lineLen = i - start;
+			if (carryLen > 0)
+			{
+				if (!aFile_carry(&carry, &carryLen, &carryCap, line, lineLen))
+				{
+					res = L"Memory error!";
+					break;
+				}
+				line    = carry;
+				lineLen = carryLen;
+				carryLen = 0;
+			}
+			if (!aFile_appendLine(self, line, lineLen))
+			{
+				res = L"Line creation error!";
+				break;
+			}
+
+			if (chunk[i] == '\n')
+			{
+				aFile_countEol(&self->eols, eolLF);
+			}
+			else if ((i + 1) == dwRead)
+			{
+				pendingCR = true;
+			}
+			else if (chunk[i + 1] == '\n')
+			{
+				aFile_countEol(&self->eols, eolCRLF);
+				++i;
+			}
+			else
+			{
+				aFile_countEol(&self->eols, eolCR);
+			}
+			start = i + 1;
+		}
+		// Multi-byte sequences can't get split, carried bytes aren't decoded yet
+		if ((res == NULL) && !aFile_carry(&carry, &carryLen, &carryCap, chunk + start, dwRead - start))
+		{
+			res = L"Memory error!";
+		}
+	}
+	aFile_close(self);
+	free(chunk);
+	if (pendingCR)
+	{
+		aFile_countEol(&self->eols, eolCR);
+	}
+	aFile_pickEol(self);
+
+	// Last line doesn't end with EOL
+	if ((res == NULL) && !aFile_appendLine(self, carry, carryLen))
+	{
+		res = L"Line creation error!";
+	}
+	free(carry);
+
+	// Last line becomes current, so it has to be editable
+	if ((res == NULL) && !aLine_unpack(&self->data.arena, self->data.currentNode))
+	{
+		res = L"Line creation error!";
+	}
+	if (res != NULL)
+	{
+		aFile_emptyLines(self);
+		return res;
+	}
+
+	aPROF_END(prof, "aFile_read", total, "bytes");
+	return NULL;
+}
+static wchar * aFile_tempName(const aFile_t * restrict self)
+{
+	const usize len = wcslen(self->fileName), suffixLen = wcslen(ATTO_SAVE_SUFFIX);
+	wchar * name = malloc(sizeof(wchar) * (len + suffixLen + 1));
+	if (name != NULL)
+	{
+		memcpy(name, self->fileName, sizeof(wchar) * len);
+		memcpy(name + len, ATTO_SAVE_SUFFIX, sizeof(wchar) * (suffixLen + 1));
+	}
+	return name;
+}
+static isize aFile_writeMapped(aFile_t * restrict self, aFileOut_t * restrict out)
+{
+	// Mapped file can't be overwritten while spans refer to it, a sibling file is written instead
+	wchar * tempName = aFile_tempName(self);
+	if (tempName == NULL)
+	{
+		return afwrMEM_ERROR;
+	}
+	const wchar * fileName = self->fileName;
+	isize result;
+	if (aFile_open(self, tempName, true) == false)
+	{
+		self->fileName = fileName;
+		free(tempName);
+		return afwrOPEN_ERROR;
+	}
+	self->fileName = fileName;
+	out->hFile = self->hFile;
+	result = aFile_output(self, out) ? (isize)out->total : afwrWRITE_ERROR;
+	aFile_close(self);
+
+	// Empty file can't be mapped, but then no span refers to it either
+	aMap_t map;
+	aMap_reset(&map);
+	if ((result > 0) && (!aMap_open(&map, tempName) || (map.size != out->total)))
+	{
+		if (aMap_active(&map))
+		{
+			aMap_close(&map);
+		}
+		result = afwrWRITE_ERROR;
+	}
+	if (result < 0)
+	{
+		DeleteFileW(tempName);
+		free(tempName);
+		return result;
+	}
+
+	// Spans are moved to the new file before the old one is let go
+	char eol[2];
+	const usize eolLen = aFile_putEol(self->eolSeq, eol);
+	usize offset = 0;
+	for (aLine_t * node = self->data.firstNode; node != NULL; node = node->nextNode)
+	{
+		const usize bytes = aFile_lineU8(self, node, NULL);
+		if (aLine_isSpan(node))
+		{
+			node->curx  = offset;
+			node->u8len = bytes;
+		}
+		offset += bytes + ((node->nextNode != NULL) ? eolLen : 0);
+	}
+	self->data.spanEol = self->eolSeq;
+	aMap_close(&self->map);
+	self->map = map;
+
+	// On failure document still refers to the written copy
+	if (!MoveFileExW(tempName, self->fileName, MOVEFILE_REPLACE_EXISTING))
+	{
+		result = afwrWRITE_ERROR;
+	}
+	free(tempName);
+	return result;
+}
+static bool aFile_remap(aFile_t * restrict self)
+{
+	// Spans keep their offsets, only the view is renewed
+	aMap_t map;
+	if (!aMap_open(&map, self->fileName))
+	{
+		return false;
+	}
+	aMap_close(&self->map);
+	self->map = map;
+	return true;
+}
+static bool aFile_sameOnDisc(const aFile_t * restrict self, aFileOut_t * restrict cmp, const aLine_t * restrict node, usize * restrict offset)
+{
+	// Checks whether line & its EOL are in the mapping at offset, which is then moved past them
+	char eol[2];
+	const usize eolLen = (node->nextNode != NULL) ? aFile_putEol(self->eolSeq, eol) : 0;
+	if (aLine_isSpan(node))
+	{
+		// Untouched span is where it was loaded from, only its EOL can differ
+		const usize end = node->curx + node->u8len;
+		if ((node->curx != *offset) || (self->data.spanEol != self->eolSeq) || ((end + eolLen) > self->map.size) ||
+			(memcmp(self->map.mem + end, eol, eolLen) != 0))
+		{
+			return false;
+		}
+		*offset = end + eolLen;
+		return true;
+	}
+
+	cmp->len   = 0;
+	cmp->total = *offset;
+	cmp->ok    = true;
+	aFile_lineU8(self, node, cmp);
+	aFile_outBytes(cmp, eol, eolLen);
+	if (!aFile_outFlush(cmp))
+	{
+		return false;
+	}
+	*offset = cmp->total;
+	return true;
+}
+static bool aFile_seekOut(aFileOut_t * restrict out, usize offset)
+{
+	if ((out->total + out->len) == offset)
+	{
+		return out->ok;
+	}
+	LARGE_INTEGER pos;
+	pos.QuadPart = (LONGLONG)offset;
+	out->ok = aFile_outFlush(out) && SetFilePointerEx(out->hFile, pos, NULL, FILE_BEGIN);
+	out->total = offset;
+	return out->ok;
+}
+static bool aFile_writeInPlace(aFile_t * restrict self, aFileOut_t * restrict out, char * restrict cmpBuf, isize * restrict result)
+{
+	// Only the changed part of a mapped file is written, returns false if the whole file has to be
+	if (self->stamp.size != (u64)self->map.size)
+	{
+		// View doesn't cover the file as it was last saved
+		return false;
+	}
+	char eol[2];
+	const usize eolLen = aFile_putEol(self->eolSeq, eol);
+	aFileOut_t cmp = {
+		.buf     = cmpBuf,
+		.len     = 0,
+		.total   = 0,
+		.hFile   = INVALID_HANDLE_VALUE,
+		.cmp     = self->map.mem,
+		.cmpSize = self->map.size,
+		.ok      = true
+	};
+
+	// Everything before the first changed line stays as it is
+	usize start = 0;
+	aLine_t * first = self->data.firstNode;
+	while ((first != NULL) && aFile_sameOnDisc(self, &cmp, first, &start))
+	{
+		first = first->nextNode;
+	}
+	if ((first == NULL) && (start == self->map.size))
+	{
+		*result = 0;
+		return true;
+	}
+
+	// Rest can be spliced if nothing has moved, otherwise spans after the change are read to memory
+	usize end = start, spanBytes = 0;
+	bool moved = false;
+	for (const aLine_t * node = first; node != NULL; node = node->nextNode)
+	{
+		if (aLine_isSpan(node))
+		{
+			if (self->data.spanEol != self->eolSeq)
+			{
+				return false;
+			}
+			moved = moved || (node->curx != end);
+			spanBytes += node->u8len;
+		}
+		end += aFile_lineU8(self, node, NULL) + ((node->nextNode != NULL) ? eolLen : 0);
+	}
+	moved = moved || (end != self->map.size);
+	// Mapped file can't be truncated, the old view has to stay until the new one is open
+	if ((end < self->map.size) || (moved && (spanBytes > ATTO_SAVE_SPLICE_MAX)))
+	{
+		return false;
+	}
+	else if (moved)
+	{
+		aLine_t * prev = (first != NULL) ? first->prevNode : NULL;
+		for (aLine_t * node = first; node != NULL;)
+		{
+			aLine_t * next = node->nextNode;
+			if (aLine_isSpan(node) && (aFile_materialise(self, node, 0) == NULL))
+			{
+				*result = afwrMEM_ERROR;
+				return true;
+			}
+			node = next;
+		}
+		first = (prev != NULL) ? prev->nextNode : ((first != NULL) ? self->data.firstNode : NULL);
+	}
+
+	// File can be written while it's mapped, but it can't be created again
+	self->hFile = CreateFileW(
+		self->fileName,
+		GENERIC_WRITE,
+		FILE_SHARE_READ,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+	if (self->hFile == INVALID_HANDLE_VALUE)
+	{
+		*result = afwrOPEN_ERROR;
+		return true;
+	}
+	out->hFile = self->hFile;
+
+	usize written = 0, offset = start;
+	for (const aLine_t * node = first; (node != NULL) && out->ok; node = node->nextNode)
+	{
+		const usize lineStart = offset;
+		if (!moved && aFile_sameOnDisc(self, &cmp, node, &offset))
+		{
+			continue;
+		}
+		aFile_seekOut(out, lineStart);
+		aFile_lineU8(self, node, out);
+		if (node->nextNode != NULL)
+		{
+			aFile_outBytes(out, eol, eolLen);
+		}
+		offset   = out->total + out->len;
+		written += offset - lineStart;
+	}
+	const bool ok = aFile_seekOut(out, end) && aFile_outFlush(out);
+	aFile_close(self);
+
+	// Spans before the change are in place, old view stays valid if the new one can't be opened
+	*result = (ok && aFile_remap(self)) ? (isize)written : afwrWRITE_ERROR;
+	return true;
+}
+static isize aFile_saveCheck(aFile_t * restrict self)
+{
+	// Returns 0 if contents have to be saved
+	if (self->data.save != NULL)
+	{
+		return afwrSAVING;
+	}
+	// Someone else has written to the file, it's only overwritten if saved again
+	aFileStamp_t stamp;
+	aFile_getStamp(self, &stamp);
+	if (!aFile_sameStamp(&stamp, &self->stamp))
+	{
+		self->stamp = stamp;
+		return afwrDISK_CHANGED;
+	}
+	else if (self->gen == self->savedGen)
+	{
+		return afwrNOTHING_NEW;
+	}
+	// Only a fully loaded file can be written
+	else if (aFile_finishLoad(self) != NULL)
+	{
+		return afwrMEM_ERROR;
+	}
+	return 0;
+}
+isize aFile_write(aFile_t * restrict self)
+{
+	const isize check = aFile_saveCheck(self);
+	if (check != 0)
+	{
+		return check;
+	}
+
+	aPROF_START(prof);
+	// Output goes through a fixed buffer, nothing is assembled in memory
+	char * buf = malloc(2 * ATTO_WRITE_BUF);
+	if (buf == NULL)
+	{
+		return afwrMEM_ERROR;
+	}
+	aFileOut_t out = {
+		.buf     = buf,
+		.len     = 0,
+		.total   = 0,
+		.hFile   = INVALID_HANDLE_VALUE,
+		.cmp     = NULL,
+		.cmpSize = 0,
+		.ok      = true
+	};
+
+	isize result;
+	if (aMap_active(&self->map))
+	{
+		if (!aFile_writeInPlace(self, &out, buf + ATTO_WRITE_BUF, &result))
+		{
+			result = aFile_writeMapped(self, &out);
+		}
+	}
+	// Try to open file for writing
+	else if (aFile_open(self, NULL, true) == false)
+	{
+		result = afwrOPEN_ERROR;
+	}
+	else if (self->canWrite == false)
+	{
+		aFile_close(self);
+		result = afwrWRITE_ERROR;
+	}
+	else
+	{
+		out.hFile = self->hFile;
+		result = aFile_output(self, &out) ? (isize)out.total : afwrWRITE_ERROR;
+		aFile_close(self);
+	}
+	free(buf);
+
+	if (result >= 0)
+	{
+		aFile_getStamp(self, &self->stamp);
+		self->savedGen = self->gen;
+		aJournal_rebase(&self->data.journal, true, self->stamp.size, self->stamp.time);
+	}
+	aPROF_END(prof, "aFile_write", out.total, "bytes");
+	return result;
+}
+static bool aFile_snapshotLine(const aFile_t * restrict self, aSave_t * restrict save, const aLine_t * restrict node)
+{
+	// Span is referred to, other lines are encoded right away
+	const usize eolLen = (node->nextNode != NULL) ? save->eolLen : 0;
+	usize bytes = 0;
+	if (aLine_isSpan(node))
+	{
+		if (!aSave_addRef(save, self->map.mem + node->curx, node->u8len, self->data.spanEol != self->eolSeq))
+		{
+			return false;
+		}
+	}
+	else
+	{
+		bytes = aFile_lineU8(self, node, NULL);
+	}
+
+	char * restrict dst = aSave_reserve(save, bytes + eolLen);
+	if (dst == NULL)
+	{
+		return false;
+	}
+	else if (aLine_isSpan(node))
+	{
+		// Only EOL is held
+	}
+	else if (aLine_isPacked(node))
+	{
+		memcpy(dst, node->u8, bytes);
+	}
+	else
+	{
+		const usize tailStart = node->curx + node->freeSpaceLen;
+		const usize headBytes = aUtf_toU8(node->line, node->curx, dst);
+		aUtf_toU8(node->line + tailStart, node->lineEndx - tailStart, dst + headBytes);
+	}
+	memcpy(dst + bytes, save->eol, eolLen);
+	return aSave_use(save, bytes + eolLen);
+}
+static bool aFile_moveSpans(aFile_t * restrict self, const aSave_t * restrict save)
+{
+	// Spans are never created during a save, so each has its run, in the same order
+	// First pass only checks, nothing is changed unless all runs have been found
+	for (u8 pass = 0; pass < 2; ++pass)
+	{
+		usize run = 0;
+		for (aLine_t * node = self->data.firstNode; node != NULL; node = node->nextNode)
+		{
+			if (!aLine_isSpan(node))
+			{
+				continue;
+			}
+			while ((run < save->numRuns) && (save->runs[run].mem != (self->map.mem + node->curx)))
+			{
+				++run;
+			}
+			if (run == save->numRuns)
+			{
+				return false;
+			}
+			else if (pass == 1)
+			{
+				node->curx  = save->runs[run].outOffset;
+				node->u8len = save->runs[run].outLen;
+			}
+			++run;
+		}
+	}
+	return true;
+}
+static isize aFile_endSave(aFile_t * restrict self)
+{
+	aSave_t * restrict save = self->data.save;
+	self->data.save = NULL;
+
+	isize result;
+	switch (aSave_wait(save))
+	{
+	case asrOK:
+		result = (isize)save->written;
+		break;
+	case asrOPEN_ERROR:
+		result = afwrOPEN_ERROR;
+		break;
+	case asrMEM_ERROR:
+		result = afwrMEM_ERROR;
+		break;
+	default:
+		result = afwrWRITE_ERROR;
+	}
+
+	// Spans are moved to the written file, which can still be renamed while it's mapped
+	bool removeTemp = true;
+	aMap_t map;
+	aMap_reset(&map);
+	if ((result > 0) && aMap_active(&self->map) && !aMap_open(&map, save->tempName))
+	{
+		result = afwrWRITE_ERROR;
+	}
+	else if (aMap_active(&map) && !aFile_moveSpans(self, save))
+	{
+		aMap_close(&map);
+		result = afwrWRITE_ERROR;
+	}
+	else if (aMap_active(&map))
+	{
+		aMap_close(&self->map);
+		self->map = map;
+		self->data.spanEol = self->data.saveEol;
+		removeTemp = false;
+	}
+	// Empty file can't be mapped, but then no span holds any bytes either
+	else if ((result == 0) && aMap_active(&self->map) && aFile_moveSpans(self, save))
+	{
+		aMap_close(&self->map);
+		self->data.spanEol = self->data.saveEol;
+	}
+
+	if ((result >= 0) && !aSave_replace(save))
+	{
+		result = afwrWRITE_ERROR;
+	}
+	if (result >= 0)
+	{
+		aFile_getStamp(self, &self->stamp);
+		self->savedGen = self->data.saveGen;
+	}
+	// Edits made during the save stay journaled
+	aJournal_rebase(&self->data.journal, result >= 0, self->stamp.size, self->stamp.time);
+	aSave_destroy(save, removeTemp);
+	free(save);
+	return result;
+}
+isize aFile_startSave(aFile_t * restrict self)
+{
+	// Pieces refer to the table's buffers, they aren't snapshotted
+	if (self->pieceTable)
+	{
+		return aFile_write(self);
+	}
+	const isize check = aFile_saveCheck(self);
+	if (check != 0)
+	{
+		return check;
+	}
+
+	aSave_t * restrict save = malloc(sizeof(aSave_t));
+	if (save == NULL)
+	{
+		return afwrMEM_ERROR;
+	}
+	char eol[2];
+	aSave_init(save, eol, aFile_putEol(self->eolSeq, eol));
+
+	aPROF_START(prof);
+	bool ok = true;
+	for (const aLine_t * node = self->data.firstNode; (node != NULL) && ok; node = node->nextNode)
+	{
+		ok = aFile_snapshotLine(self, save, node);
+	}
+	aPROF_END(prof, "aFile_startSave (snapshot)", save->numBytes, "bytes copied");
+
+	if (!ok || !aSave_start(save, self->fileName))
+	{
+		aSave_destroy(save, false);
+		free(save);
+		return afwrMEM_ERROR;
+	}
+	self->data.save    = save;
+	self->data.saveGen = self->gen;
+	self->data.saveEol = self->eolSeq;
+	aJournal_cut(&self->data.journal);
+	return afwrSAVING;
+}
+bool aFile_saving(const aFile_t * restrict self)
+{
+	return self->data.save != NULL;
+}
+isize aFile_pollSave(aFile_t * restrict self)
+{
+	if (self->data.save == NULL)
+	{
+		return afwrNOTHING_NEW;
+	}
+	else if (!aSave_done(self->data.save))
+	{
+		return afwrSAVING;
+	}
+	return aFile_endSave(self);
+}
+isize aFile_finishSave(aFile_t * restrict self)
+{
+	return (self->data.save == NULL) ? afwrNOTHING_NEW : aFile_endSave(self);
+}
+bool aFile_modified(const aFile_t * restrict self)
+{
+	return self->gen != self->savedGen;
+}
+const aLine_t * aFile_editedLine(const aFile_t * restrict self, usize gen)
+{
+	return ((self->data.editGen == self->gen) && (self->data.editFrom <= gen) && (gen < self->gen)) ? self->data.editNode : NULL;
+}
+void aFile_setEol(aFile_t * restrict self, eolSeq_e eolSeq)
+{
+	if (self->eolSeq != eolSeq)
+	{
+		self->eolSeq = eolSeq;
+		++self->gen;
+		aJournal_add(&self->data.journal, ajoEOL, 0, 0, NULL, (usize)eolSeq);
+	}
+}
+bool aFile_mixedEol(const aFile_t * restrict self)
+{
+	return ((usize)(self->eols.crlf > 0) + (usize)(self->eols.lf > 0) + (usize)(self->eols.cr > 0)) > 1;
+}
+void aFile_setConTitle(const aFile_t * restrict self)
+{
+	wchar wndName[MAX_PATH];
+	const usize fnamelen = min_usize(MAX_PATH - 1, wcslen(self->fileName));
+	memcpy(wndName, self->fileName, fnamelen * sizeof(wchar));
+	wcscpy_s(wndName + fnamelen, MAX_PATH - fnamelen, L" - atto");
+	SetConsoleTitleW(wndName);
+}
+
+
+static void aFile_editLine(aFile_t * restrict self, const aLine_t * restrict node)
+{
+	// Called after an edit, which only changed node; a run of such edits is extended
+	if ((self->data.editNode != node) || (self->data.editGen != (self->gen - 1)))
+	{
+		self->data.editNode = node;
+		self->data.editFrom = self->gen - 1;
+	}
+	self->data.editGen = self->gen;
+}
+static bool aFile_pieceEdit(aFile_t * restrict self, bool ok)
+{
+	// Piece-table edits keep no history & aren't journaled
+	self->gen += ok ? 1 : 0;
+	return ok;
+}
+static void aFile_record(aFile_t * restrict self, auk_e kind, usize col, wchar ch)
+{
+	const usize line = aFile_curLine(self);
+	// History is dropped on memory error, editing goes on
+	aUndo_record(&self->data.undo, kind, line, col, ch);
+	aJournal_add(&self->data.journal, (kind == aukINSERT) ? ajoINSERT : ajoERASE, line, col, (kind == aukINSERT) ? &ch : NULL, 1);
+}
+bool aFile_addNormalCh(aFile_t * restrict self, wchar ch)
+{
+	if (self->pieceTable)
+	{
+		return aFile_pieceEdit(self, aPTable_addNormalCh(&self->data.ptable, ch));
+	}
+	aLine_t * restrict node = self->data.currentNode;
+	if ((node->freeSpaceLen == 0) && !aLine_realloc(&self->data.arena, node))
+	{
+		return false;
+	}
+
+	node->line[node->curx] = ch;
+	++node->curx;
+	--node->freeSpaceLen;
+	aLine_dropTabs(&self->data.arena, node);
+	aLineIdx_setChars(&node->idx, aLine_len(node));
+	++self->gen;
+	aFile_editLine(self, node);
+	aFile_record(self, aukINSERT, node->curx - 1, ch);
+	return true;
+}
+bool aFile_addSpecialCh(aFile_t * restrict self, wchar ch)
+{
+	switch (ch)
+	{
+	case VK_TAB:
+		for (u8 i = 0; i < 4; ++i)
+		{
+			if (aFile_addNormalCh(self, ' ') == false)
+			{
+				return false;
+			}
+		}
+		break;
+	case VK_OEM_BACKTAB:
+		// Check if there's 4 spaces before the caret
+		if (aFile_checkLineAt(self, -4, L"    ", 4))
+		{
+			for (u8 i = 0; i < 4; ++i)
+			{
+				aFile_deleteBackward(self);
+			}
+		}
+		// If there isn't, check if there's 4 spaces after the caret
+		else if (aFile_checkLineAt(self, 0, L"    ", 4))
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				aFile_deleteForward(self);
+			}
+		}
+		break;
+	case VK_RETURN:	// Enter key
+		aFile_addNewLine(self);
+		break;
+	case VK_BACK:	// Backspace
+		aFile_deleteBackward(self);
+		break;
+	case VK_DELETE:	// Delete
+		aFile_deleteForward(self);
+		break;
+	// Move cursor
+	case VK_LEFT:	// Left arrow
+		if (self->pieceTable)
+		{
+			aPTable_moveCursor(&self->data.ptable, -1);
+		}
+		else if (self->data.currentNode->curx > 0)
+		{
+			aLine_moveCursor(self->data.currentNode, -1);
+		}
+		else if (self->data.currentNode->prevNode != NULL)
+		{
+			aFile_setCurrent(self, aFile_prevLine(self, self->data.currentNode));
+		}
+		break;
+	case VK_RIGHT:	// Right arrow
+		if (self->pieceTable)
+		{
+			aPTable_moveCursor(&self->data.ptable, 1);
+		}
+		else if ((self->data.currentNode->curx + self->data.currentNode->freeSpaceLen) < self->data.currentNode->lineEndx)
+		{
+			aLine_moveCursor(self->data.currentNode, 1);
+		}
+		else if (self->data.currentNode->nextNode != NULL)
+		{
+			aFile_setCurrent(self, aFile_nextLine(self, self->data.currentNode));
+		}
+		break;
+	case VK_UP:		// Up arrow
+		if (self->pieceTable)
+		{
+			// Column is kept, as far as the line is long
+			aPTable_t * restrict pt = &self->data.ptable;
+			const usize line = aPTable_curLine(pt);
+			aPTable_setCursor(pt, (line > 0) ? (line - 1) : 0, aPTable_curCol(pt));
+		}
+		else if (self->data.currentNode->prevNode != NULL)
+		{
+			aFile_setCurrent(self, aFile_prevLine(self, self->data.currentNode));
+		}
+		break;
+	case VK_DOWN:	// Down arrow
+		if (self->pieceTable)
+		{
+			aPTable_t * restrict pt = &self->data.ptable;
+			aPTable_setCursor(pt, aPTable_curLine(pt) + 1, aPTable_curCol(pt));
+		}
+		else if (self->data.currentNode->nextNode != NULL)
+		{
+			aFile_setCurrent(self, aFile_nextLine(self, self->data.currentNode));
+		}
+		break;
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+static bool aFile_checkPiecesAt(const aPTable_t * restrict pt, isize maxdelta, const wchar * restrict string, usize maxString)
+{
+	const usize col = aPTable_curCol(pt), len = aPTable_lineLen(pt, aPTable_curLine(pt));
+	if (((isize)col + maxdelta) < 0)
+	{
+		return false;
+	}
+	const usize end = pt->cursor - col + len;
+	usize pos = (usize)((isize)pt->cursor + maxdelta);
+	for (usize i = 0; (i < maxString) && (string[i] != L'\0'); ++i, ++pos)
+	{
+		if ((pos >= end) || (aPTable_charAt(pt, pos) != string[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+bool aFile_checkLineAt(const aFile_t * restrict self, isize maxdelta, const wchar * restrict string, usize maxString)
+{
+	if (self->pieceTable)
+	{
+		return aFile_checkPiecesAt(&self->data.ptable, maxdelta, string, maxString);
+	}
+	const aLine_t * restrict node = self->data.currentNode;
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	isize idx = (isize)node->curx + maxdelta, i = 0;
+	const isize m = (isize)maxString;
+	if (idx < 0)
+	{
+		return false;
+	}
+	for (; idx < (isize)node->lineEndx && i < m && *string != '\0';)
+	{
+		if ((idx == (isize)node->curx) && (node->freeSpaceLen > 0))
+		{
+			idx += (isize)node->freeSpaceLen;
+			continue;
+		}
+		
+		if (node->line[idx] != *string)
+		{
+			return false;
+		}
+
+		++string;
+		++i;
+		++idx;
+	}
+	if (*string != '\0' && i < m)
+	{
+		return false;
+	}
+
+	return true;
+}
+bool aFile_deleteForward(aFile_t * restrict self)
+{
+	if (self->pieceTable)
+	{
+		return aFile_pieceEdit(self, aPTable_deleteForward(&self->data.ptable));
+	}
+	aLine_t * restrict node = self->data.currentNode;
+	if ((node->curx + node->freeSpaceLen) < node->lineEndx)
+	{
+		const wchar ch = node->line[node->curx + node->freeSpaceLen];
+		++node->freeSpaceLen;
+		aLine_dropTabs(&self->data.arena, node);
+		aLineIdx_setChars(&node->idx, aLine_len(node));
+		++self->gen;
+		aFile_editLine(self, node);
+		aFile_record(self, aukDELETE, node->curx, ch);
+		return true;
+	}
+	else if (node->nextNode != NULL)
+	{
+		aLine_t * restrict next = aFile_nextLine(self, node);
+		if ((next == NULL) || !aLine_mergeNext(&self->data.arena, node, &self->data.pcury))
+		{
+			return false;
+		}
+		aFile_unqueueCompact(self, next);
+		++self->gen;
+		aFile_record(self, aukDELETE, node->curx, L'\n');
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+bool aFile_deleteBackward(aFile_t * restrict self)
+{
+	if (self->pieceTable)
+	{
+		return aFile_pieceEdit(self, aPTable_deleteBackward(&self->data.ptable));
+	}
+	aLine_t * restrict node = self->data.currentNode;
+	if (node->curx > 0)
+	{
+		const wchar ch = node->line[node->curx - 1];
+		--node->curx;
+		++node->freeSpaceLen;
+		aLine_dropTabs(&self->data.arena, node);
+		aLineIdx_setChars(&node->idx, aLine_len(node));
+		++self->gen;
+		aFile_editLine(self, node);
+		aFile_record(self, aukBACKSPACE, node->curx, ch);
+		return true;
+	}
+	else if (node->prevNode != NULL)
+	{
+		// Add current node data to previous node data
+		aLine_t * restrict prev = aFile_prevLine(self, node);
+		if ((prev == NULL) || !aLine_mergeNext(&self->data.arena, prev, &self->data.pcury))
+		{
+			return false;
+		}
+		aFile_unqueueCompact(self, node);
+		self->data.currentNode = prev;
+		aFile_unqueueCompact(self, prev);
+		++self->gen;
+		aFile_record(self, aukBACKSPACE, prev->curx, L'\n');
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+bool aFile_addNewLine(aFile_t * restrict self)
+{
+	if (self->pieceTable)
+	{
+		return aFile_pieceEdit(self, aPTable_addNewLine(&self->data.ptable));
+	}
+	aLine_t * restrict node = aLine_create(&self->data.arena, self->data.currentNode, self->data.currentNode->nextNode);
+	if (node == NULL)
+	{
+		return false;
+	}
+
+	self->data.currentNode->nextNode = node;
+	aFile_record(self, aukINSERT, self->data.currentNode->curx, L'\n');
+	aFile_setCurrent(self, node);
+	++self->gen;
+	return true;
+}
+
+static bool aFile_moveTo(aFile_t * restrict self, usize line, usize col)
+{
+	aFile_gotoLine(self, line);
+	if (aFile_curLine(self) != line)
+	{
+		return false;
+	}
+	aLine_moveCursor(self->data.currentNode, (isize)col);
+	return true;
+}
+static bool aFile_putText(aFile_t * restrict self, const wchar * restrict text, usize len)
+{
+	// Inserts text at the cursor, which ends up after it. Lines after the first line
+	// break are all created before anything changes, the last one takes the rest of
+	// the current line; they're spliced in along with their index at once
+	aLine_t * restrict node = self->data.currentNode;
+	const usize line = aFile_curLine(self), col = node->curx;
+	const wchar * restrict brk = wmemchr(text, L'\n', len);
+	if (brk == NULL)
+	{
+		if (!aLine_insert(&self->data.arena, node, text, len))
+		{
+			return false;
+		}
+		++self->gen;
+		aFile_editLine(self, node);
+		aJournal_add(&self->data.journal, ajoINSERT, line, col, text, len);
+		return true;
+	}
+
+	const usize contStart = node->curx + node->freeSpaceLen, contLen = node->lineEndx - contStart;
+	aLine_t * first = NULL, * last = NULL;
+	aLineIdxRun_t run;
+	aLineIdx_runInit(&run);
+	bool ok = true;
+	for (const wchar * start = brk + 1; ok;)
+	{
+		const usize rest = len - (usize)(start - text);
+		const wchar * restrict next = wmemchr(start, L'\n', rest);
+		const usize lineLen = (next == NULL) ? rest : (usize)(next - start);
+		aLine_t * restrict created = aLine_createText(&self->data.arena, NULL, NULL, start, (isize)lineLen);
+		if (created == NULL)
+		{
+			ok = false;
+			break;
+		}
+		created->prevNode = last;
+		if (last == NULL)
+		{
+			first = created;
+		}
+		else
+		{
+			last->nextNode = created;
+		}
+		last = created;
+
+		if (next == NULL)
+		{
+			// Rest of the current line goes after the text
+			if ((created->freeSpaceLen < contLen) && !aLine_resizeGap(&self->data.arena, created, contLen + ATTO_LNODE_DEFAULT_FREE))
+			{
+				ok = false;
+				break;
+			}
+			memcpy(created->line + created->lineEndx - contLen, node->line + contStart, sizeof(wchar) * contLen);
+			created->freeSpaceLen -= contLen;
+			aLineIdx_init(&created->idx, aLine_len(created));
+			aLineIdx_runAppend(&run, &created->idx);
+			break;
 		}
-		self->data.pcury = node;
+		aLineIdx_runAppend(&run, &created->idx);
+		start = next + 1;
 	}
-	else
+
+	// Text before the first line break goes to the current line
+	if (ok)
+	{
+		node->freeSpaceLen += contLen;
+		ok = aLine_insert(&self->data.arena, node, text, (usize)(brk - text));
+		if (!ok)
+		{
+			node->freeSpaceLen -= contLen;
+		}
+	}
+	if (!ok)
+	{
+		while (first != NULL)
+		{
+			aLine_t * restrict next = first->nextNode;
+			aLine_destroy(&self->data.arena, first);
+			first = next;
+		}
+		return false;
+	}
+
+	last->nextNode = node->nextNode;
+	if (node->nextNode != NULL)
+	{
+		node->nextNode->prevNode = last;
+	}
+	node->nextNode  = first;
+	first->prevNode = node;
+	aLineIdx_insertRun(&self->data.lineIdx, &node->idx, &run);
+	aFile_setCurrent(self, last);
+	++self->gen;
+	aJournal_add(&self->data.journal, ajoINSERT, line, col, text, len);
+	return true;
+}
+static bool aFile_eraseText(aFile_t * restrict self, usize len)
+{
+	// Deletes len characters after the cursor, line breaks count as one. Lines
+	// deleted whole are dropped without being merged first
+	aLine_t * restrict node = self->data.currentNode;
+	aJournal_add(&self->data.journal, ajoERASE, aFile_curLine(self), node->curx, NULL, len);
+	bool ok = true;
+	while (ok)
+	{
+		const usize take = min_usize(len, node->lineEndx - node->curx - node->freeSpaceLen);
+		node->freeSpaceLen += take;
+		len -= take;
+		if (len == 0)
+		{
+			break;
+		}
+
+		aLine_t * restrict next = aFile_nextLine(self, node);
+		if (next == NULL)
+		{
+			ok = false;
+			break;
+		}
+		aFile_unqueueCompact(self, next);
+		if (len <= aLine_len(next))
+		{
+			ok = aLine_mergeNext(&self->data.arena, node, &self->data.pcury);
+			--len;
+		}
+		else
+		{
+			node->nextNode = next->nextNode;
+			if (next->nextNode != NULL)
+			{
+				next->nextNode->prevNode = node;
+			}
+			self->data.pcury = (self->data.pcury == next) ? node : self->data.pcury;
+			aLineIdx_remove(&next->idx);
+			len -= aLine_len(next) + 1;
+			aLine_destroy(&self->data.arena, next);
+		}
+	}
+	aLine_dropTabs(&self->data.arena, node);
+	aLineIdx_setChars(&node->idx, aLine_len(node));
+	++self->gen;
+	return ok;
+}
+static bool aFile_insertLines(aFile_t * restrict self, const wchar * restrict text, usize len)
+{
+	if (self->pieceTable)
+	{
+		aPTable_t * restrict pt = &self->data.ptable;
+		if ((len > 0) && !aFile_pieceEdit(self, aPTable_insert(pt, pt->cursor, text, len)))
+		{
+			return false;
+		}
+		pt->cursor += len;
+		return true;
+	}
+	const usize line = aFile_curLine(self), col = self->data.currentNode->curx;
+	if ((len == 0) || !aFile_putText(self, text, len))
+	{
+		return len == 0;
+	}
+
+	// Whole text goes into one undo record, history is dropped on memory error
+	aUndo_recordText(&self->data.undo, line, col, text, len);
+	return true;
+}
+bool aFile_insertText(aFile_t * restrict self, const wchar * restrict text, usize len)
+{
+	if (wmemchr(text, L'\r', len) == NULL)
+	{
+		return aFile_insertLines(self, text, len);
+	}
+
+	wchar * restrict copy = malloc(sizeof(wchar) * len);
+	if (copy == NULL)
+	{
+		return false;
+	}
+	memcpy(copy, text, sizeof(wchar) * len);
+	const bool ok = aFile_insertLines(self, copy, aFile_normaliseEols(copy, len));
+	free(copy);
+	return ok;
+}
+bool aFile_insertTextU8(aFile_t * restrict self, const char * restrict text, usize len)
+{
+	wchar * restrict wtext = malloc(sizeof(wchar) * max_usize(1, aUtf_wLen(text, len)));
+	if (wtext == NULL)
+	{
+		return false;
+	}
+	const bool ok = aFile_insertLines(self, wtext, aFile_normaliseEols(wtext, aUtf_toW(text, len, wtext)));
+	free(wtext);
+	return ok;
+}
+static bool aFile_applyRecord(aFile_t * restrict self, const aUndoRec_t * restrict rec, bool revert)
+{
+	// Reverting an insertion deletes the text & vice versa
+	if (!aFile_moveTo(self, rec->line, rec->col))
+	{
+		return false;
+	}
+	else if ((rec->kind == aukINSERT) == revert)
+	{
+		return aFile_eraseText(self, rec->len);
+	}
+
+	const wchar * restrict text = aUndo_text(&self->data.undo, rec);
+	wchar * restrict reversed = NULL;
+	if (rec->kind == aukBACKSPACE)
+	{
+		reversed = malloc(sizeof(wchar) * rec->len);
+		if (reversed == NULL)
+		{
+			return false;
+		}
+		for (usize i = 0; i < rec->len; ++i)
+		{
+			reversed[i] = text[rec->len - 1 - i];
+		}
+		text = reversed;
+	}
+	bool ok = aFile_putText(self, text, rec->len);
+	free(reversed);
+
+	// Text deleted going forward was after the cursor
+	if (ok && (rec->kind == aukDELETE))
+	{
+		ok = aFile_moveTo(self, rec->line, rec->col);
+	}
+	return ok;
+}
+bool aFile_undo(aFile_t * restrict self)
+{
+	const aUndoRec_t * restrict rec = aUndo_undo(&self->data.undo);
+	if (rec == NULL)
+	{
+		return false;
+	}
+
+	aPROF_START(prof);
+	const bool ok = aFile_applyRecord(self, rec, true);
+	aPROF_END(prof, "aFile_undo", rec->len, "characters");
+	if (!ok)
+	{
+		aUndo_clear(&self->data.undo);
+	}
+	return ok;
+}
+bool aFile_redo(aFile_t * restrict self)
+{
+	const aUndoRec_t * restrict rec = aUndo_redo(&self->data.undo);
+	if (rec == NULL)
+	{
+		return false;
+	}
+
+	aPROF_START(prof);
+	const bool ok = aFile_applyRecord(self, rec, false);
+	aPROF_END(prof, "aFile_redo", rec->len, "characters");
+	if (!ok)
+	{
+		aUndo_clear(&self->data.undo);
+	}
+	return ok;
+}
+void aFile_sealUndo(aFile_t * restrict self)
+{
+	aUndo_seal(&self->data.undo);
+}
+static bool aFile_replay(aFile_t * restrict self, const aJournalEdit_t * restrict edit)
+{
+	if (edit->op == ajoEOL)
+	{
+		const bool valid = (edit->len == eolCRLF) || (edit->len == eolLF) || (edit->len == eolCR);
+		if (valid)
+		{
+			aFile_setEol(self, (eolSeq_e)edit->len);
+		}
+		return valid;
+	}
+	else if (!aFile_moveTo(self, edit->line, edit->col))
+	{
+		return false;
+	}
+	else if (edit->op == ajoERASE)
+	{
+		return aFile_eraseText(self, edit->len);
+	}
+
+	const usize len = aUtf_wLen(edit->text, edit->len);
+	wchar * restrict text = malloc(sizeof(wchar) * (len + 1));
+	if (text == NULL)
+	{
+		return false;
+	}
+	aUtf_toW(edit->text, edit->len, text);
+	const bool ok = aFile_putText(self, text, len);
+	free(text);
+	return ok;
+}
+const wchar * aFile_openJournal(aFile_t * restrict self, usize * restrict recovered)
+{
+	// Edits journaled before a reload are gone
+	aJournal_stop(&self->data.journal, true);
+	*recovered = 0;
+	if (self->pieceTable)
+	{
+		return NULL;
+	}
+
+	char * edits = NULL;
+	usize len = 0, end = 0;
+	const ajl_e res = aJournal_load(self->fileName, self->stamp.size, self->stamp.time, &edits, &len, &end);
+	if (res == ajlMEM_ERROR)
+	{
+		return L"Memory error!";
+	}
+
+	const wchar * err = NULL;
+	if (res == ajlOK)
 	{
-		aLine_t * restrict node = self->data.currentNode;
-		for (u32 i = 0; (i < height) && (node != NULL); ++i)
+		// Edits are replayed before journaling starts, the journal holds them already
+		err = aFile_finishLoad(self);
+		aPROF_START(prof);
+		aJournalEdit_t edit;
+		usize pos = 0;
+		while ((err == NULL) && aJournal_next(edits, len, &pos, &edit))
 		{
-			if (node == self->data.pcury)
+			if (!aFile_replay(self, &edit))
 			{
-				return;
+				err = L"Journal doesn't match the file, recovered edits aren't journaled!";
+				break;
 			}
-			node = node->prevNode;
+			++*recovered;
+		}
+		aPROF_END(prof, "aFile_openJournal (replay)", *recovered, "edits");
+		free(edits);
+	}
+
+	// Partly replayed journal is replaced
+	if (!aJournal_start(&self->data.journal, self->fileName, self->stamp.size, self->stamp.time, ((res == ajlOK) && (err == NULL)) ? end : 0))
+	{
+		err = (err == NULL) ? L"Journal couldn't be started!" : err;
+	}
+	return err;
+}
+
+usize aFile_curLine(const aFile_t * restrict self)
+{
+	return self->pieceTable ? aPTable_curLine(&self->data.ptable) : aLineIdx_index(&self->data.currentNode->idx);
+}
+void aFile_gotoLine(aFile_t * restrict self, usize line)
+{
+	if (self->pieceTable)
+	{
+		aPTable_setCursor(&self->data.ptable, line, 0);
+		return;
+	}
+	usize offset;
+	aLine_t * restrict node = aLine_fromIdx(aLineIdx_at(&self->data.lineIdx, line, &offset));
+	node = aFile_materialise(self, node, offset);
+	if (aFile_setCurrent(self, node))
+	{
+		aLine_moveCursor(node, -(isize)node->curx);
+	}
+}
+usize aFile_curCol(const aFile_t * restrict self)
+{
+	return self->pieceTable ? aPTable_curCol(&self->data.ptable) : self->data.currentNode->curx;
+}
+void aFile_moveCursor(aFile_t * restrict self, isize delta)
+{
+	if (!self->pieceTable)
+	{
+		aLine_moveCursor(self->data.currentNode, delta);
+		return;
+	}
+	aPTable_t * restrict pt = &self->data.ptable;
+	const isize col = (isize)aPTable_curCol(pt) + delta;
+	aPTable_setCursor(pt, aPTable_curLine(pt), (col > 0) ? (usize)col : 0);
+}
+const wchar * aFile_pieceLine(aFile_t * restrict self, usize line, usize * restrict len)
+{
+	if (!aPTable_getLine(&self->data.ptable, line, &self->data.ptLine, &self->data.ptLineCap))
+	{
+		return NULL;
+	}
+	*len = wcslen(self->data.ptLine);
+	return self->data.ptLine;
+}
+void aFile_updateCury(aFile_t * restrict self, u32 height)
+{
+	const usize cur = aFile_curLine(self);
+	if (self->pieceTable)
+	{
+		// First line shown follows the cursor the same way pcury does
+		if (self->data.ptTop > cur)
+		{
+			self->data.ptTop = cur;
+		}
+		else if ((cur - self->data.ptTop) >= (usize)height)
+		{
+			self->data.ptTop = cur - (usize)height;
+		}
+		return;
+	}
+	if (self->data.pcury != NULL)
+	{
+		const usize cury = aLineIdx_index(&self->data.pcury->idx);
+		if (cury > cur)
+		{
+			self->data.pcury = self->data.currentNode;
+			return;
+		}
+		else if ((cur - cury) < (usize)height)
+		{
+			return;
 		}
+	}
+
+	// Current line becomes the bottom line of the view
+	usize offset;
+	aLine_t * restrict node = aLine_fromIdx(aLineIdx_at(
+		&self->data.lineIdx,
+		(cur > (usize)height) ? (cur - (usize)height) : 0,
+		&offset
+	));
+	self->data.pcury = aFile_materialise(self, node, offset);
+}
+aLine_t * aFile_materialise(aFile_t * restrict self, aLine_t * restrict node, usize offset)
+{
+	if (!aLine_isSpan(node))
+	{
+		return node;
+	}
+
+	aPROF_START(prof);
+	const char * restrict mem = self->map.mem + node->curx;
+	const usize spanBytes = node->u8len;
+	aLine_t * restrict next = node->nextNode, * prev = node, * target = NULL;
+	for (usize i = 0, pos = 0, lines = node->idx.lines; i < lines; ++i)
+	{
+		const usize start = pos;
+		usize lineEnd;
+		aFile_spanLine(mem, spanBytes, &pos, &lineEnd);
 
-		node = self->data.currentNode->nextNode;
-		while (node != NULL)
+		aLine_t * line = aLine_createU8(&self->data.arena, prev, next, mem + start, lineEnd - start);
+		if (line == NULL)
 		{
-			if (node == self->data.pcury)
+			// Roll back, span stays as it was
+			while (prev != node)
+			{
+				aLine_t * p = prev->prevNode;
+				aLineIdx_remove(&prev->idx);
+				aLine_destroy(&self->data.arena, prev);
+				prev = p;
+			}
+			node->nextNode = next;
+			if (next != NULL)
 			{
-				self->data.pcury = self->data.currentNode;
-				return;
+				next->prevNode = node;
 			}
-			node = node->nextNode;
+			return NULL;
+		}
+		target = (i == offset) ? line : target;
+		prev = line;
+	}
+
+	// Replace span with its lines
+	aLine_t * restrict first = node->nextNode;
+	first->prevNode = node->prevNode;
+	if (node->prevNode != NULL)
+	{
+		node->prevNode->nextNode = first;
+	}
+	self->data.firstNode = (self->data.firstNode == node) ? first : self->data.firstNode;
+	self->data.pcury     = (self->data.pcury     == node) ? first : self->data.pcury;
+	aLineIdx_remove(&node->idx);
+	aArena_freeNode(&self->data.arena, node);
+
+	aPROF_END(prof, "aFile_materialise", spanBytes, "bytes");
+	return target;
+}
+aLine_t * aFile_nextLine(aFile_t * restrict self, aLine_t * restrict node)
+{
+	return (node->nextNode == NULL) ? NULL : aFile_materialise(self, node->nextNode, 0);
+}
+aLine_t * aFile_prevLine(aFile_t * restrict self, aLine_t * restrict node)
+{
+	aLine_t * restrict prev = node->prevNode;
+	return (prev == NULL) ? NULL : aFile_materialise(self, prev, prev->idx.lines - 1);
+}
+
+
+static bool aFile_findAt(aFile_t * restrict self, aLine_t * restrict node, usize col)
+{
+	if (!aFile_setCurrent(self, node))
+	{
+		return false;
+	}
+	aLine_moveCursor(node, (isize)col - (isize)node->curx);
+	return true;
+}
+static bool aFile_findLine(const aLine_t * restrict node, const aFind_t * restrict find, aRegex_t * restrict re, usize from, usize * restrict col)
+{
+	usize end;
+	return (re != NULL) ? (aLine_setRegex(node, re) && aRegex_find(re, from, col, &end)) : aLine_find(node, find, from, col);
+}
+static usize aFile_findSpan(const char * restrict mem, usize len, const aFind_t * restrict find, aRegex_t * restrict re)
+{
+	// Byte index of the first match in span
+	if (re == NULL)
+	{
+		return aFind_inU8(find, mem, len);
+	}
+
+	// DFA finds the line, the match is then located in the line alone
+	for (usize pos = 0; pos < len;)
+	{
+		usize start = pos + aRegex_scan(re, mem + pos, len - pos), lineEnd, at, end;
+		if (start >= len)
+		{
+			break;
 		}
+		pos = start;
+		aFile_spanLine(mem, len, &pos, &lineEnd);
+		if (aRegex_matchLine(re, mem + start, lineEnd - start, 0, &at, &end))
+		{
+			return start + at;
+		}
+	}
+	return len;
+}
+static bool aFile_findIn(aFile_t * restrict self, aLine_t * restrict node, const aFind_t * restrict find, aRegex_t * restrict re)
+{
+	usize col;
+	if (!aLine_isSpan(node))
+	{
+		return aFile_findLine(node, find, re, 0, &col) && aFile_findAt(self, node, col);
+	}
 
-		self->data.pcury = NULL;
-		aFile_updateCury(self, height);
+	// Span is searched as a whole, only the line with the match is created
+	const char * restrict mem = self->map.mem + node->curx;
+	const usize at = aFile_findSpan(mem, node->u8len, find, re);
+	if (at == node->u8len)
+	{
+		return false;
+	}
+	usize line = aLineIdx_index(&node->idx), start = 0, pos = 0, lineEnd;
+	for (;; ++line)
+	{
+		start = pos;
+		aFile_spanLine(mem, node->u8len, &pos, &lineEnd);
+		if (at < pos)
+		{
+			break;
+		}
+	}
+	col = aUtf_wLen(mem + start, at - start);
+	aFile_gotoLine(self, line);
+	return (aFile_curLine(self) == line) && aFile_findAt(self, self->data.currentNode, col);
+}
+static bool aFile_findText(const wchar * restrict text, usize len, const aFind_t * restrict find, aRegex_t * restrict re, usize from, usize * restrict col)
+{
+	usize end;
+	return (re != NULL) ? (aRegex_setLineW(re, text, len, text + len, 0) && aRegex_find(re, from, col, &end)) : aLine_textFind(text, len, find, from, col);
+}
+static bool aFile_searchPieces(aFile_t * restrict self, const aFind_t * restrict find, aRegex_t * restrict re, bool skip)
+{
+	// Lines are searched in the same order as line nodes, the start line twice
+	aPTable_t * restrict pt = &self->data.ptable;
+	const usize start = aPTable_curLine(pt), from = aPTable_curCol(pt) + (skip ? 1 : 0), lines = pt->totalLines;
+	for (usize i = 0; i <= lines; ++i)
+	{
+		const usize line = (start + i) % lines;
+		usize len, col;
+		const wchar * restrict text = aFile_pieceLine(self, line, &len);
+		if (text == NULL)
+		{
+			return false;
+		}
+		else if (aFile_findText(text, len, find, re, (i == 0) ? from : 0, &col) && ((i < lines) || (col < from)))
+		{
+			aPTable_setCursor(pt, line, col);
+			return true;
+		}
+	}
+	return false;
+}
+static bool aFile_search(aFile_t * restrict self, const aFind_t * restrict find, aRegex_t * restrict re, bool skip)
+{
+	if (self->pieceTable)
+	{
+		return aFile_searchPieces(self, find, re, skip);
+	}
+	// Rest of the current line, lines after it, lines from the top & then the
+	// start of the current line
+	aLine_t * restrict start = self->data.currentNode;
+	const usize from = start->curx + (skip ? 1 : 0);
+	usize col;
+	bool found = aFile_findLine(start, find, re, from, &col) && aFile_findAt(self, start, col);
+	for (aLine_t * node = start->nextNode; !found && (node != NULL); node = node->nextNode)
+	{
+		found = aFile_findIn(self, node, find, re);
+	}
+	for (aLine_t * node = self->data.firstNode; !found && (node != start); node = node->nextNode)
+	{
+		found = aFile_findIn(self, node, find, re);
 	}
+	if (!found && aFile_findLine(start, find, re, 0, &col) && (col < from))
+	{
+		found = aFile_findAt(self, start, col);
+	}
+	return found;
+}
+bool aFile_find(aFile_t * restrict self, const aFind_t * restrict find, bool skip)
+{
+	if (aFind_empty(find))
+	{
+		return false;
+	}
+	aPROF_START(prof);
+	const bool found = aFile_search(self, find, NULL, skip);
+	aPROF_END(prof, "aFile_find", aLineIdx_chars(&self->data.lineIdx), "characters");
+	return found;
+}
+bool aFile_findRegex(aFile_t * restrict self, aRegex_t * restrict re, bool skip)
+{
+	if (aRegex_empty(re))
+	{
+		return false;
+	}
+	aPROF_START(prof);
+	const bool found = aFile_search(self, NULL, re, skip);
+	aPROF_END(prof, "aFile_findRegex", aLineIdx_chars(&self->data.lineIdx), "characters");
+	return found;
 }
 
+usize aFile_compact(aFile_t * restrict self)
+{
+	usize reclaimed = 0;
+	for (usize i = 0; i < self->data.numCompact; ++i)
+	{
+		reclaimed += aFile_packLine(self, self->data.compactQueue[i]);
+	}
+	self->data.numCompact = 0;
+	reclaimed += self->data.reclaimed;
+	self->data.reclaimed = 0;
+	return reclaimed;
+}
 
 void aFile_destroy(aFile_t * restrict self)
 {
 	aFile_close(self);
 	aFile_clearLines(self);
+	free(self->data.ptLine);
+	self->data.ptLine    = NULL;
+	self->data.ptLineCap = 0;
+	// Clean exit leaves no journal behind
+	aJournal_stop(&self->data.journal, true);
 }
@@ -2,14 +2,68 @@
 #define ATTO_FILE_H
 
 #include "aCommon.h"
+#include "aLineIdx.h"
+#include "aArena.h"
+#include "aMap.h"
+#include "aUndo.h"
+#include "aJournal.h"
+#include "aFind.h"
+#include "aRegex.h"
+#include "aPTable.h"
 
 #define ATTO_LNODE_DEFAULT_FREE 10
+// Gap grows by 1/ATTO_LNODE_GROWTH_DIV of line length when full
+#define ATTO_LNODE_GROWTH_DIV 2
+// Gaps bigger than this are shrunk after the cursor has left the line
+#define ATTO_LNODE_COMPACT_FREE (4 * ATTO_LNODE_DEFAULT_FREE)
+#define ATTO_COMPACT_QUEUE 32
+// Column map of a packed line has a checkpoint every ATTO_U8MAP_STEP columns
+#define ATTO_U8MAP_STEP 64
+// Files at least this big are mapped and their lines are created lazily
+#define ATTO_MAP_MIN_SIZE (64 * 1024 * 1024)
+// Maximum number of lines a single span node stands for
+#define ATTO_MAP_SPAN_LINES 1024
+// Mapped files are scanned for lines by at most this many threads, one until
+// more are measured to beat it
+#ifndef ATTO_LOAD_THREADS
+	#define ATTO_LOAD_THREADS 1
+#endif
+// Smallest part of a mapped file worth giving to a thread of its own
+#define ATTO_LOAD_PART_MIN (16 * 1024 * 1024)
+// Files are loaded in chunks of this many bytes
+#define ATTO_READ_CHUNK (64 * 1024)
+// Files are saved through an output buffer of this many bytes
+#define ATTO_WRITE_BUF (256 * 1024)
+// Saving a mapped file reads at most this many bytes of spans after the first change
+// to memory, so the file can be rewritten from there in place
+#define ATTO_SAVE_SPLICE_MAX (16 * 1024 * 1024)
+// Biggest single ReadFile/WriteFile request in bytes
+#define ATTO_IO_CHUNK ((usize)1 << 30)
+// Tabs are stored as-is and shown up to the next multiple of this column
+#define ATTO_TAB_WIDTH 4
 
 /*
 	Example:
 	L"This is text\0\0\0\0\0\0"
 	              ^ - curx
 				  <----------> - freeSpaceLen = 6
+
+	Lines the cursor isn't on can be packed to UTF-8 (line == NULL):
+	u8 holds u8len bytes, lineEndx is the number of columns, freeSpaceLen
+	is 0 and curx remembers the cursor column. If the line is not pure ASCII,
+	bytes are followed by a column map: u32 byte offsets of every
+	ATTO_U8MAP_STEP-th column.
+
+	Mapped files start out as span nodes (line == NULL, u8 == NULL), each
+	standing for idx.lines lines that haven't been created yet: curx is
+	the byte offset of the first line in the mapping and u8len is the
+	number of bytes up to the end of the last line, excluding its EOL.
+	lineEndx and freeSpaceLen are 0.
+
+	Columns are wchar units, screen columns are what they take up once tabs
+	are expanded. tabs caches the tab stops of a line, it's built on first
+	use and dropped whenever the text changes: tabs[0] is the number of
+	tabs, followed by a (column, screen column) pair for each tab.
 */
 
 typedef struct aLine
@@ -17,21 +71,33 @@ typedef struct aLine
 	wchar * line;
 	usize lineEndx, curx, freeSpaceLen;
 
+	char * u8;
+	usize u8len;
+
+	u32 * tabs;
+
 	struct aLine * prevNode, * nextNode;
 
+	// Position in document line index
+	aLineIdx_t idx;
+
 } aLine_t;
 
+#define aLine_fromIdx(pidx) ((aLine_t *)((char *)(pidx) - offsetof(aLine_t, idx)))
+
 /**
  * @brief Creates new line in-between current line and next line
  * 
+ * @param arena Pointer to document's arena
  * @param curnode Pointer to current line node, can be NULL
  * @param nextnode Pointer to next line node, can be NULL
  * @return aLine_t* Pointer to newly created line node, NULL on failure
  */
-aLine_t * aLine_create(aLine_t * restrict curnode, aLine_t * restrict nextnode);
+aLine_t * aLine_create(aArena_t * restrict arena, aLine_t * restrict curnode, aLine_t * restrict nextnode);
 /**
  * @brief Creates new line in-between current line and next line
  * 
+ * @param arena Pointer to document's arena
  * @param curnode Pointer to current line node, can be NULL
  * @param nextnode Pointer to next line node, can be NULL
  * @param lineText Pointer to UTF-16 character array, contents of this will be
@@ -41,12 +107,153 @@ aLine_t * aLine_create(aLine_t * restrict curnode, aLine_t * restrict nextnode);
  * @return aLine_t* Pointer to newly created line node, NULL on failure
  */
 aLine_t * aLine_createText(
+	aArena_t * restrict arena,
 	aLine_t * restrict curnode,
 	aLine_t * restrict nextnode,
 	const wchar * restrict lineText,
 	isize maxText
 );
 
+/**
+ * @brief Creates new packed line in-between current line and next line
+ * 
+ * @param arena Pointer to document's arena
+ * @param curnode Pointer to current line node, can be NULL
+ * @param nextnode Pointer to next line node, can be NULL
+ * @param bytes Pointer to UTF-8 character array, contents of this will be
+ * copied to the newly created line
+ * @param len Number of bytes to copy
+ * @return aLine_t* Pointer to newly created line node, NULL on failure
+ */
+aLine_t * aLine_createU8(
+	aArena_t * restrict arena,
+	aLine_t * restrict curnode,
+	aLine_t * restrict nextnode,
+	const char * restrict bytes,
+	usize len
+);
+
+/**
+ * @brief Packs line to UTF-8 storage, releases the gap buffer
+ * 
+ * @param arena Pointer to document's arena
+ * @param self Pointer to line node
+ * @return usize Number of bytes reclaimed, 0 if line wasn't packed
+ */
+usize aLine_pack(aArena_t * restrict arena, aLine_t * restrict self);
+/**
+ * @brief Unpacks line from UTF-8 storage to an editable gap buffer,
+ * does nothing if line isn't packed
+ * 
+ * @param arena Pointer to document's arena
+ * @param self Pointer to line node
+ * @return true Success
+ * @return false Failure
+ */
+bool aLine_unpack(aArena_t * restrict arena, aLine_t * restrict self);
+/**
+ * @brief Checks whether line is stored packed as UTF-8
+ * 
+ * @param self Pointer to line node
+ * @return true Line is packed
+ * @return false Line is an editable gap buffer
+ */
+bool aLine_isPacked(const aLine_t * restrict self);
+/**
+ * @brief Checks whether node is a span of mapped lines, that haven't been
+ * created yet
+ * 
+ * @param self Pointer to line node
+ * @return true Node is a span
+ * @return false Node is a line
+ */
+bool aLine_isSpan(const aLine_t * restrict self);
+/**
+ * @brief Finds next match on a line, gap buffers are searched around the gap &
+ * packed lines as UTF-8, spans never match
+ * 
+ * @param self Pointer to line node
+ * @param find Pointer to needle
+ * @param from Column the search starts at
+ * @param col Address of receiving column of the match
+ * @return true Match has been found
+ * @return false No match at or after from
+ */
+bool aLine_find(const aLine_t * restrict self, const aFind_t * restrict find, usize from, usize * restrict col);
+/**
+ * @brief Sets line as the one regular expression searches in with aRegex_find,
+ * spans never match
+ * 
+ * @param self Pointer to line node
+ * @param re Pointer to compiled regular expression
+ * @return true Line may contain a match
+ * @return false Line has no match, or memory error
+ */
+bool aLine_setRegex(const aLine_t * restrict self, aRegex_t * restrict re);
+/**
+ * @brief Copies range of columns from line, works on packed and unpacked lines
+ * 
+ * @param self Pointer to line node
+ * @param col Starting column
+ * @param dest Pointer to receiving wchar character array, no null-terminator is added
+ * @param maxCols Maximum number of columns to copy
+ * @return usize Number of columns copied
+ */
+usize aLine_getCols(const aLine_t * restrict self, usize col, wchar * restrict dest, usize maxCols);
+/**
+ * @brief Converts column to screen column, builds tab stop cache if needed
+ * 
+ * @param arena Pointer to document's arena
+ * @param self Pointer to line node
+ * @param col Column, can be past the end of line
+ * @return usize Screen column
+ */
+usize aLine_toScreenCol(aArena_t * restrict arena, aLine_t * restrict self, usize col);
+/**
+ * @brief Copies range of screen columns from line, tabs are expanded to spaces,
+ * builds tab stop cache if needed
+ * 
+ * @param arena Pointer to document's arena
+ * @param self Pointer to line node
+ * @param scol Starting screen column
+ * @param dest Pointer to receiving wchar character array, no null-terminator is added
+ * @param maxCols Maximum number of screen columns to copy
+ * @return usize Number of screen columns copied
+ */
+usize aLine_getScreenCols(aArena_t * restrict arena, aLine_t * restrict self, usize scol, wchar * restrict dest, usize maxCols);
+/**
+ * @brief Finds first match in plain text at or after given column
+ * 
+ * @param text Pointer to wchar character array
+ * @param len Number of characters in text
+ * @param find Pointer to prepared aFind_t structure
+ * @param from Column to start searching from
+ * @param col Address of match column
+ * @return true Match has been found
+ * @return false No match
+ */
+bool aLine_textFind(const wchar * restrict text, usize len, const aFind_t * restrict find, usize from, usize * restrict col);
+/**
+ * @brief Converts column of plain text to screen column
+ * 
+ * @param text Pointer to wchar character array
+ * @param len Number of characters in text
+ * @param col Column, stops at the end of text
+ * @return usize Screen column
+ */
+usize aLine_textToScreenCol(const wchar * restrict text, usize len, usize col);
+/**
+ * @brief Copies range of screen columns from plain text, tabs are expanded to spaces
+ * 
+ * @param text Pointer to wchar character array
+ * @param len Number of characters in text
+ * @param scol Starting screen column
+ * @param dest Pointer to receiving wchar character array, no null-terminator is added
+ * @param maxCols Maximum number of screen columns to copy
+ * @return usize Number of screen columns copied
+ */
+usize aLine_textScreenCols(const wchar * restrict text, usize len, usize scol, wchar * restrict dest, usize maxCols);
+
 /**
  * @brief Fetches text from given line node, copies it to wchar character array,
  * allocates memory only if *text is too small or tarrsz == NULL
@@ -60,28 +267,41 @@ aLine_t * aLine_createText(
  */
 bool aLine_getText(const aLine_t * restrict self, wchar ** restrict text, usize * restrict tarrsz);
 /**
- * @brief Reallocates free space on given line node, guarantees
- * ATTO_LNODE_DEFAULT_FREE characters for space
+ * @brief Reallocates free space on given line node, guarantees at least
+ * ATTO_LNODE_DEFAULT_FREE characters for space, grows geometrically with
+ * line length
  * 
+ * @param arena Pointer to document's arena
  * @param self Pointer to line node
  * @return true Success
  * @return false Failure
  */
-bool aLine_realloc(aLine_t * restrict self);
+bool aLine_realloc(aArena_t * restrict arena, aLine_t * restrict self);
+/**
+ * @brief Shrinks free space on given line node back to ATTO_LNODE_DEFAULT_FREE
+ * characters, if it's bigger than ATTO_LNODE_COMPACT_FREE
+ * 
+ * @param arena Pointer to document's arena
+ * @param self Pointer to line node
+ * @return usize Number of bytes reclaimed
+ */
+usize aLine_compact(aArena_t * restrict arena, aLine_t * restrict self);
 
 /**
  * @brief Merges current line node with next line node, adjusts current
  * y-position line node pointer if necessary
  * 
+ * @param arena Pointer to document's arena
  * @param self Pointer to current line node
  * @param ppcury Address of pointer to current y-position line node
  * @return true Success
  * @return false Failure
  */
-bool aLine_mergeNext(aLine_t * restrict self, aLine_t ** restrict ppcury);
+bool aLine_mergeNext(aArena_t * restrict arena, aLine_t * restrict self, aLine_t ** restrict ppcury);
 
 /**
- * @brief Moves (internal) cursor on current line node, clamps movement
+ * @brief Moves (internal) cursor on current line node, clamps movement,
+ * line must not be packed
  * 
  * @param self Pointer to current line node
  * @param delta Amount of characters to move, positive values to move right,
@@ -90,11 +310,12 @@ bool aLine_mergeNext(aLine_t * restrict self, aLine_t ** restrict ppcury);
 void aLine_moveCursor(aLine_t * restrict self, isize delta);
 
 /**
- * @brief Destroys line node, frees memory
+ * @brief Destroys line node, returns memory back to the arena
  * 
+ * @param arena Pointer to document's arena
  * @param self Pointer to line node
  */
-void aLine_destroy(aLine_t * restrict self);
+void aLine_destroy(aArena_t * restrict arena, aLine_t * restrict self);
 
 typedef enum eolSequence
 {
@@ -107,19 +328,78 @@ typedef enum eolSequence
 
 } eolSequence_e, eolSeq_e;
 
+// Number of EOL sequences of each kind found while loading
+typedef struct aEolCensus
+{
+	usize crlf, lf, cr;
+
+} aEolCensus_t;
+
+// Size & last write time of a file on disc
+typedef struct aFileStamp
+{
+	u64 size, time;
+	bool exists;
+
+} aFileStamp_t;
+
 typedef struct aFile
 {
 	const wchar * fileName;
 	HANDLE hFile;
 	bool canWrite;
 	eolSeq_e eolSeq;
+	aEolCensus_t eols;
+	// Bumped by every change of contents or EOL sequence
+	usize gen;
+	// Generation & file on disc as of last load or save
+	usize savedGen;
+	aFileStamp_t stamp;
+	// Saves go through a temporary file on a worker thread (see aFile_startSave), off by default
+	bool durableSave;
+	// Document is kept in a piece table instead of line nodes, chosen before aFile_read
+	bool pieceTable;
+	// Backing memory of span nodes
+	aMap_t map;
 
 	struct
 	{
 		aLine_t * firstNode;
 		aLine_t * currentNode;
 		aLine_t * pcury;
+		// First screen column shown
 		usize curx;
+
+		aLineIdx_t lineIdx;
+		// Owns all line nodes & line buffers
+		aArena_t arena;
+
+		// Lines left by the cursor, waiting to be packed
+		aLine_t * compactQueue[ATTO_COMPACT_QUEUE];
+		usize numCompact, reclaimed;
+
+		// EOL sequence used inside of span nodes
+		eolSeq_e spanEol;
+		// Background loader of a mapped file, NULL when the file is loaded
+		struct aFileLoad * load;
+		// Save in progress, NULL if there is none; generation & EOL sequence it saves
+		struct aSave * save;
+		usize saveGen;
+		eolSeq_e saveEol;
+		// Edit history, see aFile_undo
+		aUndo_t undo;
+		// Crash-recovery journal, see aFile_openJournal
+		aJournal_t journal;
+		// Generations (editFrom, editGen] only changed editNode, see aFile_editedLine
+		const aLine_t * editNode;
+		usize editFrom, editGen;
+
+		// Piece-table document & first line shown, see aFile_t.pieceTable
+		aPTable_t ptable;
+		usize ptTop;
+		// Line fetched by aFile_pieceLine
+		wchar * ptLine;
+		usize ptLineCap;
 	} data;
 
 } aFile_t;
@@ -148,7 +428,8 @@ bool aFile_open(aFile_t * restrict self, const wchar * restrict selfName, bool w
  */
 void aFile_close(aFile_t * restrict self);
 /**
- * @brief Clears (internal) lines in editor data structure
+ * @brief Clears (internal) lines in editor data structure, releases
+ * all line memory at once
  * 
  * @param self Pointer to aFile_t structure
  */
@@ -165,31 +446,137 @@ void aFile_clearLines(aFile_t * restrict self);
 const wchar * aFile_readBytes(aFile_t * restrict self, char ** restrict bytes, usize * restrict bytesLen);
 /**
  * @brief Opens file with last given filename, reads file contents to internal
- * structure, ready to be shown on screen
+ * structure, ready to be shown on screen. Mapped files return as soon as their
+ * first lines exist, the rest keeps loading in the background. Piece-table
+ * documents are decoded whole as the original text of the table
  * 
  * @param self Pointer to aFile_t structure
  * @return const wchar* Error message, NULL on success
  */
 const wchar * aFile_read(aFile_t * restrict self);
+/**
+ * @brief Adds lines found by the background loader to the document, ends
+ * loading when the whole file has been scanned
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return const wchar* Error message, NULL on success
+ */
+const wchar * aFile_pollLoad(aFile_t * restrict self);
+/**
+ * @brief Waits for background loader to finish
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return const wchar* Error message, NULL on success
+ */
+const wchar * aFile_finishLoad(aFile_t * restrict self);
+/**
+ * @brief Checks whether file is still loading in the background
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return true Loading
+ * @return false Whole file is loaded
+ */
+bool aFile_loading(const aFile_t * restrict self);
+/**
+ * @brief Queries progress of background loader
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return usize Percentage of file scanned, 100 if file is loaded
+ */
+usize aFile_loadProgress(const aFile_t * restrict self);
 
 typedef enum aFile_writeRes
 {
-	afwrNOTHING_NEW = -1,
-	afwrOPEN_ERROR  = -2,
-	afwrWRITE_ERROR = -3,
-	afwrMEM_ERROR   = -4
+	afwrNOTHING_NEW  = -1,
+	afwrOPEN_ERROR   = -2,
+	afwrWRITE_ERROR  = -3,
+	afwrMEM_ERROR    = -4,
+	afwrDISK_CHANGED = -5,
+	afwrSAVING       = -6
 
 } aFile_writeRes_e, aFile_wr_e, afwr_e;
 /**
- * @brief Opens file with last given filename, reads file contents to temporary memory,
- * compares them with current internal file contents in memory. Only attempts to write to
- * file if anything has been changed
+ * @brief Writes contents to the file with last given filename if anything has been
+ * changed since last load or save. Contents are encoded straight from the lines through
+ * a buffer of ATTO_WRITE_BUF bytes. Mapped files are only rewritten from the first
+ * changed line on (see ATTO_SAVE_SPLICE_MAX), or just the changed lines if nothing has
+ * moved; otherwise, or if they would shrink, they are written to a sibling file first,
+ * which then replaces the original
  * 
  * @param self Pointer to aFile_t structure
  * @return isize Negative values represent error code, positive values (0 inclusive)
- * represent number of bytes written to disc
+ * represent number of bytes written to disc. If the file has been changed by someone
+ * else, afwrDISK_CHANGED is returned once, next call overwrites it. afwrSAVING is
+ * returned while a durable save is in progress
  */
 isize aFile_write(aFile_t * restrict self);
+/**
+ * @brief Starts a durable save: contents are copied (lines) or referred to (spans),
+ * a worker thread writes them to a sibling file and flushes it to disc, which then
+ * replaces the original in aFile_pollSave. Editing can continue meanwhile.
+ * Piece-table documents are written with aFile_write
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return isize afwrSAVING if the save has been started, any other aFile_write result
+ * otherwise
+ */
+isize aFile_startSave(aFile_t * restrict self);
+/**
+ * @brief Checks whether a durable save is in progress
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return true Saving
+ * @return false Not saving
+ */
+bool aFile_saving(const aFile_t * restrict self);
+/**
+ * @brief Finishes durable save if the worker is done, doesn't block
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return isize afwrSAVING while still writing, otherwise result of the save like
+ * aFile_write's; afwrNOTHING_NEW if there's no save
+ */
+isize aFile_pollSave(aFile_t * restrict self);
+/**
+ * @brief Waits for durable save to finish
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return isize Result of the save like aFile_write's, afwrNOTHING_NEW if there's no save
+ */
+isize aFile_finishSave(aFile_t * restrict self);
+/**
+ * @brief Checks whether contents have been changed since last load or save
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return true Contents have been changed
+ * @return false Contents are the same as on disc
+ */
+bool aFile_modified(const aFile_t * restrict self);
+/**
+ * @brief Checks whether all changes since a generation were edits inside of
+ * a single line, which hasn't been split or merged
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param gen Earlier generation
+ * @return const aLine_t* The edited line, NULL if nothing or more has changed
+ */
+const aLine_t * aFile_editedLine(const aFile_t * restrict self, usize gen);
+/**
+ * @brief Selects EOL sequence used for saving
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param eolSeq EOL sequence
+ */
+void aFile_setEol(aFile_t * restrict self, eolSeq_e eolSeq);
+/**
+ * @brief Checks whether loaded file had more than one kind of EOL sequences,
+ * all of them are saved as eolSeq
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return true Mixed EOL sequences
+ * @return false Single kind of EOL sequences or none at all
+ */
+bool aFile_mixedEol(const aFile_t * restrict self);
 /**
  * @brief Set console title according to last given filename, also shows
  * editor name on the titlebar
@@ -255,6 +642,149 @@ bool aFile_deleteBackward(aFile_t * restrict self);
  * @return false Failure
  */
 bool aFile_addNewLine(aFile_t * restrict self);
+/**
+ * @brief Inserts text at the cursor, which ends up after it. CRLF, LF & CR all
+ * break lines. Takes time proportional to the text, new lines are created before
+ * anything changes & spliced in at once; the text is undone in one step along with
+ * typing it continues
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param text Pointer to UTF-16 character array
+ * @param len Number of characters
+ * @return true Success
+ * @return false Failure, file is left as it was
+ */
+bool aFile_insertText(aFile_t * restrict self, const wchar * restrict text, usize len);
+/**
+ * @brief Inserts UTF-8 text at the cursor, see aFile_insertText
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param text Pointer to UTF-8 character array
+ * @param len Number of bytes
+ * @return true Success
+ * @return false Failure, file is left as it was
+ */
+bool aFile_insertTextU8(aFile_t * restrict self, const char * restrict text, usize len);
+/**
+ * @brief Reverts the last record of edit history in time proportional to its size,
+ * a run of typing or a paste is reverted at once. Piece-table documents keep no history
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return true Success
+ * @return false Nothing to undo or failure, history is cleared on failure
+ */
+bool aFile_undo(aFile_t * restrict self);
+/**
+ * @brief Applies the last reverted record of edit history again
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return true Success
+ * @return false Nothing to redo or failure, history is cleared on failure
+ */
+bool aFile_redo(aFile_t * restrict self);
+/**
+ * @brief Ends the current run of edits, next edit starts a new undo record
+ * 
+ * @param self Pointer to aFile_t structure
+ */
+void aFile_sealUndo(aFile_t * restrict self);
+/**
+ * @brief Starts journaling edits to a sidecar file (see aJournal.h), call after
+ * the file has been (re)loaded. A journal left behind by a session that didn't
+ * exit cleanly is replayed first, if it belongs to the file on disc, waits
+ * for the file to load in that case. Edits journaled before are discarded.
+ * Piece-table documents aren't journaled
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param recovered Address of number of edits replayed from the journal
+ * @return const wchar* Error message, NULL on success
+ */
+const wchar * aFile_openJournal(aFile_t * restrict self, usize * restrict recovered);
+/**
+ * @brief Calculates line number of current line in O(log n)
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return usize Line number, starting from 0
+ */
+usize aFile_curLine(const aFile_t * restrict self);
+/**
+ * @brief Moves cursor to the beginning of given line in O(log n)
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param line Line number, starting from 0, clamped to the last line
+ */
+void aFile_gotoLine(aFile_t * restrict self, usize line);
+/**
+ * @brief Calculates column of cursor on current line
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return usize Column, starting from 0
+ */
+usize aFile_curCol(const aFile_t * restrict self);
+/**
+ * @brief Moves cursor on current line, clamps movement
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param delta Amount of characters to move, positive values to move right,
+ * negative values to move left
+ */
+void aFile_moveCursor(aFile_t * restrict self, isize delta);
+/**
+ * @brief Fetches line of a piece-table document without EOL characters
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param line Line number, starting from 0, clamped to the last line
+ * @param len Address of number of characters in line
+ * @return const wchar* Line contents, valid until the next call, NULL on failure
+ */
+const wchar * aFile_pieceLine(aFile_t * restrict self, usize line, usize * restrict len);
+/**
+ * @brief Creates lines of a span node, does nothing if node isn't a span
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param node Pointer to line node
+ * @param offset Line offset inside of the span
+ * @return aLine_t* Pointer to line at offset, NULL on failure
+ */
+aLine_t * aFile_materialise(aFile_t * restrict self, aLine_t * restrict node, usize offset);
+/**
+ * @brief Gets next line, creates it first if it's part of a span
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param node Pointer to line node
+ * @return aLine_t* Pointer to next line, NULL if there is none or on failure
+ */
+aLine_t * aFile_nextLine(aFile_t * restrict self, aLine_t * restrict node);
+/**
+ * @brief Gets previous line, creates it first if it's part of a span
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param node Pointer to line node
+ * @return aLine_t* Pointer to previous line, NULL if there is none or on failure
+ */
+aLine_t * aFile_prevLine(aFile_t * restrict self, aLine_t * restrict node);
+/**
+ * @brief Moves cursor to the next match, wraps around to the top of file. Spans
+ * of mapped lines are searched as they are, only the line with the match is created
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param find Pointer to needle
+ * @param skip Whether a match right at the cursor is skipped, for finding the next one
+ * @return true Match has been found, cursor is at its start
+ * @return false No match or failure, cursor stays in place
+ */
+bool aFile_find(aFile_t * restrict self, const aFind_t * restrict find, bool skip);
+/**
+ * @brief Moves cursor to the next regular expression match, like aFile_find.
+ * Spans are streamed through the expression's DFA
+ * 
+ * @param self Pointer to aFile_t structure
+ * @param re Pointer to compiled regular expression
+ * @param skip Whether a match right at the cursor is skipped, for finding the next one
+ * @return true Match has been found, cursor is at its start
+ * @return false No match or failure, cursor stays in place
+ */
+bool aFile_findRegex(aFile_t * restrict self, aRegex_t * restrict re, bool skip);
 /**
  * @brief Updates current viewpoint if necessary, shifts view vertically
  * 
@@ -263,6 +793,15 @@ bool aFile_addNewLine(aFile_t * restrict self);
  */
 void aFile_updateCury(aFile_t * restrict self, u32 height);
 
+/**
+ * @brief Packs lines the cursor has left to UTF-8 storage or compacts
+ * their gaps, meant to be run while the editor is idle
+ * 
+ * @param self Pointer to aFile_t structure
+ * @return usize Number of bytes reclaimed since last call
+ */
+usize aFile_compact(aFile_t * restrict self);
+
 /**
  * @brief Destroys aFile_t structure
  * 
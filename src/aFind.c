@@ -0,0 +1,172 @@
+#include "aFind.h"
+#include "aUtf.h"
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define ATTO_FIND_SSE2 1
+#else
+	#define ATTO_FIND_SSE2 0
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define ATTO_FIND_AVX2 1
+	#define ATTO_FIND_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define ATTO_FIND_AVX2 0
+#endif
+
+
+static bool aFind_verify(const aFind_t * restrict self, const char * restrict at)
+{
+	// First & last byte have matched already
+	return (self->u8len <= 2) || (memcmp(at + 1, self->u8 + 1, self->u8len - 2) == 0);
+}
+
+#if ATTO_FIND_AVX2 == 1
+ATTO_FIND_TARGET_AVX2 static bool aFind_filterAvx2(const aFind_t * restrict self, const char * restrict hay, usize len, usize * restrict pos)
+{
+	const usize last = self->u8len - 1;
+	const __m256i vfirst = _mm256_set1_epi8(self->u8[0]), vlast = _mm256_set1_epi8(self->u8[last]);
+	usize i = *pos;
+	for (; (i + last + 32) <= len; i += 32)
+	{
+		const __m256i a = _mm256_loadu_si256((const __m256i *)(const void *)(hay + i));
+		const __m256i b = _mm256_loadu_si256((const __m256i *)(const void *)(hay + i + last));
+		u32 mask = (u32)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, vfirst), _mm256_cmpeq_epi8(b, vlast)));
+		for (; mask != 0; mask &= mask - 1)
+		{
+			const usize at = i + (usize)__builtin_ctz(mask);
+			if (aFind_verify(self, hay + at))
+			{
+				*pos = at;
+				return true;
+			}
+		}
+	}
+	*pos = i;
+	return false;
+}
+#endif
+#if (ATTO_FIND_SSE2 == 1) && defined(__GNUC__)
+static bool aFind_filterSse2(const aFind_t * restrict self, const char * restrict hay, usize len, usize * restrict pos)
+{
+	const usize last = self->u8len - 1;
+	const __m128i vfirst = _mm_set1_epi8(self->u8[0]), vlast = _mm_set1_epi8(self->u8[last]);
+	usize i = *pos;
+	for (; (i + last + 16) <= len; i += 16)
+	{
+		const __m128i a = _mm_loadu_si128((const __m128i *)(const void *)(hay + i));
+		const __m128i b = _mm_loadu_si128((const __m128i *)(const void *)(hay + i + last));
+		u32 mask = (u32)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, vfirst), _mm_cmpeq_epi8(b, vlast)));
+		for (; mask != 0; mask &= mask - 1)
+		{
+			const usize at = i + (usize)__builtin_ctz(mask);
+			if (aFind_verify(self, hay + at))
+			{
+				*pos = at;
+				return true;
+			}
+		}
+	}
+	*pos = i;
+	return false;
+}
+#endif
+
+void aFind_init(aFind_t * restrict self)
+{
+	self->wlen  = 0;
+	self->u8    = NULL;
+	self->u8len = 0;
+}
+bool aFind_set(aFind_t * restrict self, const wchar * restrict needle, usize len)
+{
+	aFind_destroy(self);
+	if (len > ATTO_FIND_MAX)
+	{
+		return false;
+	}
+	else if (len == 0)
+	{
+		return true;
+	}
+
+	self->u8 = malloc(aUtf_u8Len(needle, len));
+	if (self->u8 == NULL)
+	{
+		return false;
+	}
+	memcpy(self->w, needle, sizeof(wchar) * len);
+	self->wlen  = len;
+	self->u8len = aUtf_toU8(needle, len, self->u8);
+
+	const usize m = self->u8len;
+	for (usize i = 0; i < 256; ++i)
+	{
+		self->shift[i] = m;
+	}
+	for (usize i = 0; (i + 1) < m; ++i)
+	{
+		self->shift[(u8)self->u8[i]] = m - 1 - i;
+	}
+	return true;
+}
+bool aFind_empty(const aFind_t * restrict self)
+{
+	return self->wlen == 0;
+}
+usize aFind_inU8(const aFind_t * restrict self, const char * restrict hay, usize len)
+{
+	const usize m = self->u8len;
+	if ((m == 0) || (m > len))
+	{
+		return len;
+	}
+
+	usize i = 0;
+#if ATTO_FIND_AVX2 == 1
+	if (aUtf_hasAvx2() && aFind_filterAvx2(self, hay, len, &i))
+	{
+		return i;
+	}
+#endif
+#if (ATTO_FIND_SSE2 == 1) && defined(__GNUC__)
+	if (aFind_filterSse2(self, hay, len, &i))
+	{
+		return i;
+	}
+#endif
+	const char lastCh = self->u8[m - 1];
+	for (; (i + m) <= len; i += self->shift[(u8)hay[i + m - 1]])
+	{
+		if ((hay[i + m - 1] == lastCh) && (memcmp(hay + i, self->u8, m - 1) == 0))
+		{
+			return i;
+		}
+	}
+	return len;
+}
+usize aFind_inW(const aFind_t * restrict self, const wchar * restrict hay, usize len)
+{
+	const usize m = self->wlen;
+	for (usize i = 0; (m > 0) && ((i + m) <= len);)
+	{
+		const wchar * restrict p = wmemchr(hay + i, self->w[0], len - m + 1 - i);
+		if (p == NULL)
+		{
+			break;
+		}
+		i = (usize)(p - hay);
+		if (wmemcmp(p + 1, self->w + 1, m - 1) == 0)
+		{
+			return i;
+		}
+		++i;
+	}
+	return len;
+}
+void aFind_destroy(aFind_t * restrict self)
+{
+	free(self->u8);
+	aFind_init(self);
+}
@@ -0,0 +1,81 @@
+#ifndef ATTO_FIND_H
+#define ATTO_FIND_H
+
+#include "aCommon.h"
+
+/*
+	Literal substring search. A needle is kept both as wchar, for gap
+	buffer lines, and as UTF-8, for packed lines & mapped spans, which are
+	searched without being decoded; UTF-8 can't match in the middle of a
+	code point.
+
+	UTF-8 search filters candidates 32 (AVX2, if the CPU has it) or 16
+	(SSE2) positions at a time by comparing the needle's first & last byte,
+	only candidates passing both are verified. Whatever is left is searched
+	with Horspool's algorithm.
+*/
+
+// Longest needle in wchar units
+#define ATTO_FIND_MAX 256
+
+typedef struct aFind
+{
+	wchar w[ATTO_FIND_MAX];
+	usize wlen;
+	char * u8;
+	usize u8len;
+	// Horspool shifts of the UTF-8 needle
+	usize shift[256];
+
+} aFind_t;
+
+/**
+ * @brief Initialises an empty needle, which matches nothing
+ *
+ * @param self Pointer to aFind_t structure
+ */
+void aFind_init(aFind_t * restrict self);
+/**
+ * @brief Sets needle text
+ *
+ * @param self Pointer to aFind_t structure
+ * @param needle Pointer to wchar character array, can't contain line breaks
+ * @param len Number of wchar units, at most ATTO_FIND_MAX
+ * @return true Success
+ * @return false Memory error or needle is too long, needle becomes empty
+ */
+bool aFind_set(aFind_t * restrict self, const wchar * restrict needle, usize len);
+/**
+ * @brief Checks whether needle is empty
+ *
+ * @param self Pointer to aFind_t structure
+ * @return true Needle matches nothing
+ * @return false Needle is set
+ */
+bool aFind_empty(const aFind_t * restrict self);
+/**
+ * @brief Finds first match in UTF-8 text
+ *
+ * @param self Pointer to aFind_t structure
+ * @param hay Pointer to UTF-8 character array
+ * @param len Number of bytes
+ * @return usize Byte index of the first match, len if there is none
+ */
+usize aFind_inU8(const aFind_t * restrict self, const char * restrict hay, usize len);
+/**
+ * @brief Finds first match in wchar text
+ *
+ * @param self Pointer to aFind_t structure
+ * @param hay Pointer to wchar character array
+ * @param len Number of wchar units
+ * @return usize Index of the first match, len if there is none
+ */
+usize aFind_inW(const aFind_t * restrict self, const wchar * restrict hay, usize len);
+/**
+ * @brief Frees memory, needle becomes empty
+ *
+ * @param self Pointer to aFind_t structure
+ */
+void aFind_destroy(aFind_t * restrict self);
+
+#endif
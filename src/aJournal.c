@@ -0,0 +1,584 @@
+#ifndef _WIN32
+	#define _POSIX_C_SOURCE 200112L
+	#include <fcntl.h>
+	#include <unistd.h>
+
+	#define ATTO_JOURNAL_MAX_PATH 4096
+#endif
+
+#include "aJournal.h"
+#include "aUtf.h"
+#include "aProf.h"
+
+
+#define ATTO_JOURNAL_MAGIC "atJ1"
+#define ATTO_JOURNAL_HEADER (4 + 2 * sizeof(u64))
+#define ATTO_JOURNAL_FRAME (2 * sizeof(u32))
+// Op byte & 3 varints
+#define ATTO_JOURNAL_MAX_EDIT (1 + 3 * 10)
+// Only every this many-th edit is timed, reading the clock costs about as much as the edit
+#define ATTO_JOURNAL_SAMPLE 16
+
+#ifdef _WIN32
+	typedef HANDLE aJournalFile_t;
+	#define ATTO_JOURNAL_NO_FILE INVALID_HANDLE_VALUE
+#else
+	typedef int aJournalFile_t;
+	#define ATTO_JOURNAL_NO_FILE -1
+#endif
+
+static u32 aJournal_hash(const char * restrict mem, usize len)
+{
+	u32 hash = 2166136261u;
+	for (usize i = 0; i < len; ++i)
+	{
+		hash = (hash ^ (u8)mem[i]) * 16777619u;
+	}
+	return hash;
+}
+static usize aJournal_putVar(char * restrict dst, u64 value)
+{
+	usize n = 0;
+	for (; value >= 0x80; value >>= 7)
+	{
+		dst[n++] = (char)((value & 0x7F) | 0x80);
+	}
+	dst[n++] = (char)value;
+	return n;
+}
+static bool aJournal_getVar(const char * restrict src, usize len, usize * restrict pos, usize * restrict value)
+{
+	u64 v = 0;
+	for (u32 shift = 0; (*pos < len) && (shift < 64); shift += 7)
+	{
+		const u8 byte = (u8)src[(*pos)++];
+		v |= (u64)(byte & 0x7F) << shift;
+		if (!(byte & 0x80))
+		{
+			*value = (usize)v;
+			return true;
+		}
+	}
+	return false;
+}
+
+#ifndef _WIN32
+static bool aJournal_path(const wchar * restrict name, char * restrict path)
+{
+	// Paths are encoded as UTF-8, whatever the locale
+	const usize len = wcslen(name);
+	if (aUtf_u8Len(name, len) >= ATTO_JOURNAL_MAX_PATH)
+	{
+		return false;
+	}
+	path[aUtf_toU8(name, len, path)] = '\0';
+	return true;
+}
+#endif
+static wchar * aJournal_name(const wchar * restrict fileName)
+{
+	const usize len = wcslen(fileName), suffixLen = wcslen(ATTO_JOURNAL_SUFFIX);
+	wchar * name = malloc(sizeof(wchar) * (len + suffixLen + 1));
+	if (name != NULL)
+	{
+		memcpy(name, fileName, sizeof(wchar) * len);
+		memcpy(name + len, ATTO_JOURNAL_SUFFIX, sizeof(wchar) * (suffixLen + 1));
+	}
+	return name;
+}
+static bool aJournal_write(aJournalFile_t file, const char * restrict src, usize len)
+{
+	bool ok = true;
+	for (usize written = 0; ok && (written < len);)
+	{
+#ifdef _WIN32
+		const usize chunk = ((len - written) < ((usize)1 << 30)) ? (len - written) : ((usize)1 << 30);
+		DWORD dwWritten = 0;
+		ok = WriteFile(file, src + written, (DWORD)chunk, &dwWritten, NULL) != FALSE;
+		written += dwWritten;
+#else
+		const ssize_t n = write(file, src + written, len - written);
+		ok = (n > 0);
+		written += ok ? (usize)n : 0;
+#endif
+	}
+	return ok;
+}
+static bool aJournal_sync(aJournalFile_t file)
+{
+#ifdef _WIN32
+	return FlushFileBuffers(file) != FALSE;
+#else
+	return fsync(file) == 0;
+#endif
+}
+static void aJournal_close(aJournalFile_t file)
+{
+	if (file != ATTO_JOURNAL_NO_FILE)
+	{
+#ifdef _WIN32
+		CloseHandle(file);
+#else
+		close(file);
+#endif
+	}
+}
+static aJournalFile_t aJournal_create(const wchar * restrict name, u64 baseSize, u64 baseTime, usize keep)
+{
+	// Kept journal is only cut to its undamaged part
+#ifdef _WIN32
+	aJournalFile_t file = CreateFileW(
+		name,
+		GENERIC_WRITE,
+		FILE_SHARE_READ,
+		NULL,
+		(keep > 0) ? OPEN_EXISTING : CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+	if ((file != ATTO_JOURNAL_NO_FILE) && (keep > 0))
+	{
+		LARGE_INTEGER pos;
+		pos.QuadPart = (LONGLONG)keep;
+		if (!SetFilePointerEx(file, pos, NULL, FILE_BEGIN) || !SetEndOfFile(file))
+		{
+			CloseHandle(file);
+			file = ATTO_JOURNAL_NO_FILE;
+		}
+	}
+#else
+	char path[ATTO_JOURNAL_MAX_PATH];
+	aJournalFile_t file = aJournal_path(name, path) ? open(path, O_WRONLY | ((keep > 0) ? 0 : (O_CREAT | O_TRUNC)), 0600) : -1;
+	if ((file != -1) && (keep > 0) && ((ftruncate(file, (off_t)keep) != 0) || (lseek(file, (off_t)keep, SEEK_SET) == (off_t)-1)))
+	{
+		close(file);
+		file = -1;
+	}
+#endif
+	if ((file == ATTO_JOURNAL_NO_FILE) || (keep > 0))
+	{
+		return file;
+	}
+
+	char header[ATTO_JOURNAL_HEADER];
+	memcpy(header, ATTO_JOURNAL_MAGIC, 4);
+	memcpy(header + 4, &baseSize, sizeof(u64));
+	memcpy(header + 4 + sizeof(u64), &baseTime, sizeof(u64));
+	if (!aJournal_write(file, header, ATTO_JOURNAL_HEADER) || !aJournal_sync(file))
+	{
+		aJournal_close(file);
+		return ATTO_JOURNAL_NO_FILE;
+	}
+	return file;
+}
+
+static void aJournal_work(vptr arg)
+{
+	aJournal_t * restrict self = arg;
+	aJournalFile_t file = ATTO_JOURNAL_NO_FILE;
+	// Swapped with the pending buffer on every commit
+	char * buf = NULL;
+	usize cap = 0;
+
+	for (bool stop = false; !stop;)
+	{
+		aThread_wait(&self->wake, ATTO_JOURNAL_MS);
+
+		aThread_lock(&self->lock);
+		char * edits = self->buf;
+		const usize len = self->len, editsCap = self->cap;
+		const bool restart = self->restart;
+		const u64 baseSize = self->baseSize, baseTime = self->baseTime;
+		const usize keep = self->keep;
+		stop = self->stop;
+		self->buf = buf;
+		self->cap = cap;
+		self->len = 0;
+		self->ops = 0;
+		self->restart = false;
+		self->keep    = 0;
+		aThread_unlock(&self->lock);
+		buf = edits;
+		cap = editsCap;
+
+		if (!restart && (len == 0))
+		{
+			continue;
+		}
+
+		const i64 start = aProf_now();
+		if (restart)
+		{
+			aJournal_close(file);
+			file = aJournal_create(self->name, baseSize, baseTime, keep);
+		}
+		bool ok = (file != ATTO_JOURNAL_NO_FILE);
+		if (ok && (len > 0))
+		{
+			char frame[ATTO_JOURNAL_FRAME];
+			const u32 frameLen = (u32)len, hash = aJournal_hash(edits, len);
+			memcpy(frame, &frameLen, sizeof(u32));
+			memcpy(frame + sizeof(u32), &hash, sizeof(u32));
+			ok = aJournal_write(file, frame, ATTO_JOURNAL_FRAME) && aJournal_write(file, edits, len) && aJournal_sync(file);
+		}
+		const i64 end = aProf_now();
+
+		aThread_lock(&self->lock);
+		self->stats.commits += (len > 0);
+		self->stats.bytes   += len;
+		self->stats.commitNs += end - start;
+		self->stats.failed   = self->stats.failed || !ok;
+		aThread_unlock(&self->lock);
+	}
+
+	aJournal_close(file);
+	free(buf);
+}
+
+ajl_e aJournal_load(
+	const wchar * restrict fileName,
+	u64 baseSize,
+	u64 baseTime,
+	char ** restrict edits,
+	usize * restrict len,
+	usize * restrict end
+)
+{
+	wchar * name = aJournal_name(fileName);
+	if (name == NULL)
+	{
+		return ajlMEM_ERROR;
+	}
+#ifdef _WIN32
+	aJournalFile_t file = CreateFileW(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+#else
+	char path[ATTO_JOURNAL_MAX_PATH];
+	aJournalFile_t file = aJournal_path(name, path) ? open(path, O_RDONLY) : -1;
+#endif
+	free(name);
+	if (file == ATTO_JOURNAL_NO_FILE)
+	{
+		return ajlNONE;
+	}
+
+	// Whole journal is read to memory, frames are then packed back-to-back
+	char * mem = NULL;
+	usize size = 0, cap = 0;
+	bool ok = true;
+	for (;;)
+	{
+		if (size == cap)
+		{
+			cap = (cap == 0) ? (64 * 1024) : (2 * cap);
+			vptr newMem = realloc(mem, cap);
+			if (newMem == NULL)
+			{
+				ok = false;
+				break;
+			}
+			mem = newMem;
+		}
+#ifdef _WIN32
+		const usize chunk = ((cap - size) < ((usize)1 << 30)) ? (cap - size) : ((usize)1 << 30);
+		DWORD dwRead = 0;
+		const usize n = (ReadFile(file, mem + size, (DWORD)chunk, &dwRead, NULL) != FALSE) ? dwRead : 0;
+#else
+		const ssize_t res = read(file, mem + size, cap - size);
+		const usize n = (res > 0) ? (usize)res : 0;
+#endif
+		if (n == 0)
+		{
+			break;
+		}
+		size += n;
+	}
+	aJournal_close(file);
+	if (!ok)
+	{
+		free(mem);
+		return ajlMEM_ERROR;
+	}
+
+	u64 size0 = 0, time0 = 0;
+	if (size >= ATTO_JOURNAL_HEADER)
+	{
+		memcpy(&size0, mem + 4, sizeof(u64));
+		memcpy(&time0, mem + 4 + sizeof(u64), sizeof(u64));
+	}
+	if ((size < ATTO_JOURNAL_HEADER) || (memcmp(mem, ATTO_JOURNAL_MAGIC, 4) != 0) || (size0 != baseSize) || (time0 != baseTime))
+	{
+		free(mem);
+		return ajlSTALE;
+	}
+
+	usize out = 0, pos = ATTO_JOURNAL_HEADER;
+	while ((size - pos) >= ATTO_JOURNAL_FRAME)
+	{
+		u32 frameLen, hash;
+		memcpy(&frameLen, mem + pos, sizeof(u32));
+		memcpy(&hash, mem + pos + sizeof(u32), sizeof(u32));
+		const usize payload = pos + ATTO_JOURNAL_FRAME;
+		if (((size - payload) < frameLen) || (aJournal_hash(mem + payload, frameLen) != hash))
+		{
+			break;
+		}
+		memmove(mem + out, mem + payload, frameLen);
+		out += frameLen;
+		pos  = payload + frameLen;
+	}
+
+	*edits = mem;
+	*len   = out;
+	*end   = pos;
+	return ajlOK;
+}
+bool aJournal_next(const char * restrict edits, usize len, usize * restrict pos, aJournalEdit_t * restrict edit)
+{
+	if (*pos >= len)
+	{
+		return false;
+	}
+	edit->op = (ajo_e)(u8)edits[(*pos)++];
+	if ((edit->op < ajoINSERT) || (edit->op > ajoEOL) ||
+		!aJournal_getVar(edits, len, pos, &edit->line) ||
+		!aJournal_getVar(edits, len, pos, &edit->col) ||
+		!aJournal_getVar(edits, len, pos, &edit->len))
+	{
+		return false;
+	}
+	edit->text = NULL;
+	if (edit->op == ajoINSERT)
+	{
+		if ((len - *pos) < edit->len)
+		{
+			return false;
+		}
+		edit->text = edits + *pos;
+		*pos += edit->len;
+	}
+	return true;
+}
+
+void aJournal_init(aJournal_t * restrict self)
+{
+	*self = (aJournal_t){
+		.name     = NULL,
+		.active   = false,
+		.buf      = NULL,
+		.len      = 0,
+		.cap      = 0,
+		.ops      = 0,
+		.baseSize = 0,
+		.baseTime = 0,
+		.keep     = 0,
+		.restart  = true,
+		.stop     = false,
+		.stats    = { 0 },
+		.cutBuf   = NULL,
+		.cutLen   = 0,
+		.cutCap   = 0,
+		.cutOps   = 0,
+		.cutting  = false
+	};
+}
+bool aJournal_start(aJournal_t * restrict self, const wchar * restrict fileName, u64 baseSize, u64 baseTime, usize keep)
+{
+	aJournal_init(self);
+	self->baseSize = baseSize;
+	self->baseTime = baseTime;
+	self->keep     = keep;
+	self->name     = aJournal_name(fileName);
+	if (self->name == NULL)
+	{
+		return false;
+	}
+	else if (!aThread_signalInit(&self->wake))
+	{
+		free(self->name);
+		self->name = NULL;
+		return false;
+	}
+	aThread_lockInit(&self->lock);
+	if (!aThread_create(&self->thread, &aJournal_work, self))
+	{
+		aThread_lockDestroy(&self->lock);
+		aThread_signalDestroy(&self->wake);
+		free(self->name);
+		self->name = NULL;
+		return false;
+	}
+	self->active = true;
+	// Journal file is opened right away
+	aThread_signal(&self->wake);
+	return true;
+}
+static char * aJournal_reserve(char ** restrict buf, usize len, usize * restrict cap, usize bytes)
+{
+	if ((*cap - len) < bytes)
+	{
+		usize newCap = (*cap == 0) ? 4096 : *cap;
+		while ((newCap - len) < bytes)
+		{
+			newCap *= 2;
+		}
+		vptr mem = realloc(*buf, newCap);
+		if (mem == NULL)
+		{
+			return NULL;
+		}
+		*buf = mem;
+		*cap = newCap;
+	}
+	return *buf + len;
+}
+void aJournal_add(aJournal_t * restrict self, ajo_e op, usize line, usize col, const wchar * restrict text, usize len)
+{
+	if (!self->active)
+	{
+		return;
+	}
+	const bool timed = (self->stats.edits % ATTO_JOURNAL_SAMPLE) == 0;
+	const i64 start = timed ? aProf_now() : 0;
+
+	aThread_lock(&self->lock);
+	const usize maxBytes = ATTO_JOURNAL_MAX_EDIT + ((text != NULL) ? (ATTO_UTF_MAX_U8 * len) : 0);
+	char * restrict dst = aJournal_reserve(&self->buf, self->len, &self->cap, maxBytes);
+	usize n = 0;
+	if (dst != NULL)
+	{
+		dst[n++] = (char)op;
+		n += aJournal_putVar(dst + n, line);
+		n += aJournal_putVar(dst + n, col);
+		if (text != NULL)
+		{
+			n += aJournal_putVar(dst + n, aUtf_u8Len(text, len));
+			n += aUtf_toU8(text, len, dst + n);
+		}
+		else
+		{
+			n += aJournal_putVar(dst + n, len);
+		}
+		self->len += n;
+	}
+	else
+	{
+		// Journal can't be trusted anymore without this edit
+		self->stats.failed = true;
+	}
+	if (self->cutting && (n > 0))
+	{
+		char * restrict cut = aJournal_reserve(&self->cutBuf, self->cutLen, &self->cutCap, n);
+		if (cut != NULL)
+		{
+			memcpy(cut, dst, n);
+			self->cutLen += n;
+			++self->cutOps;
+		}
+		else
+		{
+			self->stats.failed = true;
+		}
+	}
+	const bool wake = (++self->ops == ATTO_JOURNAL_OPS);
+	aThread_unlock(&self->lock);
+
+	if (wake)
+	{
+		aThread_signal(&self->wake);
+	}
+
+	++self->stats.edits;
+	if (timed)
+	{
+		++self->stats.timed;
+		self->stats.addNs += aProf_now() - start;
+	}
+}
+void aJournal_cut(aJournal_t * restrict self)
+{
+	self->cutting = self->active;
+	self->cutLen  = 0;
+	self->cutOps  = 0;
+}
+void aJournal_rebase(aJournal_t * restrict self, bool saved, u64 baseSize, u64 baseTime)
+{
+	if (!self->active || !saved)
+	{
+		self->cutting = false;
+		return;
+	}
+
+	aThread_lock(&self->lock);
+	self->baseSize = baseSize;
+	self->baseTime = baseTime;
+	self->restart  = true;
+	self->len      = 0;
+	self->ops      = 0;
+	if (self->cutting && (self->cutLen > 0))
+	{
+		char * restrict dst = aJournal_reserve(&self->buf, 0, &self->cap, self->cutLen);
+		if (dst != NULL)
+		{
+			memcpy(dst, self->cutBuf, self->cutLen);
+			self->len = self->cutLen;
+			self->ops = self->cutOps;
+		}
+		else
+		{
+			self->stats.failed = true;
+		}
+	}
+	aThread_unlock(&self->lock);
+
+	self->cutting = false;
+	self->cutLen  = 0;
+	self->cutOps  = 0;
+	aThread_signal(&self->wake);
+}
+void aJournal_stats(aJournal_t * restrict self, aJournalStats_t * restrict stats)
+{
+	if (!self->active)
+	{
+		*stats = self->stats;
+		return;
+	}
+	aThread_lock(&self->lock);
+	*stats = self->stats;
+	aThread_unlock(&self->lock);
+}
+void aJournal_stop(aJournal_t * restrict self, bool remove)
+{
+	if (self->active)
+	{
+		aThread_lock(&self->lock);
+		self->stop = true;
+		aThread_unlock(&self->lock);
+		aThread_signal(&self->wake);
+		aThread_join(&self->thread);
+
+		aThread_lockDestroy(&self->lock);
+		aThread_signalDestroy(&self->wake);
+		self->active = false;
+
+		if (remove)
+		{
+#ifdef _WIN32
+			DeleteFileW(self->name);
+#else
+			char path[ATTO_JOURNAL_MAX_PATH];
+			if (aJournal_path(self->name, path))
+			{
+				unlink(path);
+			}
+#endif
+		}
+	}
+	free(self->name);
+	free(self->buf);
+	free(self->cutBuf);
+	self->name   = NULL;
+	self->buf    = NULL;
+	self->cutBuf = NULL;
+	self->len    = 0;
+	self->cap    = 0;
+}
@@ -0,0 +1,190 @@
+#ifndef ATTO_JOURNAL_H
+#define ATTO_JOURNAL_H
+
+#include "aCommon.h"
+#include "aThread.h"
+
+/*
+	Crash-recovery journal: edits are appended to a sidecar file next to
+	the document. The editor thread only encodes an edit to a memory
+	buffer. A writer thread takes everything gathered so far every
+	ATTO_JOURNAL_MS milliseconds, or as soon as ATTO_JOURNAL_OPS edits are
+	waiting, writes it as a single frame and flushes it to disc. A crash
+	loses at most the edits of the last interval.
+
+	File starts with a header: magic, size & last write time of the file
+	the edits apply to. Frames follow: u32 payload length, u32 FNV-1a hash
+	of the payload & the payload itself, a run of edits. Edit is an op
+	byte, then line, column & length as LEB128 varints; inserted text
+	follows as UTF-8. A torn or damaged frame ends the journal on recovery.
+
+	Uses Win32 file functions on Windows and POSIX ones elsewhere.
+*/
+
+// Appended to the document's name to get the journal's name
+#define ATTO_JOURNAL_SUFFIX L".atto#"
+// Pending edits are committed at least this often
+#define ATTO_JOURNAL_MS 250
+// Pending edits are committed right away once there's this many of them
+#define ATTO_JOURNAL_OPS 256
+
+typedef enum aJournalOp
+{
+	// Text inserted at line & column, length is in UTF-8 bytes
+	ajoINSERT = 1,
+	// Length characters deleted from line & column, line breaks count as one
+	ajoERASE,
+	// EOL sequence changed to length
+	ajoEOL
+
+} aJournalOp_e, ajo_e;
+
+typedef struct aJournalEdit
+{
+	ajo_e op;
+	usize line, col, len;
+	const char * text;
+
+} aJournalEdit_t;
+
+typedef enum aJournalLoad
+{
+	ajlNONE,
+	// Journal belongs to another version of the file
+	ajlSTALE,
+	ajlOK,
+	ajlMEM_ERROR
+
+} aJournalLoad_e, ajl_e;
+
+typedef struct aJournalStats
+{
+	// Counted on the editor thread, addNs is spent by the timed edits
+	usize edits, timed;
+	i64 addNs;
+	// Counted on the writer thread
+	usize commits, bytes;
+	i64 commitNs;
+	bool failed;
+
+} aJournalStats_t;
+
+typedef struct aJournal
+{
+	wchar * name;
+	aThread_t thread;
+	aThreadLock_t lock;
+	aThreadSignal_t wake;
+	bool active;
+
+	// Guarded by lock: pending edits & requests for the writer
+	char * buf;
+	usize len, cap, ops;
+	u64 baseSize, baseTime;
+	// Bytes of the existing journal kept on restart, 0 starts a new one
+	usize keep;
+	bool restart, stop;
+	aJournalStats_t stats;
+
+	// Edits made since aJournal_cut, editor thread only
+	char * cutBuf;
+	usize cutLen, cutCap, cutOps;
+	bool cutting;
+
+} aJournal_t;
+
+/**
+ * @brief Reads journal of a file, keeps only edits of undamaged frames
+ *
+ * @param fileName Document's file name
+ * @param baseSize Size of the document on disc
+ * @param baseTime Last write time of the document on disc
+ * @param edits Address of pointer receiving encoded edits, has to be freed
+ * @param len Address of number of bytes of edits
+ * @param end Address of length of the undamaged part of the journal file
+ * @return ajl_e Result, edits are only set for ajlOK
+ */
+ajl_e aJournal_load(
+	const wchar * restrict fileName,
+	u64 baseSize,
+	u64 baseTime,
+	char ** restrict edits,
+	usize * restrict len,
+	usize * restrict end
+);
+/**
+ * @brief Decodes next edit
+ *
+ * @param edits Pointer to encoded edits
+ * @param len Number of bytes of edits
+ * @param pos Address of position, advanced past the edit
+ * @param edit Pointer to receiving structure
+ * @return true Edit has been decoded
+ * @return false No more edits or damaged edit
+ */
+bool aJournal_next(const char * restrict edits, usize len, usize * restrict pos, aJournalEdit_t * restrict edit);
+
+/**
+ * @brief Initialises an inactive journal
+ *
+ * @param self Pointer to aJournal_t structure
+ */
+void aJournal_init(aJournal_t * restrict self);
+/**
+ * @brief Starts journaling next to the file
+ *
+ * @param self Pointer to inactive aJournal_t structure
+ * @param fileName Document's file name
+ * @param baseSize Size of the document on disc
+ * @param baseTime Last write time of the document on disc
+ * @param keep Length of the existing journal to append to (see aJournal_load),
+ * 0 replaces it with a new one
+ * @return true Success
+ * @return false Failure, journal stays inactive
+ */
+bool aJournal_start(aJournal_t * restrict self, const wchar * restrict fileName, u64 baseSize, u64 baseTime, usize keep);
+/**
+ * @brief Adds an edit, never waits for disc
+ *
+ * @param self Pointer to aJournal_t structure
+ * @param op Kind of edit
+ * @param line Line of the edit
+ * @param col Column of the edit
+ * @param text Inserted text for ajoINSERT, NULL otherwise
+ * @param len Number of characters of text, erased characters or EOL sequence
+ */
+void aJournal_add(aJournal_t * restrict self, ajo_e op, usize line, usize col, const wchar * restrict text, usize len);
+/**
+ * @brief Remembers the current state, which is about to be saved. Edits made
+ * from now on are kept until aJournal_rebase
+ *
+ * @param self Pointer to aJournal_t structure
+ */
+void aJournal_cut(aJournal_t * restrict self);
+/**
+ * @brief Restarts journal after a save: only edits made since aJournal_cut (none,
+ * if it wasn't called) are kept, on top of the new file on disc
+ *
+ * @param self Pointer to aJournal_t structure
+ * @param saved Whether the save has succeeded, journal is left as it was otherwise
+ * @param baseSize Size of the saved file
+ * @param baseTime Last write time of the saved file
+ */
+void aJournal_rebase(aJournal_t * restrict self, bool saved, u64 baseSize, u64 baseTime);
+/**
+ * @brief Gets journal statistics
+ *
+ * @param self Pointer to aJournal_t structure
+ * @param stats Pointer to destination aJournalStats_t structure, receives a copy
+ */
+void aJournal_stats(aJournal_t * restrict self, aJournalStats_t * restrict stats);
+/**
+ * @brief Commits pending edits, stops the writer & frees all memory, journal
+ * becomes inactive
+ *
+ * @param self Pointer to aJournal_t structure
+ * @param remove Whether journal file is deleted
+ */
+void aJournal_stop(aJournal_t * restrict self, bool remove);
+
+#endif
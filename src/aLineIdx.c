@@ -0,0 +1,387 @@
+#include "aLineIdx.h"
+
+
+static usize aLineIdx_subLines(const aLineIdx_t * restrict self)
+{
+	return (self == NULL) ? 0 : self->subLines;
+}
+static usize aLineIdx_subChars(const aLineIdx_t * restrict self)
+{
+	return (self == NULL) ? 0 : self->subChars;
+}
+static void aLineIdx_recalc(aLineIdx_t * restrict self)
+{
+	self->subLines = aLineIdx_subLines(self->left) + self->lines + aLineIdx_subLines(self->right);
+	self->subChars = aLineIdx_subChars(self->left) + self->chars + aLineIdx_subChars(self->right);
+}
+static void aLineIdx_refreshUp(aLineIdx_t * restrict self)
+{
+	// Header is refreshed as well, its own weight is 0
+	for (; self != NULL; self = self->parent)
+	{
+		aLineIdx_recalc(self);
+	}
+}
+static void aLineIdx_rotateUp(aLineIdx_t * restrict x)
+{
+	aLineIdx_t * restrict p = x->parent, * restrict g = p->parent;
+	if (x == p->left)
+	{
+		p->left = x->right;
+		if (p->left != NULL)
+		{
+			p->left->parent = p;
+		}
+		x->right = p;
+	}
+	else
+	{
+		p->right = x->left;
+		if (p->right != NULL)
+		{
+			p->right->parent = p;
+		}
+		x->left = p;
+	}
+	p->parent = x;
+	x->parent = g;
+	if (g->left == p)
+	{
+		g->left = x;
+	}
+	else
+	{
+		g->right = x;
+	}
+	aLineIdx_recalc(p);
+	aLineIdx_recalc(x);
+}
+static void aLineIdx_fixInsert(aLineIdx_t * restrict node)
+{
+	aLineIdx_refreshUp(node);
+	while ((node->parent->parent != NULL) && (node->prio > node->parent->prio))
+	{
+		aLineIdx_rotateUp(node);
+	}
+}
+static aLineIdx_t * aLineIdx_join(aLineIdx_t * restrict a, aLineIdx_t * restrict b)
+{
+	// Every node of a goes before every node of b
+	if ((a == NULL) || (b == NULL))
+	{
+		return (a == NULL) ? b : a;
+	}
+	else if (a->prio > b->prio)
+	{
+		a->right = aLineIdx_join(a->right, b);
+		a->right->parent = a;
+		aLineIdx_recalc(a);
+		return a;
+	}
+	else
+	{
+		b->left = aLineIdx_join(a, b->left);
+		b->left->parent = b;
+		aLineIdx_recalc(b);
+		return b;
+	}
+}
+
+void aLineIdx_reset(aLineIdx_t * restrict header)
+{
+	*header = (aLineIdx_t){
+		.parent = NULL,
+		.left   = NULL,
+		.right  = NULL
+	};
+}
+void aLineIdx_init(aLineIdx_t * restrict self, usize chars)
+{
+	// Priority is derived from node address, no random state needed
+	u64 h = (u64)(uintptr_t)self;
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDULL;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 33;
+
+	*self = (aLineIdx_t){
+		.parent   = NULL,
+		.left     = NULL,
+		.right    = NULL,
+		.prio     = (u32)h,
+		.lines    = 1,
+		.chars    = chars,
+		.subLines = 1,
+		.subChars = chars
+	};
+}
+bool aLineIdx_attached(const aLineIdx_t * restrict self)
+{
+	return self->parent != NULL;
+}
+
+void aLineIdx_insertFirst(aLineIdx_t * restrict header, aLineIdx_t * restrict node)
+{
+	if (header->left == NULL)
+	{
+		header->left = node;
+		node->parent = header;
+		aLineIdx_refreshUp(node);
+		return;
+	}
+
+	aLineIdx_t * restrict first = header->left;
+	while (first->left != NULL)
+	{
+		first = first->left;
+	}
+	aLineIdx_insertBefore(first, node);
+}
+void aLineIdx_insertAfter(aLineIdx_t * restrict prev, aLineIdx_t * restrict node)
+{
+	if (prev->right == NULL)
+	{
+		prev->right = node;
+		node->parent = prev;
+	}
+	else
+	{
+		aLineIdx_t * restrict p = prev->right;
+		while (p->left != NULL)
+		{
+			p = p->left;
+		}
+		p->left = node;
+		node->parent = p;
+	}
+	aLineIdx_fixInsert(node);
+}
+void aLineIdx_insertBefore(aLineIdx_t * restrict next, aLineIdx_t * restrict node)
+{
+	if (next->left == NULL)
+	{
+		next->left = node;
+		node->parent = next;
+	}
+	else
+	{
+		aLineIdx_t * restrict p = next->left;
+		while (p->right != NULL)
+		{
+			p = p->right;
+		}
+		p->right = node;
+		node->parent = p;
+	}
+	aLineIdx_fixInsert(node);
+}
+void aLineIdx_runInit(aLineIdxRun_t * restrict run)
+{
+	*run = (aLineIdxRun_t){
+		.root = NULL,
+		.last = NULL
+	};
+}
+void aLineIdx_runAppend(aLineIdxRun_t * restrict run, aLineIdx_t * restrict node)
+{
+	// Right spine nodes of lower priority become node's left subtree, their
+	// subtrees can't change any more
+	aLineIdx_t * p = run->last, * child = NULL;
+	while ((p != NULL) && (p->prio < node->prio))
+	{
+		aLineIdx_recalc(p);
+		child = p;
+		p = p->parent;
+	}
+	node->left  = child;
+	node->right = NULL;
+	if (child != NULL)
+	{
+		child->parent = node;
+	}
+	node->parent = p;
+	if (p == NULL)
+	{
+		run->root = node;
+	}
+	else
+	{
+		p->right = node;
+	}
+	run->last = node;
+}
+void aLineIdx_insertRun(aLineIdx_t * restrict header, aLineIdx_t * restrict prev, aLineIdxRun_t * restrict run)
+{
+	if (run->root == NULL)
+	{
+		return;
+	}
+	// Totals of the right spine are still missing
+	for (aLineIdx_t * n = run->last; n != NULL; n = n->parent)
+	{
+		aLineIdx_recalc(n);
+	}
+
+	// Tree is split after prev bottom-up, the run is joined in between
+	aLineIdx_t * left = NULL, * right = header->left;
+	if (prev != NULL)
+	{
+		left  = prev;
+		right = prev->right;
+		prev->right = NULL;
+		aLineIdx_recalc(prev);
+		for (aLineIdx_t * x = prev, * p = prev->parent; p != header;)
+		{
+			aLineIdx_t * g = p->parent;
+			if (p->right == x)
+			{
+				p->right = left;
+				left->parent = p;
+				left = p;
+			}
+			else
+			{
+				p->left = right;
+				if (right != NULL)
+				{
+					right->parent = p;
+				}
+				right = p;
+			}
+			aLineIdx_recalc(p);
+			x = p;
+			p = g;
+		}
+	}
+	if (left != NULL)
+	{
+		left->parent = NULL;
+	}
+	if (right != NULL)
+	{
+		right->parent = NULL;
+	}
+
+	aLineIdx_t * root = aLineIdx_join(aLineIdx_join(left, run->root), right);
+	header->left = root;
+	root->parent = header;
+	aLineIdx_recalc(header);
+	aLineIdx_runInit(run);
+}
+void aLineIdx_remove(aLineIdx_t * restrict self)
+{
+	// Rotate node down to a leaf
+	while ((self->left != NULL) || (self->right != NULL))
+	{
+		aLineIdx_t * restrict child;
+		if (self->left == NULL)
+		{
+			child = self->right;
+		}
+		else if (self->right == NULL)
+		{
+			child = self->left;
+		}
+		else
+		{
+			child = (self->left->prio > self->right->prio) ? self->left : self->right;
+		}
+		aLineIdx_rotateUp(child);
+	}
+
+	aLineIdx_t * restrict p = self->parent;
+	if (p->left == self)
+	{
+		p->left = NULL;
+	}
+	else
+	{
+		p->right = NULL;
+	}
+	self->parent = NULL;
+	aLineIdx_refreshUp(p);
+
+	self->subLines = self->lines;
+	self->subChars = self->chars;
+}
+
+void aLineIdx_update(aLineIdx_t * restrict self, usize lines, usize chars)
+{
+	if ((self->lines == lines) && (self->chars == chars))
+	{
+		return;
+	}
+	self->lines = lines;
+	self->chars = chars;
+	aLineIdx_refreshUp(self);
+}
+void aLineIdx_setChars(aLineIdx_t * restrict self, usize chars)
+{
+	aLineIdx_update(self, self->lines, chars);
+}
+
+usize aLineIdx_index(const aLineIdx_t * restrict self)
+{
+	usize idx = aLineIdx_subLines(self->left);
+	for (; (self->parent != NULL) && (self->parent->parent != NULL); self = self->parent)
+	{
+		if (self == self->parent->right)
+		{
+			idx += aLineIdx_subLines(self->parent->left) + self->parent->lines;
+		}
+	}
+	return idx;
+}
+usize aLineIdx_charIndex(const aLineIdx_t * restrict self)
+{
+	usize idx = aLineIdx_subChars(self->left);
+	for (; (self->parent != NULL) && (self->parent->parent != NULL); self = self->parent)
+	{
+		if (self == self->parent->right)
+		{
+			idx += aLineIdx_subChars(self->parent->left) + self->parent->chars;
+		}
+	}
+	return idx;
+}
+aLineIdx_t * aLineIdx_at(const aLineIdx_t * restrict header, usize line, usize * restrict offset)
+{
+	aLineIdx_t * restrict node = header->left;
+	if (node == NULL)
+	{
+		return NULL;
+	}
+	line = (line >= node->subLines) ? (node->subLines - 1) : line;
+
+	while (node != NULL)
+	{
+		const usize l = aLineIdx_subLines(node->left);
+		if (line < l)
+		{
+			node = node->left;
+		}
+		else if (line < (l + node->lines))
+		{
+			break;
+		}
+		else
+		{
+			line -= l + node->lines;
+			node = node->right;
+		}
+	}
+	if (offset != NULL)
+	{
+		*offset = line - aLineIdx_subLines(node->left);
+	}
+	return node;
+}
+usize aLineIdx_lines(const aLineIdx_t * restrict header)
+{
+	return aLineIdx_subLines(header->left);
+}
+usize aLineIdx_chars(const aLineIdx_t * restrict header)
+{
+	return aLineIdx_subChars(header->left);
+}
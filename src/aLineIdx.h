@@ -0,0 +1,161 @@
+#ifndef ATTO_LINEIDX_H
+#define ATTO_LINEIDX_H
+
+#include "aCommon.h"
+#include <stddef.h>
+
+/*
+	Balanced (treap) line index over the document, in-order traversal
+	follows the line list. Every node caches line & character count of its
+	subtree, so line addressing is O(log n).
+
+	The tree hangs off a header node: header.left is the root, root's
+	parent is the header, header's parent is NULL.
+*/
+
+typedef struct aLineIdx
+{
+	struct aLineIdx * parent, * left, * right;
+	u32 prio;
+
+	// Own weight
+	usize lines, chars;
+	// Subtree totals, own weight included
+	usize subLines, subChars;
+
+} aLineIdx_t;
+
+// Treap of detached nodes, built in order before it's spliced into a tree
+typedef struct aLineIdxRun
+{
+	aLineIdx_t * root, * last;
+
+} aLineIdxRun_t;
+
+/**
+ * @brief Resets tree header, empty tree
+ *
+ * @param header Pointer to tree header node
+ */
+void aLineIdx_reset(aLineIdx_t * restrict header);
+/**
+ * @brief Initialises a detached index node with a weight of 1 line
+ *
+ * @param self Pointer to index node
+ * @param chars Number of characters on the line
+ */
+void aLineIdx_init(aLineIdx_t * restrict self, usize chars);
+/**
+ * @brief Checks whether index node is part of a tree
+ *
+ * @param self Pointer to index node
+ * @return true Node is attached
+ * @return false Node is detached
+ */
+bool aLineIdx_attached(const aLineIdx_t * restrict self);
+
+/**
+ * @brief Inserts detached node as the first node of the tree
+ *
+ * @param header Pointer to tree header node
+ * @param node Pointer to detached index node
+ */
+void aLineIdx_insertFirst(aLineIdx_t * restrict header, aLineIdx_t * restrict node);
+/**
+ * @brief Inserts detached node right after an attached node
+ *
+ * @param prev Pointer to attached index node
+ * @param node Pointer to detached index node
+ */
+void aLineIdx_insertAfter(aLineIdx_t * restrict prev, aLineIdx_t * restrict node);
+/**
+ * @brief Inserts detached node right before an attached node
+ *
+ * @param next Pointer to attached index node
+ * @param node Pointer to detached index node
+ */
+void aLineIdx_insertBefore(aLineIdx_t * restrict next, aLineIdx_t * restrict node);
+/**
+ * @brief Initialises an empty run
+ *
+ * @param run Pointer to aLineIdxRun_t structure
+ */
+void aLineIdx_runInit(aLineIdxRun_t * restrict run);
+/**
+ * @brief Appends detached node to the end of a run, amortised O(1)
+ *
+ * @param run Pointer to aLineIdxRun_t structure
+ * @param node Pointer to detached index node, its weight has to be final
+ */
+void aLineIdx_runAppend(aLineIdxRun_t * restrict run, aLineIdx_t * restrict node);
+/**
+ * @brief Splices a whole run into the tree in O(log n) after the run is built,
+ * run becomes empty
+ *
+ * @param header Pointer to tree header node
+ * @param prev Pointer to attached index node the run goes after, NULL puts it first
+ * @param run Pointer to aLineIdxRun_t structure
+ */
+void aLineIdx_insertRun(aLineIdx_t * restrict header, aLineIdx_t * restrict prev, aLineIdxRun_t * restrict run);
+/**
+ * @brief Removes attached node from the tree, node becomes detached
+ *
+ * @param self Pointer to attached index node
+ */
+void aLineIdx_remove(aLineIdx_t * restrict self);
+
+/**
+ * @brief Updates own weight of a node, refreshes cached totals up to the root
+ *
+ * @param self Pointer to index node
+ * @param lines Number of lines node represents
+ * @param chars Number of characters node represents
+ */
+void aLineIdx_update(aLineIdx_t * restrict self, usize lines, usize chars);
+/**
+ * @brief Updates character count of a node, refreshes cached totals up to the root
+ *
+ * @param self Pointer to index node
+ * @param chars Number of characters on the line
+ */
+void aLineIdx_setChars(aLineIdx_t * restrict self, usize chars);
+
+/**
+ * @brief Calculates line number of node's first line
+ *
+ * @param self Pointer to attached index node
+ * @return usize Line number, starting from 0
+ */
+usize aLineIdx_index(const aLineIdx_t * restrict self);
+/**
+ * @brief Calculates number of characters before node
+ *
+ * @param self Pointer to attached index node
+ * @return usize Character offset
+ */
+usize aLineIdx_charIndex(const aLineIdx_t * restrict self);
+/**
+ * @brief Finds node containing given line
+ *
+ * @param header Pointer to tree header node
+ * @param line Line number, starting from 0, clamped to the last line
+ * @param offset Address of line offset inside found node, can be NULL
+ * @return aLineIdx_t* Pointer to index node, NULL if tree is empty
+ */
+aLineIdx_t * aLineIdx_at(const aLineIdx_t * restrict header, usize line, usize * restrict offset);
+/**
+ * @brief Total number of lines in tree
+ *
+ * @param header Pointer to tree header node
+ * @return usize Number of lines
+ */
+usize aLineIdx_lines(const aLineIdx_t * restrict header);
+/**
+ * @brief Total number of characters in tree
+ *
+ * @param header Pointer to tree header node
+ * @return usize Number of characters
+ */
+usize aLineIdx_chars(const aLineIdx_t * restrict header);
+
+#endif
@@ -13,6 +13,7 @@ int wmain(int argc, const wchar * argv[])
 		atto_printHelp(argv[0]);
 		return 1;
 	}
+	editor.file.pieceTable = atto_getPieceTable(argc, argv);
 
 	if (!aFile_open(&editor.file, fileName, false))
 	{
@@ -38,13 +39,10 @@ int wmain(int argc, const wchar * argv[])
 	else
 	{
 		wchar tempstr[MAX_STATUS];
-		swprintf_s(
-			tempstr,
-			MAX_STATUS,
-			L"File loaded successfully! %s%s EOL sequences",
-			(editor.file.eolSeq & eolCR) ? L"CR" : L"",
-			(editor.file.eolSeq & eolLF) ? L"LF" : L""
-		);
+		if (!atto_openJournal(&editor.file, tempstr))
+		{
+			atto_loadStatus(&editor.file, L"loaded", tempstr);
+		}
 		aData_statusDraw(&editor, tempstr);
 	}
 
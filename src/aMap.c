@@ -0,0 +1,121 @@
+#ifndef _WIN32
+	#define _POSIX_C_SOURCE 200112L
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+
+	#define ATTO_MAP_MAX_PATH 4096
+#endif
+
+#include "aMap.h"
+#include "aUtf.h"
+
+
+static void aMap_unmap(aMap_t * restrict self)
+{
+#ifdef _WIN32
+	if (self->mem != NULL)
+	{
+		UnmapViewOfFile(self->mem);
+	}
+	if (self->hMap != NULL)
+	{
+		CloseHandle(self->hMap);
+	}
+	if (self->hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(self->hFile);
+	}
+#else
+	if (self->mem != NULL)
+	{
+		munmap((vptr)(uintptr_t)self->mem, self->size);
+	}
+	if (self->fd != -1)
+	{
+		close(self->fd);
+	}
+#endif
+}
+
+void aMap_reset(aMap_t * restrict self)
+{
+	*self = (aMap_t){
+		.mem   = NULL,
+		.size  = 0,
+#ifdef _WIN32
+		.hFile = INVALID_HANDLE_VALUE,
+		.hMap  = NULL,
+#else
+		.fd    = -1
+#endif
+	};
+}
+bool aMap_open(aMap_t * restrict self, const wchar * restrict fileName)
+{
+	aMap_reset(self);
+
+#ifdef _WIN32
+	self->hFile = CreateFileW(
+		fileName,
+		GENERIC_READ,
+		FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL,
+		OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL,
+		NULL
+	);
+	LARGE_INTEGER size;
+	if ((self->hFile == INVALID_HANDLE_VALUE) || !GetFileSizeEx(self->hFile, &size) || (size.QuadPart == 0))
+	{
+		aMap_close(self);
+		return false;
+	}
+	self->size = (usize)size.QuadPart;
+
+	self->hMap = CreateFileMappingW(self->hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (self->hMap == NULL)
+	{
+		aMap_close(self);
+		return false;
+	}
+	self->mem = MapViewOfFile(self->hMap, FILE_MAP_READ, 0, 0, 0);
+#else
+	// Paths are encoded as UTF-8, whatever the locale
+	char path[ATTO_MAP_MAX_PATH];
+	const usize len = wcslen(fileName);
+	if (aUtf_u8Len(fileName, len) >= sizeof path)
+	{
+		return false;
+	}
+	path[aUtf_toU8(fileName, len, path)] = '\0';
+	self->fd = open(path, O_RDONLY);
+	struct stat st;
+	if ((self->fd == -1) || (fstat(self->fd, &st) != 0) || (st.st_size == 0))
+	{
+		aMap_close(self);
+		return false;
+	}
+	self->size = (usize)st.st_size;
+
+	vptr mem = mmap(NULL, self->size, PROT_READ, MAP_PRIVATE, self->fd, 0);
+	self->mem = (mem == MAP_FAILED) ? NULL : mem;
+#endif
+
+	if (self->mem == NULL)
+	{
+		aMap_close(self);
+		return false;
+	}
+	return true;
+}
+bool aMap_active(const aMap_t * restrict self)
+{
+	return self->mem != NULL;
+}
+void aMap_close(aMap_t * restrict self)
+{
+	aMap_unmap(self);
+	aMap_reset(self);
+}
@@ -0,0 +1,58 @@
+#ifndef ATTO_MAP_H
+#define ATTO_MAP_H
+
+#include "aCommon.h"
+
+/*
+	Read-only view of a whole file. Uses CreateFileMapping on Windows and
+	mmap elsewhere, pages are only brought in when they are touched.
+
+	The file is opened with write & delete sharing, so a mapped file can
+	still be written to in place, renamed or replaced by a new file under
+	the same name.
+*/
+
+typedef struct aMap
+{
+	const char * mem;
+	usize size;
+
+#ifdef _WIN32
+	HANDLE hFile, hMap;
+#else
+	int fd;
+#endif
+
+} aMap_t;
+
+/**
+ * @brief Resets aMap_t structure, no file is mapped
+ *
+ * @param self Pointer to aMap_t structure
+ */
+void aMap_reset(aMap_t * restrict self);
+/**
+ * @brief Maps whole file to memory for reading
+ *
+ * @param self Pointer to aMap_t structure, must not be in use
+ * @param fileName File name
+ * @return true Success
+ * @return false Failure, self is left reset
+ */
+bool aMap_open(aMap_t * restrict self, const wchar * restrict fileName);
+/**
+ * @brief Checks whether view is in use
+ *
+ * @param self Pointer to aMap_t structure
+ * @return true View is in use
+ * @return false Nothing is mapped
+ */
+bool aMap_active(const aMap_t * restrict self);
+/**
+ * @brief Unmaps file, every pointer to the view becomes invalid
+ *
+ * @param self Pointer to aMap_t structure
+ */
+void aMap_close(aMap_t * restrict self);
+
+#endif
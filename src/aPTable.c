@@ -0,0 +1,526 @@
+#include "aPTable.h"
+
+
+static usize aPTBuf_lowerBreak(const aPTBuf_t * restrict buf, usize pos)
+{
+	usize lo = 0, hi = buf->numBreaks;
+	while (lo < hi)
+	{
+		const usize mid = lo + (hi - lo) / 2;
+		if (buf->breaks[mid] < pos)
+		{
+			lo = mid + 1;
+		}
+		else
+		{
+			hi = mid;
+		}
+	}
+	return lo;
+}
+static usize aPTBuf_countBreaks(const aPTBuf_t * restrict buf, usize start, usize len)
+{
+	return aPTBuf_lowerBreak(buf, start + len) - aPTBuf_lowerBreak(buf, start);
+}
+static bool aPTBuf_addBreak(aPTBuf_t * restrict buf, usize pos)
+{
+	if (buf->numBreaks >= buf->capBreaks)
+	{
+		const usize newCap = (buf->capBreaks + 1) * 2;
+		vptr mem = realloc(buf->breaks, sizeof(usize) * newCap);
+		if (mem == NULL)
+		{
+			return false;
+		}
+		buf->breaks    = mem;
+		buf->capBreaks = newCap;
+	}
+	buf->breaks[buf->numBreaks] = pos;
+	++buf->numBreaks;
+	return true;
+}
+
+static const aPTBuf_t * aPTable_buf(const aPTable_t * restrict self, const aPiece_t * restrict piece)
+{
+	return piece->isAdd ? &self->add : &self->orig;
+}
+static usize aPTable_pieceBreaks(const aPTable_t * restrict self, const aPiece_t * restrict piece)
+{
+	return aPTBuf_countBreaks(aPTable_buf(self, piece), piece->start, piece->len);
+}
+static usize aPTable_findPiece(const aPTable_t * restrict self, usize pos, usize * restrict offset)
+{
+	usize i = 0;
+	for (; i < self->numPieces; ++i)
+	{
+		if (pos < self->pieces[i].len)
+		{
+			break;
+		}
+		pos -= self->pieces[i].len;
+	}
+	*offset = pos;
+	return i;
+}
+static bool aPTable_insertPiece(aPTable_t * restrict self, usize idx, aPiece_t piece)
+{
+	if (self->numPieces >= self->capPieces)
+	{
+		const usize newCap = (self->capPieces + 1) * 2;
+		vptr mem = realloc(self->pieces, sizeof(aPiece_t) * newCap);
+		if (mem == NULL)
+		{
+			return false;
+		}
+		self->pieces    = mem;
+		self->capPieces = newCap;
+	}
+	memmove(
+		self->pieces + idx + 1,
+		self->pieces + idx,
+		sizeof(aPiece_t) * (self->numPieces - idx)
+	);
+	self->pieces[idx] = piece;
+	++self->numPieces;
+	return true;
+}
+static void aPTable_removePiece(aPTable_t * restrict self, usize idx)
+{
+	--self->numPieces;
+	memmove(
+		self->pieces + idx,
+		self->pieces + idx + 1,
+		sizeof(aPiece_t) * (self->numPieces - idx)
+	);
+}
+
+bool aPTable_init(aPTable_t * restrict self, wchar * restrict orig, usize origLen)
+{
+	*self = (aPTable_t){
+		.orig = {
+			.mem = orig,
+			.len = (orig == NULL) ? 0 : origLen
+		},
+		.lastAdd = 0
+	};
+
+	// Index line breaks of the original text once
+	for (usize i = 0; i < self->orig.len; ++i)
+	{
+		if ((orig[i] == L'\n') && !aPTBuf_addBreak(&self->orig, i))
+		{
+			aPTable_destroy(self);
+			return false;
+		}
+	}
+
+	if (self->orig.len > 0)
+	{
+		const aPiece_t piece = {
+			.isAdd    = false,
+			.start    = 0,
+			.len      = self->orig.len,
+			.newlines = self->orig.numBreaks
+		};
+		if (!aPTable_insertPiece(self, 0, piece))
+		{
+			aPTable_destroy(self);
+			return false;
+		}
+	}
+	self->totalLen   = self->orig.len;
+	self->totalLines = self->orig.numBreaks + 1;
+	self->lastAdd    = self->numPieces;
+
+	return true;
+}
+
+bool aPTable_insert(aPTable_t * restrict self, usize pos, const wchar * restrict text, usize len)
+{
+	if (len == 0)
+	{
+		return true;
+	}
+	pos = (pos > self->totalLen) ? self->totalLen : pos;
+
+	// Append text to add buffer
+	if ((self->add.len + len) > self->addCap)
+	{
+		const usize newCap = (self->add.len + len) * 2;
+		vptr mem = realloc(self->add.mem, sizeof(wchar) * newCap);
+		if (mem == NULL)
+		{
+			return false;
+		}
+		self->add.mem = mem;
+		self->addCap  = newCap;
+	}
+	const usize addStart = self->add.len, oldBreaks = self->add.numBreaks;
+	memcpy(self->add.mem + addStart, text, sizeof(wchar) * len);
+	for (usize i = 0; i < len; ++i)
+	{
+		if ((text[i] == L'\n') && !aPTBuf_addBreak(&self->add, addStart + i))
+		{
+			self->add.numBreaks = oldBreaks;
+			return false;
+		}
+	}
+	self->add.len += len;
+	const usize newlines = self->add.numBreaks - oldBreaks;
+
+	usize offset;
+	usize idx = aPTable_findPiece(self, pos, &offset);
+
+	// Typing at the end of last inserted piece only extends it
+	if ((offset == 0) && (idx > 0) && ((idx - 1) == self->lastAdd))
+	{
+		aPiece_t * restrict prev = &self->pieces[idx - 1];
+		if (prev->isAdd && ((prev->start + prev->len) == addStart))
+		{
+			prev->len      += len;
+			prev->newlines += newlines;
+
+			self->totalLen   += len;
+			self->totalLines += newlines;
+			return true;
+		}
+	}
+
+	const aPiece_t piece = {
+		.isAdd    = true,
+		.start    = addStart,
+		.len      = len,
+		.newlines = newlines
+	};
+	if (offset > 0)
+	{
+		// Split piece in two, new piece goes in-between
+		aPiece_t tail = self->pieces[idx];
+		tail.start += offset;
+		tail.len   -= offset;
+		tail.newlines = aPTable_pieceBreaks(self, &tail);
+		if (!aPTable_insertPiece(self, idx + 1, tail))
+		{
+			return false;
+		}
+		self->pieces[idx].len      = offset;
+		self->pieces[idx].newlines -= tail.newlines;
+		++idx;
+	}
+	if (!aPTable_insertPiece(self, idx, piece))
+	{
+		return false;
+	}
+	self->lastAdd = idx;
+
+	self->totalLen   += len;
+	self->totalLines += newlines;
+	return true;
+}
+bool aPTable_erase(aPTable_t * restrict self, usize pos, usize len)
+{
+	if (pos >= self->totalLen)
+	{
+		return false;
+	}
+	len = ((self->totalLen - pos) < len) ? (self->totalLen - pos) : len;
+	if (len == 0)
+	{
+		return false;
+	}
+
+	usize offset;
+	usize idx = aPTable_findPiece(self, pos, &offset);
+	self->totalLen -= len;
+	self->lastAdd   = self->numPieces;
+
+	while (len > 0)
+	{
+		aPiece_t * restrict p = &self->pieces[idx];
+		const usize take = ((p->len - offset) < len) ? (p->len - offset) : len;
+		const usize oldNewlines = p->newlines;
+
+		if ((offset == 0) && (take == p->len))
+		{
+			self->totalLines -= oldNewlines;
+			aPTable_removePiece(self, idx);
+		}
+		else if (offset == 0)
+		{
+			p->start += take;
+			p->len   -= take;
+			p->newlines = aPTable_pieceBreaks(self, p);
+			self->totalLines -= oldNewlines - p->newlines;
+			++idx;
+		}
+		else if ((offset + take) == p->len)
+		{
+			p->len -= take;
+			p->newlines = aPTable_pieceBreaks(self, p);
+			self->totalLines -= oldNewlines - p->newlines;
+			++idx;
+		}
+		else
+		{
+			aPiece_t tail = *p;
+			tail.start += offset + take;
+			tail.len   -= offset + take;
+			tail.newlines = aPTable_pieceBreaks(self, &tail);
+			if (!aPTable_insertPiece(self, idx + 1, tail))
+			{
+				self->totalLen += len;
+				return false;
+			}
+			// Array might have been moved
+			p = &self->pieces[idx];
+			p->len = offset;
+			p->newlines = aPTable_pieceBreaks(self, p);
+			self->totalLines -= oldNewlines - p->newlines - tail.newlines;
+			idx += 2;
+		}
+
+		len   -= take;
+		offset = 0;
+	}
+
+	return true;
+}
+
+wchar aPTable_charAt(const aPTable_t * restrict self, usize pos)
+{
+	usize offset;
+	const usize idx = aPTable_findPiece(self, pos, &offset);
+	if (idx >= self->numPieces)
+	{
+		return L'\0';
+	}
+	const aPiece_t * restrict p = &self->pieces[idx];
+	return aPTable_buf(self, p)->mem[p->start + offset];
+}
+usize aPTable_lineStart(const aPTable_t * restrict self, usize line)
+{
+	if (line == 0)
+	{
+		return 0;
+	}
+	line = (line >= self->totalLines) ? (self->totalLines - 1) : line;
+
+	// Find the piece with (line)-th newline in it
+	usize pos = 0;
+	for (usize i = 0; i < self->numPieces; ++i)
+	{
+		const aPiece_t * restrict p = &self->pieces[i];
+		if (line <= p->newlines)
+		{
+			const aPTBuf_t * restrict buf = aPTable_buf(self, p);
+			const usize brk = buf->breaks[aPTBuf_lowerBreak(buf, p->start) + line - 1];
+			return pos + (brk - p->start) + 1;
+		}
+		line -= p->newlines;
+		pos  += p->len;
+	}
+	return self->totalLen;
+}
+usize aPTable_lineOf(const aPTable_t * restrict self, usize pos)
+{
+	usize line = 0;
+	for (usize i = 0; i < self->numPieces; ++i)
+	{
+		const aPiece_t * restrict p = &self->pieces[i];
+		if (pos < p->len)
+		{
+			return line + aPTBuf_countBreaks(aPTable_buf(self, p), p->start, pos);
+		}
+		line += p->newlines;
+		pos  -= p->len;
+	}
+	return line;
+}
+static usize aPTable_lenFrom(const aPTable_t * restrict self, usize start)
+{
+	// Length until L'\n' or document end, L'\n' not included
+	usize offset;
+	usize idx = aPTable_findPiece(self, start, &offset), len = 0;
+	for (; idx < self->numPieces; ++idx, offset = 0)
+	{
+		const aPiece_t * restrict p = &self->pieces[idx];
+		const aPTBuf_t * restrict buf = aPTable_buf(self, p);
+		const usize bi = aPTBuf_lowerBreak(buf, p->start + offset);
+		if ((bi < buf->numBreaks) && (buf->breaks[bi] < (p->start + p->len)))
+		{
+			return len + (buf->breaks[bi] - p->start - offset);
+		}
+		len += p->len - offset;
+	}
+	return len;
+}
+usize aPTable_lineLen(const aPTable_t * restrict self, usize line)
+{
+	const usize start = aPTable_lineStart(self, line), len = aPTable_lenFrom(self, start);
+	return ((len > 0) && (aPTable_charAt(self, start + len - 1) == L'\r')) ? (len - 1) : len;
+}
+static void aPTable_copy(const aPTable_t * restrict self, usize pos, usize len, wchar * restrict dest)
+{
+	usize offset;
+	usize idx = aPTable_findPiece(self, pos, &offset);
+	for (; len > 0 && idx < self->numPieces; ++idx, offset = 0)
+	{
+		const aPiece_t * restrict p = &self->pieces[idx];
+		const usize take = ((p->len - offset) < len) ? (p->len - offset) : len;
+		memcpy(dest, aPTable_buf(self, p)->mem + p->start + offset, sizeof(wchar) * take);
+		dest += take;
+		len  -= take;
+	}
+}
+bool aPTable_getLine(const aPTable_t * restrict self, usize line, wchar ** restrict text, usize * restrict tarrsz)
+{
+	const usize start = aPTable_lineStart(self, line);
+	usize len = aPTable_lenFrom(self, start);
+	const usize totalLen = len + 1;
+
+	if ((tarrsz != NULL) && (*tarrsz < totalLen))
+	{
+		wchar * mem = realloc(*text, sizeof(wchar) * totalLen);
+		if (mem == NULL)
+		{
+			return false;
+		}
+		*text   = mem;
+		*tarrsz = totalLen;
+	}
+	else if (tarrsz == NULL)
+	{
+		*text = malloc(sizeof(wchar) * totalLen);
+		if (*text == NULL)
+		{
+			return false;
+		}
+	}
+
+	aPTable_copy(self, start, len, *text);
+	if ((len > 0) && ((*text)[len - 1] == L'\r'))
+	{
+		--len;
+	}
+	(*text)[len] = L'\0';
+
+	return true;
+}
+wchar * aPTable_getText(const aPTable_t * restrict self)
+{
+	wchar * text = malloc(sizeof(wchar) * (self->totalLen + 1));
+	if (text == NULL)
+	{
+		return NULL;
+	}
+	aPTable_copy(self, 0, self->totalLen, text);
+	text[self->totalLen] = L'\0';
+	return text;
+}
+
+usize aPTable_curLine(const aPTable_t * restrict self)
+{
+	return aPTable_lineOf(self, self->cursor);
+}
+usize aPTable_curCol(const aPTable_t * restrict self)
+{
+	return self->cursor - aPTable_lineStart(self, aPTable_curLine(self));
+}
+void aPTable_setCursor(aPTable_t * restrict self, usize line, usize col)
+{
+	line = (line >= self->totalLines) ? (self->totalLines - 1) : line;
+	const usize len = aPTable_lineLen(self, line);
+	self->cursor = aPTable_lineStart(self, line) + ((col > len) ? len : col);
+}
+void aPTable_moveCursor(aPTable_t * restrict self, isize delta)
+{
+	// L"\r\n" pairs are stepped over as a single character
+	for (; delta < 0 && self->cursor > 0; ++delta)
+	{
+		--self->cursor;
+		if ((self->cursor > 0) && (aPTable_charAt(self, self->cursor) == L'\n') &&
+			(aPTable_charAt(self, self->cursor - 1) == L'\r'))
+		{
+			--self->cursor;
+		}
+	}
+	for (; delta > 0 && self->cursor < self->totalLen; --delta)
+	{
+		if ((aPTable_charAt(self, self->cursor) == L'\r') &&
+			(aPTable_charAt(self, self->cursor + 1) == L'\n'))
+		{
+			++self->cursor;
+		}
+		++self->cursor;
+	}
+}
+bool aPTable_addNormalCh(aPTable_t * restrict self, wchar ch)
+{
+	if (!aPTable_insert(self, self->cursor, &ch, 1))
+	{
+		return false;
+	}
+	++self->cursor;
+	return true;
+}
+bool aPTable_addNewLine(aPTable_t * restrict self)
+{
+	return aPTable_addNormalCh(self, L'\n');
+}
+static usize aPTable_eolLen(const aPTable_t * restrict self, usize pos)
+{
+	const wchar ch = aPTable_charAt(self, pos);
+	if ((ch == L'\r') && (aPTable_charAt(self, pos + 1) == L'\n'))
+	{
+		return 2;
+	}
+	return (ch == L'\n') ? 1 : 0;
+}
+bool aPTable_deleteForward(aPTable_t * restrict self)
+{
+	const usize eol = aPTable_eolLen(self, self->cursor);
+	return aPTable_erase(self, self->cursor, (eol > 0) ? eol : 1);
+}
+bool aPTable_deleteBackward(aPTable_t * restrict self)
+{
+	if (self->cursor == 0)
+	{
+		return false;
+	}
+	const usize oldCursor = self->cursor;
+	aPTable_moveCursor(self, -1);
+	return aPTable_erase(self, self->cursor, oldCursor - self->cursor);
+}
+bool aPTable_mergeNext(aPTable_t * restrict self, usize line)
+{
+	if ((line + 1) >= self->totalLines)
+	{
+		return false;
+	}
+	const usize next = aPTable_lineStart(self, line + 1);
+	const usize eol  = (next >= 2) && (aPTable_charAt(self, next - 2) == L'\r') ? 2 : 1;
+	const usize pos  = next - eol;
+	if (!aPTable_erase(self, pos, eol))
+	{
+		return false;
+	}
+	if (self->cursor >= next)
+	{
+		self->cursor -= eol;
+	}
+	else if (self->cursor > pos)
+	{
+		self->cursor = pos;
+	}
+	return true;
+}
+
+void aPTable_destroy(aPTable_t * restrict self)
+{
+	free(self->orig.mem);
+	free(self->orig.breaks);
+	free(self->add.mem);
+	free(self->add.breaks);
+	free(self->pieces);
+	*self = (aPTable_t){ .lastAdd = 0 };
+}
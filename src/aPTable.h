@@ -0,0 +1,225 @@
+#ifndef ATTO_PTABLE_H
+#define ATTO_PTABLE_H
+
+#include "aCommon.h"
+
+/*
+	Piece table document engine, alternative to the aLine_t linked list.
+
+	Original text is kept read-only, every inserted character goes to
+	the append-only "add" buffer. Document is described by an array of
+	pieces, each referring to a span in one of the two buffers:
+
+	orig: L"Hello world\n"      add: L"big "
+	pieces: { orig, 0, 6 } { add, 0, 4 } { orig, 6, 6 }
+	text:   L"Hello big world\n"
+
+	Lines are separated by L'\n', L"\r\n" pairs are kept verbatim inside
+	the buffers, a trailing L'\r' is stripped when fetching line contents.
+*/
+
+typedef struct aPTBuf
+{
+	wchar * mem;
+	usize len;
+
+	// Positions of all L'\n' characters in the buffer, ascending
+	usize * breaks;
+	usize numBreaks, capBreaks;
+
+} aPTBuf_t;
+
+typedef struct aPiece
+{
+	bool isAdd;
+	usize start, len, newlines;
+
+} aPiece_t;
+
+typedef struct aPTable
+{
+	aPTBuf_t orig, add;
+	usize addCap;
+
+	aPiece_t * pieces;
+	usize numPieces, capPieces;
+
+	usize totalLen, totalLines;
+	usize cursor;
+
+	// Piece, that can be extended by typing at its end, numPieces if none
+	usize lastAdd;
+
+} aPTable_t;
+
+/**
+ * @brief Initialises piece table, takes ownership of original text buffer.
+ * The buffer is never modified, it's only freed on aPTable_destroy
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param orig Pointer to heap-allocated UTF-16 character array, can be NULL
+ * @param origLen Number of characters in orig (not including null-terminator)
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_init(aPTable_t * restrict self, wchar * restrict orig, usize origLen);
+
+/**
+ * @brief Inserts text at an absolute character position
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param pos Absolute character position, clamped to the document length
+ * @param text Pointer to UTF-16 character array to insert
+ * @param len Number of characters to insert
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_insert(aPTable_t * restrict self, usize pos, const wchar * restrict text, usize len);
+/**
+ * @brief Erases characters starting at an absolute character position
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param pos Absolute character position
+ * @param len Number of characters to erase, clamped to the document end
+ * @return true Success
+ * @return false Nothing to erase
+ */
+bool aPTable_erase(aPTable_t * restrict self, usize pos, usize len);
+
+/**
+ * @brief Fetches character at an absolute position
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param pos Absolute character position
+ * @return wchar Character, L'\0' if out of bounds
+ */
+wchar aPTable_charAt(const aPTable_t * restrict self, usize pos);
+/**
+ * @brief Calculates absolute character position of the line's start
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param line Line index, starting from 0, clamped to the last line
+ * @return usize Absolute character position
+ */
+usize aPTable_lineStart(const aPTable_t * restrict self, usize line);
+/**
+ * @brief Calculates line index of an absolute character position
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param pos Absolute character position
+ * @return usize Line index, starting from 0
+ */
+usize aPTable_lineOf(const aPTable_t * restrict self, usize pos);
+/**
+ * @brief Calculates length of line without EOL characters
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param line Line index, starting from 0, clamped to the last line
+ * @return usize Number of characters
+ */
+usize aPTable_lineLen(const aPTable_t * restrict self, usize line);
+/**
+ * @brief Fetches line contents without EOL characters, copies it to wchar
+ * character array, allocates memory only if *text is too small or tarrsz == NULL
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param line Line index, starting from 0
+ * @param text Address of wchar pointer to character array, wchar pointer
+ * itself can be initially NULL
+ * @param tarrsz Size of receiving character array, can be NULL
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_getLine(const aPTable_t * restrict self, usize line, wchar ** restrict text, usize * restrict tarrsz);
+/**
+ * @brief Fetches whole document text, null-terminated, allocates memory
+ *
+ * @param self Pointer to aPTable_t structure
+ * @return wchar* Pointer to UTF-16 character array, NULL on failure
+ */
+wchar * aPTable_getText(const aPTable_t * restrict self);
+
+/**
+ * @brief Calculates line index of cursor
+ *
+ * @param self Pointer to aPTable_t structure
+ * @return usize Line index, starting from 0
+ */
+usize aPTable_curLine(const aPTable_t * restrict self);
+/**
+ * @brief Calculates column of cursor in its line
+ *
+ * @param self Pointer to aPTable_t structure
+ * @return usize Column, starting from 0
+ */
+usize aPTable_curCol(const aPTable_t * restrict self);
+/**
+ * @brief Puts cursor on a line, clamps line & column
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param line Line index, starting from 0
+ * @param col Column, starting from 0
+ */
+void aPTable_setCursor(aPTable_t * restrict self, usize line, usize col);
+/**
+ * @brief Moves cursor, clamps movement
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param delta Amount of characters to move, positive values to move right,
+ * negative values to move left
+ */
+void aPTable_moveCursor(aPTable_t * restrict self, isize delta);
+/**
+ * @brief Inserts a normal character at cursor, same as aFile_addNormalCh
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param ch Character to insert
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_addNormalCh(aPTable_t * restrict self, wchar ch);
+/**
+ * @brief Splits line at cursor, cursor moves to the beginning of the new line,
+ * same as aFile_addNewLine
+ *
+ * @param self Pointer to aPTable_t structure
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_addNewLine(aPTable_t * restrict self);
+/**
+ * @brief Deletes a character after cursor, merges with the next line if
+ * cursor is at the end of the line, same as aFile_deleteForward
+ *
+ * @param self Pointer to aPTable_t structure
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_deleteForward(aPTable_t * restrict self);
+/**
+ * @brief Deletes a character before cursor, merges with the previous line
+ * if cursor is at the beginning of the line, same as aFile_deleteBackward
+ *
+ * @param self Pointer to aPTable_t structure
+ * @return true Success
+ * @return false Failure
+ */
+bool aPTable_deleteBackward(aPTable_t * restrict self);
+/**
+ * @brief Merges given line with the next line, same as aLine_mergeNext
+ *
+ * @param self Pointer to aPTable_t structure
+ * @param line Line index, starting from 0
+ * @return true Success
+ * @return false Failure, given line is the last line
+ */
+bool aPTable_mergeNext(aPTable_t * restrict self, usize line);
+
+/**
+ * @brief Destroys piece table, frees memory
+ *
+ * @param self Pointer to aPTable_t structure
+ */
+void aPTable_destroy(aPTable_t * restrict self);
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _WIN32
+	#define _POSIX_C_SOURCE 199309L
+	#include <time.h>
+#endif
+
+#include "aProf.h"
+
+
+i64 aProf_now(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq = { .QuadPart = 0 };
+	if (freq.QuadPart == 0)
+	{
+		QueryPerformanceFrequency(&freq);
+	}
+	LARGE_INTEGER cnt;
+	QueryPerformanceCounter(&cnt);
+	return (i64)((f64)cnt.QuadPart * (1e9 / (f64)freq.QuadPart));
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (i64)ts.tv_sec * 1000000000LL + (i64)ts.tv_nsec;
+#endif
+}
+void aProf_start(aProf_t * restrict self)
+{
+	self->start = aProf_now();
+}
+f64 aProf_end(const aProf_t * restrict self, const char * restrict what, usize amount, const char * restrict unit)
+{
+	const f64 ms = (f64)(aProf_now() - self->start) / 1e6;
+
+	FILE * fp = fopen(ATTO_PROF_FILE, "a");
+	if (fp != NULL)
+	{
+		if ((amount > 0) && (ms > 0.0))
+		{
+			fprintf(fp, "%s: %.3f ms, %zu %s, %.1f %s/s\n", what, ms, amount, unit, (f64)amount / ms * 1000.0, unit);
+		}
+		else
+		{
+			fprintf(fp, "%s: %.3f ms\n", what, ms);
+		}
+		fclose(fp);
+	}
+	return ms;
+}
@@ -0,0 +1,50 @@
+#ifndef ATTO_PROF_H
+#define ATTO_PROF_H
+
+#include "aCommon.h"
+
+#ifndef PROFILING_ENABLE
+	#define PROFILING_ENABLE 0
+#endif
+
+#define ATTO_PROF_FILE "atto-profile.log"
+
+typedef struct aProf
+{
+	i64 start;
+
+} aProf_t;
+
+/**
+ * @brief Gets monotonic high-resolution timestamp
+ * 
+ * @return i64 Timestamp in nanoseconds
+ */
+i64 aProf_now(void);
+/**
+ * @brief Starts profiling timer
+ * 
+ * @param self Pointer to aProf_t structure
+ */
+void aProf_start(aProf_t * restrict self);
+/**
+ * @brief Stops profiling timer, appends measurement to ATTO_PROF_FILE
+ * 
+ * @param self Pointer to aProf_t structure
+ * @param what Name of the measured operation
+ * @param amount Amount of processed units, throughput is logged if non-zero
+ * @param unit Name of the processed unit, e.g. "bytes", "chars"
+ * @return f64 Elapsed time in milliseconds
+ */
+f64 aProf_end(const aProf_t * restrict self, const char * restrict what, usize amount, const char * restrict unit);
+
+// Measurements are only compiled into debug builds
+#if PROFILING_ENABLE == 1
+	#define aPROF_START(t) aProf_t t; aProf_start(&t)
+	#define aPROF_END(t, what, amount, unit) aProf_end(&t, what, amount, unit)
+#else
+	#define aPROF_START(t)
+	#define aPROF_END(t, what, amount, unit)
+#endif
+
+#endif
@@ -0,0 +1,1199 @@
+#include "aRegex.h"
+#include "aUtf.h"
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define ATTO_REGEX_SSE2 1
+#else
+	#define ATTO_REGEX_SSE2 0
+#endif
+
+// Hash slots of cached states, power of 2
+#define ATTO_REGEX_HASH (2 * ATTO_REGEX_STATES)
+// Largest number of non-ASCII characters in a class
+#define ATTO_REGEX_CLASS_MAX 256
+// Ends a group of threads in a state, threads of a group started at the same byte
+#define ATTO_REGEX_MARK ATTO_REGEX_MAX_INST
+
+typedef enum aRegexOp
+{
+	aroBYTE,
+	aroSPLIT,
+	aroJMP,
+	aroBOL,
+	aroEOL,
+	aroMATCH
+
+} aRegexOp_e;
+
+typedef enum aRegexNodeType
+{
+	arnEMPTY,
+	arnLIT,
+	arnCAT,
+	arnALT,
+	arnSTAR,
+	arnPLUS,
+	arnQUEST,
+	arnBOL,
+	arnEOL
+
+} aRegexNodeType_e;
+
+// State flags, the ones in arsKEY tell states apart
+enum
+{
+	arsBOL        = 0x01,
+	arsANCHORED   = 0x02,
+	arsMATCH      = 0x04,
+	arsMATCH_EOL  = 0x08,
+	arsACCEL_DONE = 0x10,
+	arsACCEL      = 0x20,
+	// Threads are kept in groups by start, earliest first
+	arsLONGEST    = 0x40,
+	arsKEY        = arsBOL | arsANCHORED | arsMATCH | arsLONGEST
+};
+// Flags of table entries, the rest is the target row
+#define ATTO_REGEX_E_MATCH ((u32)1 << 31)
+#define ATTO_REGEX_E_LINE  ((u32)1 << 30)
+#define ATTO_REGEX_E_DEAD  ((u32)1 << 29)
+// Transition to itself of an accelerated state
+#define ATTO_REGEX_E_ACCEL ((u32)1 << 28)
+#define ATTO_REGEX_E_FLAGS (ATTO_REGEX_E_MATCH | ATTO_REGEX_E_LINE | ATTO_REGEX_E_DEAD | ATTO_REGEX_E_ACCEL)
+
+typedef struct aRegexNode
+{
+	aRegexNodeType_e type;
+	u32 a, b;
+
+} aRegexNode_t;
+
+typedef struct aRegexParser
+{
+	aRegex_t * re;
+	const wchar * pat;
+	usize pos, len;
+	aRegexNode_t * nodes;
+	u32 numNodes, capNodes;
+	const wchar * err;
+
+} aRegexParser_t;
+
+
+static u32 aRegex_node(aRegexParser_t * restrict p, aRegexNodeType_e type, u32 a, u32 b)
+{
+	// Node 0 is an empty node, it's returned on errors
+	if (p->numNodes == p->capNodes)
+	{
+		p->err = L"Pattern is too complex";
+		return 0;
+	}
+	p->nodes[p->numNodes] = (aRegexNode_t){
+		.type = type,
+		.a    = a,
+		.b    = b
+	};
+	return p->numNodes++;
+}
+static u32 * aRegex_newSet(aRegexParser_t * restrict p, u32 * restrict node)
+{
+	if (p->re->numSets == ATTO_REGEX_MAX_INST)
+	{
+		p->err = L"Pattern is too complex";
+		*node = 0;
+		return NULL;
+	}
+	u32 * set = p->re->sets[p->re->numSets];
+	memset(set, 0, sizeof(u32) * 8);
+	*node = aRegex_node(p, arnLIT, p->re->numSets, 0);
+	++p->re->numSets;
+	return set;
+}
+static void aRegex_setRange(u32 * restrict set, u32 lo, u32 hi)
+{
+	for (u32 b = lo; b <= hi; ++b)
+	{
+		set[b >> 5] |= (u32)1 << (b & 31);
+	}
+}
+static u32 aRegex_cat(aRegexParser_t * restrict p, u32 a, u32 b)
+{
+	return (p->nodes[a].type == arnEMPTY) ? b : ((p->nodes[b].type == arnEMPTY) ? a : aRegex_node(p, arnCAT, a, b));
+}
+static u32 aRegex_range(aRegexParser_t * restrict p, u32 lo, u32 hi)
+{
+	u32 node;
+	u32 * set = aRegex_newSet(p, &node);
+	if (set != NULL)
+	{
+		aRegex_setRange(set, lo, hi);
+	}
+	return node;
+}
+static u32 aRegex_anyMulti(aRegexParser_t * restrict p)
+{
+	// Any multi-byte UTF-8 sequence
+	u32 two = aRegex_cat(p, aRegex_range(p, 0xC0, 0xDF), aRegex_range(p, 0x80, 0xBF));
+	u32 three = aRegex_range(p, 0xE0, 0xEF), four = aRegex_range(p, 0xF0, 0xF7);
+	for (u32 i = 0; i < 2; ++i)
+	{
+		three = aRegex_cat(p, three, aRegex_range(p, 0x80, 0xBF));
+	}
+	for (u32 i = 0; i < 3; ++i)
+	{
+		four = aRegex_cat(p, four, aRegex_range(p, 0x80, 0xBF));
+	}
+	return aRegex_node(p, arnALT, two, aRegex_node(p, arnALT, three, four));
+}
+static u32 aRegex_codePoint(aRegexParser_t * restrict p, u32 cp)
+{
+	wchar w[2];
+	usize wlen = 1;
+	if (cp >= 0x10000)
+	{
+		w[0] = (wchar)(0xD800 + ((cp - 0x10000) >> 10));
+		w[1] = (wchar)(0xDC00 + ((cp - 0x10000) & 0x3FF));
+		wlen = 2;
+	}
+	else
+	{
+		w[0] = (wchar)cp;
+	}
+	char bytes[2 * ATTO_UTF_MAX_U8];
+	const usize n = aUtf_toU8(w, wlen, bytes);
+	u32 node = 0;
+	for (usize i = 0; i < n; ++i)
+	{
+		node = aRegex_cat(p, node, aRegex_range(p, (u8)bytes[i], (u8)bytes[i]));
+	}
+	return node;
+}
+static u32 aRegex_next(aRegexParser_t * restrict p)
+{
+	// Next code point of pattern
+	u32 cp = (u32)p->pat[p->pos++];
+	if ((cp >= 0xD800) && (cp < 0xDC00) && (p->pos < p->len) && (p->pat[p->pos] >= 0xDC00) && (p->pat[p->pos] < 0xE000))
+	{
+		cp = 0x10000 + ((cp - 0xD800) << 10) + (u32)(p->pat[p->pos++] - 0xDC00);
+	}
+	return cp;
+}
+static bool aRegex_escapeSet(u32 ch, u32 * restrict set, bool * restrict negated)
+{
+	// ASCII sets of \d, \w & \s, upper case letters negate them
+	memset(set, 0, sizeof(u32) * 8);
+	*negated = (ch >= L'A') && (ch <= L'Z');
+	switch (*negated ? (ch - L'A' + L'a') : ch)
+	{
+	case L'd':
+		aRegex_setRange(set, '0', '9');
+		break;
+	case L'w':
+		aRegex_setRange(set, '0', '9');
+		aRegex_setRange(set, 'A', 'Z');
+		aRegex_setRange(set, 'a', 'z');
+		aRegex_setRange(set, '_', '_');
+		break;
+	case L's':
+		aRegex_setRange(set, ' ', ' ');
+		aRegex_setRange(set, '\t', '\t');
+		aRegex_setRange(set, '\v', '\f');
+		break;
+	default:
+		return false;
+	}
+	if (*negated)
+	{
+		for (u32 i = 0; i < 4; ++i)
+		{
+			set[i] = ~set[i];
+		}
+	}
+	return true;
+}
+static u32 aRegex_escapeChar(u32 ch)
+{
+	return (ch == L't') ? L'\t' : ch;
+}
+static u32 aRegex_class(aRegexParser_t * restrict p)
+{
+	// Opening bracket has been read
+	const bool negate = (p->pos < p->len) && (p->pat[p->pos] == L'^');
+	p->pos += negate ? 1 : 0;
+
+	u32 ascii[8] = { 0 }, cps[ATTO_REGEX_CLASS_MAX];
+	usize numCps = 0;
+	bool anyMulti = false, first = true;
+	while ((p->pos < p->len) && ((p->pat[p->pos] != L']') || first))
+	{
+		first = false;
+		u32 lo = aRegex_next(p);
+		if (lo == L'\\')
+		{
+			if (p->pos == p->len)
+			{
+				break;
+			}
+			lo = aRegex_next(p);
+			u32 set[8];
+			bool negated;
+			if (aRegex_escapeSet(lo, set, &negated))
+			{
+				for (u32 i = 0; i < 8; ++i)
+				{
+					ascii[i] |= set[i];
+				}
+				anyMulti = anyMulti || negated;
+				continue;
+			}
+			lo = aRegex_escapeChar(lo);
+		}
+		u32 hi = lo;
+		if (((p->pos + 1) < p->len) && (p->pat[p->pos] == L'-') && (p->pat[p->pos + 1] != L']'))
+		{
+			++p->pos;
+			hi = aRegex_next(p);
+			hi = ((hi == L'\\') && (p->pos < p->len)) ? aRegex_escapeChar(aRegex_next(p)) : hi;
+			if (hi < lo)
+			{
+				p->err = L"Invalid class range";
+				return 0;
+			}
+		}
+
+		if (lo < 0x80)
+		{
+			aRegex_setRange(ascii, lo, (hi < 0x80) ? hi : 0x7F);
+			lo = 0x80;
+		}
+		for (u32 cp = lo; cp <= hi; ++cp)
+		{
+			if (numCps == ATTO_REGEX_CLASS_MAX)
+			{
+				p->err = L"Class has too many non-ASCII characters";
+				return 0;
+			}
+			cps[numCps] = cp;
+			++numCps;
+		}
+	}
+	if (p->pos == p->len)
+	{
+		p->err = L"Unmatched '['";
+		return 0;
+	}
+	++p->pos;
+
+	if (negate)
+	{
+		if (numCps > 0)
+		{
+			p->err = L"Negated class can hold only ASCII characters";
+			return 0;
+		}
+		for (u32 i = 0; i < 4; ++i)
+		{
+			ascii[i] = ~ascii[i];
+		}
+		anyMulti = !anyMulti;
+	}
+	// Non-ASCII characters are matched as byte sequences
+	memset(ascii + 4, 0, sizeof(u32) * 4);
+
+	u32 node;
+	u32 * set = aRegex_newSet(p, &node);
+	if (set != NULL)
+	{
+		memcpy(set, ascii, sizeof(ascii));
+	}
+	for (usize i = 0; i < numCps; ++i)
+	{
+		node = aRegex_node(p, arnALT, node, aRegex_codePoint(p, cps[i]));
+	}
+	return anyMulti ? aRegex_node(p, arnALT, node, aRegex_anyMulti(p)) : node;
+}
+static u32 aRegex_alternate(aRegexParser_t * restrict p, u32 depth);
+static u32 aRegex_atom(aRegexParser_t * restrict p, u32 depth)
+{
+	const u32 ch = aRegex_next(p);
+	switch (ch)
+	{
+	case L'(':
+	{
+		const u32 node = aRegex_alternate(p, depth + 1);
+		if ((p->pos == p->len) || (p->pat[p->pos] != L')'))
+		{
+			p->err = (p->err != NULL) ? p->err : L"Unmatched '('";
+			return 0;
+		}
+		++p->pos;
+		return node;
+	}
+	case L'[':
+		return aRegex_class(p);
+	case L'.':
+		return aRegex_node(p, arnALT, aRegex_range(p, 0x00, 0x7F), aRegex_anyMulti(p));
+	case L'^':
+		return aRegex_node(p, arnBOL, 0, 0);
+	case L'$':
+		return aRegex_node(p, arnEOL, 0, 0);
+	case L'*':
+	case L'+':
+	case L'?':
+		p->err = L"Nothing to repeat";
+		return 0;
+	case L'\\':
+	{
+		if (p->pos == p->len)
+		{
+			p->err = L"Trailing backslash";
+			return 0;
+		}
+		const u32 esc = aRegex_next(p);
+		u32 ascii[8];
+		bool negated;
+		if (aRegex_escapeSet(esc, ascii, &negated))
+		{
+			u32 node;
+			u32 * set = aRegex_newSet(p, &node);
+			if (set != NULL)
+			{
+				memcpy(set, ascii, sizeof(u32) * 4);
+			}
+			return negated ? aRegex_node(p, arnALT, node, aRegex_anyMulti(p)) : node;
+		}
+		return aRegex_codePoint(p, aRegex_escapeChar(esc));
+	}
+	default:
+		return aRegex_codePoint(p, ch);
+	}
+}
+static u32 aRegex_repeat(aRegexParser_t * restrict p, u32 depth)
+{
+	u32 node = aRegex_atom(p, depth);
+	while ((p->err == NULL) && (p->pos < p->len))
+	{
+		const wchar ch = p->pat[p->pos];
+		if ((ch != L'*') && (ch != L'+') && (ch != L'?'))
+		{
+			break;
+		}
+		++p->pos;
+		node = aRegex_node(p, (ch == L'*') ? arnSTAR : ((ch == L'+') ? arnPLUS : arnQUEST), node, 0);
+	}
+	return node;
+}
+static u32 aRegex_concat(aRegexParser_t * restrict p, u32 depth)
+{
+	u32 node = 0;
+	while ((p->err == NULL) && (p->pos < p->len) && (p->pat[p->pos] != L'|') && (p->pat[p->pos] != L')'))
+	{
+		node = aRegex_cat(p, node, aRegex_repeat(p, depth));
+	}
+	return node;
+}
+static u32 aRegex_alternate(aRegexParser_t * restrict p, u32 depth)
+{
+	if (depth > 64)
+	{
+		p->err = L"Groups are nested too deep";
+		return 0;
+	}
+	u32 node = aRegex_concat(p, depth);
+	while ((p->err == NULL) && (p->pos < p->len) && (p->pat[p->pos] == L'|'))
+	{
+		++p->pos;
+		node = aRegex_node(p, arnALT, node, aRegex_concat(p, depth));
+	}
+	return node;
+}
+
+static u32 aRegex_inst(aRegex_t * restrict self, aRegexOp_e op, u32 x, u32 y)
+{
+	// Overflow is checked after emitting
+	if (self->progLen < ATTO_REGEX_MAX_INST)
+	{
+		self->prog[self->progLen] = (aRegexInst_t){
+			.op = (u8)op,
+			.x  = x,
+			.y  = y
+		};
+	}
+	return self->progLen++;
+}
+static void aRegex_patch(aRegex_t * restrict self, u32 pc, u32 x, u32 y)
+{
+	if (pc < ATTO_REGEX_MAX_INST)
+	{
+		self->prog[pc].x = x;
+		self->prog[pc].y = y;
+	}
+}
+static void aRegex_emit(aRegex_t * restrict self, const aRegexNode_t * restrict nodes, u32 n, bool reverse)
+{
+	// Reversed program matches the reversed text, concatenations & anchors are swapped
+	const aRegexNode_t * node = &nodes[n];
+	switch (node->type)
+	{
+	case arnEMPTY:
+		break;
+	case arnLIT:
+		aRegex_inst(self, aroBYTE, node->a, 0);
+		break;
+	case arnCAT:
+		aRegex_emit(self, nodes, reverse ? node->b : node->a, reverse);
+		aRegex_emit(self, nodes, reverse ? node->a : node->b, reverse);
+		break;
+	case arnALT:
+	{
+		const u32 split = aRegex_inst(self, aroSPLIT, 0, 0);
+		aRegex_emit(self, nodes, node->a, reverse);
+		const u32 jmp = aRegex_inst(self, aroJMP, 0, 0);
+		aRegex_patch(self, split, split + 1, self->progLen);
+		aRegex_emit(self, nodes, node->b, reverse);
+		aRegex_patch(self, jmp, self->progLen, 0);
+		break;
+	}
+	case arnSTAR:
+	{
+		const u32 split = aRegex_inst(self, aroSPLIT, 0, 0);
+		aRegex_emit(self, nodes, node->a, reverse);
+		aRegex_inst(self, aroJMP, split, 0);
+		aRegex_patch(self, split, split + 1, self->progLen);
+		break;
+	}
+	case arnPLUS:
+	{
+		const u32 start = self->progLen;
+		aRegex_emit(self, nodes, node->a, reverse);
+		aRegex_inst(self, aroSPLIT, start, self->progLen + 1);
+		break;
+	}
+	case arnQUEST:
+	{
+		const u32 split = aRegex_inst(self, aroSPLIT, 0, 0);
+		aRegex_emit(self, nodes, node->a, reverse);
+		aRegex_patch(self, split, split + 1, self->progLen);
+		break;
+	}
+	case arnBOL:
+		aRegex_inst(self, reverse ? aroEOL : aroBOL, 0, 0);
+		break;
+	case arnEOL:
+		aRegex_inst(self, reverse ? aroBOL : aroEOL, 0, 0);
+		break;
+	}
+}
+static void aRegex_makeClasses(aRegex_t * restrict self)
+{
+	// Class boundaries are where any set changes, line break bytes get classes of their own
+	bool boundary[256] = { false };
+	boundary[0] = true;
+	boundary['\n'] = boundary['\n' + 1] = true;
+	boundary['\r'] = boundary['\r' + 1] = true;
+	for (u32 s = 0; s < self->numSets; ++s)
+	{
+		const u32 * set = self->sets[s];
+		for (u32 b = 1; b < 256; ++b)
+		{
+			const bool cur = (set[b >> 5] >> (b & 31)) & 1, prev = (set[(b - 1) >> 5] >> ((b - 1) & 31)) & 1;
+			boundary[b] = boundary[b] || (cur != prev);
+		}
+	}
+	u32 cls = 0;
+	for (u32 b = 0; b < 256; ++b)
+	{
+		cls += (boundary[b] && (b > 0)) ? 1 : 0;
+		self->classes[b]  = (u8)cls;
+		self->classRep[cls] = (u8)b;
+	}
+	self->numClasses = cls + 1;
+}
+
+static void aRegex_follow(aRegex_t * restrict self, u32 pc, bool bol, bool eol, u8 * restrict flags, u32 * restrict list, u32 * restrict n)
+{
+	// Follows empty transitions, adds instructions waiting for input to list
+	u32 top = 0;
+	self->stack[top++] = pc;
+	while (top > 0)
+	{
+		pc = self->stack[--top];
+		if (self->mark[pc] == self->markGen)
+		{
+			continue;
+		}
+		self->mark[pc] = self->markGen;
+
+		const aRegexInst_t * inst = &self->prog[pc];
+		switch ((aRegexOp_e)inst->op)
+		{
+		case aroBYTE:
+			list[(*n)++] = pc;
+			break;
+		case aroSPLIT:
+			self->stack[top++] = inst->y;
+			self->stack[top++] = inst->x;
+			break;
+		case aroJMP:
+			self->stack[top++] = inst->x;
+			break;
+		case aroBOL:
+			if (bol)
+			{
+				self->stack[top++] = pc + 1;
+			}
+			break;
+		case aroEOL:
+			if (eol)
+			{
+				self->stack[top++] = pc + 1;
+			}
+			else
+			{
+				list[(*n)++] = pc;
+			}
+			break;
+		case aroMATCH:
+			*flags |= arsMATCH;
+			break;
+		}
+	}
+}
+static void aRegex_nextMark(aRegex_t * restrict self)
+{
+	++self->markGen;
+	if (self->markGen == 0)
+	{
+		memset(self->mark, 0, sizeof(u32) * (ATTO_REGEX_MAX_INST + 1));
+		self->markGen = 1;
+	}
+}
+static void aRegex_sort(u32 * restrict list, u32 n)
+{
+	for (u32 i = 1; i < n; ++i)
+	{
+		const u32 v = list[i];
+		u32 j = i;
+		for (; (j > 0) && (list[j - 1] > v); --j)
+		{
+			list[j] = list[j - 1];
+		}
+		list[j] = v;
+	}
+}
+static void aRegex_flush(aRegex_t * restrict self)
+{
+	// State 0 is never used, 0 in the table means 'not built'
+	self->numStates = 1;
+	self->poolLen   = 0;
+	memset(self->hash, 0, sizeof(u32) * ATTO_REGEX_HASH);
+	memset(self->starts, 0, sizeof(self->starts));
+	self->flushed = true;
+	++self->flushes;
+}
+static u32 aRegex_addState(aRegex_t * restrict self, u32 n, u8 flags)
+{
+	// Returns row of state with instruction set in self->list
+	u32 h = 2166136261u ^ flags;
+	for (u32 i = 0; i < n; ++i)
+	{
+		h = (h ^ self->list[i]) * 16777619u;
+	}
+	u32 slot = h & (ATTO_REGEX_HASH - 1);
+	for (; self->hash[slot] != 0; slot = (slot + 1) & (ATTO_REGEX_HASH - 1))
+	{
+		const aRegexState_t * st = &self->states[self->hash[slot]];
+		if (((st->flags & arsKEY) == flags) && (st->len == n) && (memcmp(self->pool + st->set, self->list, sizeof(u32) * n) == 0))
+		{
+			return self->hash[slot] * self->numClasses;
+		}
+	}
+	if ((self->numStates == ATTO_REGEX_STATES) || ((self->poolLen + n) > ATTO_REGEX_POOL))
+	{
+		aRegex_flush(self);
+		slot = h & (ATTO_REGEX_HASH - 1);
+	}
+
+	// Match at a line end is known in advance
+	u8 eolFlags = flags;
+	u32 eolLen = 0;
+	aRegex_nextMark(self);
+	for (u32 i = 0; (i < n) && !(eolFlags & arsMATCH); ++i)
+	{
+		if ((self->list[i] != ATTO_REGEX_MARK) && (self->prog[self->list[i]].op == aroEOL))
+		{
+			aRegex_follow(self, self->list[i] + 1, (flags & arsBOL) != 0, true, &eolFlags, self->eolList, &eolLen);
+		}
+	}
+
+	const u32 idx = self->numStates++;
+	memcpy(self->pool + self->poolLen, self->list, sizeof(u32) * n);
+	self->states[idx] = (aRegexState_t){
+		.set      = (u32)self->poolLen,
+		.len      = n,
+		.flags    = (u8)(flags | ((eolFlags & arsMATCH) ? arsMATCH_EOL : 0)),
+		.accelLen = 0,
+		.accel    = { 0 }
+	};
+	self->poolLen += n;
+	self->hash[slot] = idx;
+	memset(self->table + (usize)idx * self->numClasses, 0, sizeof(u32) * self->numClasses);
+	return idx * self->numClasses;
+}
+static u32 aRegex_group(aRegex_t * restrict self, u32 first, u32 n)
+{
+	// Ends group of threads started at list[first], empty groups are left out
+	if (n == first)
+	{
+		return n;
+	}
+	aRegex_sort(self->list + first, n - first);
+	self->list[n] = ATTO_REGEX_MARK;
+	return n + 1;
+}
+static u32 aRegex_start(aRegex_t * restrict self, bool bol, u8 mode)
+{
+	// Mode is 0 for unanchored search, arsANCHORED or arsLONGEST
+	const usize idx = (bol ? 1U : 0U) + ((mode & arsANCHORED) ? 2U : 0U) + ((mode & arsLONGEST) ? 4U : 0U);
+	if (self->starts[idx] == 0)
+	{
+		u8 flags = (u8)((bol ? arsBOL : 0) | mode);
+		u32 n = 0;
+		aRegex_nextMark(self);
+		aRegex_follow(self, 0, bol, false, &flags, self->list, &n);
+		if (flags & arsLONGEST)
+		{
+			n = aRegex_group(self, 0, n);
+			flags |= (flags & arsMATCH) ? arsANCHORED : 0;
+		}
+		else
+		{
+			aRegex_sort(self->list, n);
+		}
+		const u32 row = aRegex_addState(self, n, flags);
+		self->starts[idx] = row;
+	}
+	return self->starts[idx];
+}
+static u32 aRegex_stepSet(aRegex_t * restrict self, const aRegexState_t * restrict st, u8 b, u8 * restrict flags)
+{
+	// Instruction set after byte b goes to self->list, returns its size
+	*flags = st->flags & (arsANCHORED | arsLONGEST);
+	u32 n = 0, first = 0;
+	aRegex_nextMark(self);
+	for (u32 i = 0; i < st->len; ++i)
+	{
+		const u32 pc = self->pool[st->set + i];
+		if (pc == ATTO_REGEX_MARK)
+		{
+			// Groups after a match started later & are dropped, instructions are
+			// added once, so earlier groups take them from later ones
+			n = first = aRegex_group(self, first, n);
+			if (*flags & arsMATCH)
+			{
+				break;
+			}
+			continue;
+		}
+		const aRegexInst_t * inst = &self->prog[pc];
+		if ((inst->op == aroBYTE) && ((self->sets[inst->x][b >> 5] >> (b & 31)) & 1))
+		{
+			aRegex_follow(self, pc + 1, false, false, flags, self->list, &n);
+		}
+	}
+	if (!(*flags & arsLONGEST))
+	{
+		// Unanchored search starts a match at every position
+		if (!(*flags & arsANCHORED))
+		{
+			aRegex_follow(self, 0, false, false, flags, self->list, &n);
+		}
+		aRegex_sort(self->list, n);
+		return n;
+	}
+
+	// Longest search starts no more matches after one has been found
+	if (!(*flags & (arsANCHORED | arsMATCH)))
+	{
+		aRegex_follow(self, 0, false, false, flags, self->list, &n);
+		n = aRegex_group(self, first, n);
+	}
+	*flags |= (*flags & arsMATCH) ? arsANCHORED : 0;
+	return n;
+}
+static void aRegex_accel(aRegex_t * restrict self, aRegexState_t * restrict st)
+{
+	// State is accelerated, if only a few bytes (besides line breaks) leave it,
+	// input is then skipped to the next such byte
+	st->flags |= arsACCEL_DONE;
+	bool leaves[256];
+	u32 numBytes = 0;
+	for (u32 c = 0; c < self->numClasses; ++c)
+	{
+		const u8 b = self->classRep[c];
+		u8 flags;
+		const u32 n = ((b == '\n') || (b == '\r')) ? 0 : aRegex_stepSet(self, st, b, &flags);
+		leaves[c] = (b == '\n') || (b == '\r') || (flags != (st->flags & arsKEY)) || (n != st->len) ||
+			(memcmp(self->list, self->pool + st->set, sizeof(u32) * n) != 0);
+	}
+	for (u32 b = 0; b < 256; ++b)
+	{
+		if (leaves[self->classes[b]] && (b != '\n') && (b != '\r'))
+		{
+			if (numBytes == ATTO_REGEX_ACCEL)
+			{
+				return;
+			}
+			st->accel[numBytes] = (u8)b;
+			++numBytes;
+		}
+	}
+	st->accelLen = (u8)numBytes;
+	st->flags |= arsACCEL;
+}
+static usize aRegex_skip(const aRegexState_t * restrict st, const char * restrict text, usize len, usize i)
+{
+	// Finds next line break or byte leaving the state
+	const u8 a0 = (st->accelLen > 0) ? st->accel[0] : '\n';
+	const u8 a1 = (st->accelLen > 1) ? st->accel[1] : a0;
+	const u8 a2 = (st->accelLen > 2) ? st->accel[2] : a0;
+#if (ATTO_REGEX_SSE2 == 1) && defined(__GNUC__)
+	const __m128i vlf = _mm_set1_epi8('\n'), vcr = _mm_set1_epi8('\r');
+	const __m128i v0 = _mm_set1_epi8((char)a0), v1 = _mm_set1_epi8((char)a1), v2 = _mm_set1_epi8((char)a2);
+	for (; (i + 16) <= len; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(text + i));
+		const __m128i hit = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(v, vlf), _mm_cmpeq_epi8(v, vcr)),
+			_mm_or_si128(_mm_cmpeq_epi8(v, v0), _mm_or_si128(_mm_cmpeq_epi8(v, v1), _mm_cmpeq_epi8(v, v2)))
+		);
+		const u32 mask = (u32)_mm_movemask_epi8(hit);
+		if (mask != 0)
+		{
+			return i + (usize)__builtin_ctz(mask);
+		}
+	}
+#endif
+	for (; i < len; ++i)
+	{
+		const u8 b = (u8)text[i];
+		if ((b == '\n') || (b == '\r') || (b == a0) || (b == a1) || (b == a2))
+		{
+			break;
+		}
+	}
+	return i;
+}
+static u32 aRegex_step(aRegex_t * restrict self, u32 row, u32 cls)
+{
+	// Builds transition of a state, returns table entry
+	if ((self->classRep[cls] == '\n') || (self->classRep[cls] == '\r'))
+	{
+		self->table[row + cls] = ATTO_REGEX_E_LINE;
+		return ATTO_REGEX_E_LINE;
+	}
+
+	u8 flags;
+	const u32 n = aRegex_stepSet(self, &self->states[row / self->numClasses], self->classRep[cls], &flags);
+	self->flushed = false;
+	const u32 target = aRegex_addState(self, n, flags);
+	// Source row is gone after a flush
+	if (self->flushed)
+	{
+		return target | ((flags & arsMATCH) ? ATTO_REGEX_E_MATCH : 0);
+	}
+
+	u32 entry = target |
+		((flags & arsMATCH) ? ATTO_REGEX_E_MATCH : 0) |
+		(((n == 0) && !(flags & arsMATCH)) ? ATTO_REGEX_E_DEAD : 0);
+	if ((entry == row) && !(flags & arsANCHORED))
+	{
+		aRegexState_t * st = &self->states[row / self->numClasses];
+		if (!(st->flags & arsACCEL_DONE))
+		{
+			aRegex_accel(self, st);
+		}
+		entry |= (st->flags & arsACCEL) ? ATTO_REGEX_E_ACCEL : 0;
+	}
+	self->table[row + cls] = entry;
+	return entry;
+}
+
+static bool aRegex_build(aRegex_t * restrict self)
+{
+	// Line breaks are never matched
+	for (u32 i = 0; i < self->numSets; ++i)
+	{
+		self->sets[i]['\n' >> 5] &= ~((u32)1 << ('\n' & 31));
+		self->sets[i]['\r' >> 5] &= ~((u32)1 << ('\r' & 31));
+	}
+	aRegex_makeClasses(self);
+
+	// Groups of longest search add a mark per instruction at most
+	self->table   = malloc(sizeof(u32) * ATTO_REGEX_STATES * self->numClasses);
+	self->states  = malloc(sizeof(aRegexState_t) * ATTO_REGEX_STATES);
+	self->pool    = malloc(sizeof(u32) * ATTO_REGEX_POOL);
+	self->hash    = malloc(sizeof(u32) * ATTO_REGEX_HASH);
+	self->list    = malloc(sizeof(u32) * (2 * ATTO_REGEX_MAX_INST + 2));
+	self->eolList = malloc(sizeof(u32) * (ATTO_REGEX_MAX_INST + 1));
+	self->stack   = malloc(sizeof(u32) * (2 * ATTO_REGEX_MAX_INST + 2));
+	self->mark    = calloc(ATTO_REGEX_MAX_INST + 1, sizeof(u32));
+	if ((self->table == NULL) || (self->states == NULL) || (self->pool == NULL) || (self->hash == NULL) ||
+		(self->list == NULL) || (self->eolList == NULL) || (self->stack == NULL) || (self->mark == NULL))
+	{
+		return false;
+	}
+	aRegex_flush(self);
+	self->flushes = 0;
+	return true;
+}
+static bool aRegex_reverse(aRegex_t * restrict self, const aRegexNode_t * restrict nodes, u32 root)
+{
+	// Reversed program runs back from a match end to find its start
+	self->rev = malloc(sizeof(aRegex_t));
+	if (self->rev == NULL)
+	{
+		return false;
+	}
+	aRegex_t * restrict rev = self->rev;
+	aRegex_init(rev);
+	rev->sets = malloc(sizeof(u32) * 8 * ATTO_REGEX_MAX_INST);
+	rev->prog = malloc(sizeof(aRegexInst_t) * ATTO_REGEX_MAX_INST);
+	if ((rev->sets == NULL) || (rev->prog == NULL))
+	{
+		return false;
+	}
+	memcpy(rev->sets, self->sets, sizeof(u32) * 8 * self->numSets);
+	rev->numSets = self->numSets;
+	aRegex_emit(rev, nodes, root, true);
+	aRegex_inst(rev, aroMATCH, 0, 0);
+	return aRegex_build(rev);
+}
+
+void aRegex_init(aRegex_t * restrict self)
+{
+	*self = (aRegex_t){
+		.prog       = NULL,
+		.progLen    = 0,
+		.sets       = NULL,
+		.numSets    = 0,
+		.numClasses = 0,
+		.table      = NULL,
+		.states     = NULL,
+		.numStates  = 0,
+		.pool       = NULL,
+		.poolLen    = 0,
+		.hash       = NULL,
+		.starts     = { 0 },
+		.flushed    = false,
+		.flushes    = 0,
+		.rev        = NULL,
+		.list       = NULL,
+		.eolList    = NULL,
+		.stack      = NULL,
+		.mark       = NULL,
+		.markGen    = 0,
+		.line       = NULL,
+		.lineLen    = 0,
+		.lineCol    = 0,
+		.lineByte   = 0,
+		.scratch    = NULL,
+		.scratchCap = 0
+	};
+}
+const wchar * aRegex_compile(aRegex_t * restrict self, const wchar * restrict pattern, usize len)
+{
+	aRegex_destroy(self);
+	if (len == 0)
+	{
+		return NULL;
+	}
+
+	// Nodes per pattern character are bounded, '.' & \W take the most
+	aRegexParser_t p = {
+		.re       = self,
+		.pat      = pattern,
+		.pos      = 0,
+		.len      = len,
+		.nodes    = malloc(sizeof(aRegexNode_t) * (32 * len + 16)),
+		.numNodes = 1,
+		.capNodes = (u32)(32 * len + 16),
+		.err      = NULL
+	};
+	self->sets = malloc(sizeof(u32) * 8 * ATTO_REGEX_MAX_INST);
+	self->prog = malloc(sizeof(aRegexInst_t) * ATTO_REGEX_MAX_INST);
+	if ((p.nodes == NULL) || (self->sets == NULL) || (self->prog == NULL))
+	{
+		free(p.nodes);
+		aRegex_destroy(self);
+		return L"Out of memory";
+	}
+	p.nodes[0] = (aRegexNode_t){
+		.type = arnEMPTY,
+		.a    = 0,
+		.b    = 0
+	};
+
+	const u32 root = aRegex_alternate(&p, 0);
+	if ((p.err == NULL) && (p.pos < p.len))
+	{
+		p.err = L"Unmatched ')'";
+	}
+	if (p.err == NULL)
+	{
+		aRegex_emit(self, p.nodes, root, false);
+		aRegex_inst(self, aroMATCH, 0, 0);
+		p.err = (self->progLen > ATTO_REGEX_MAX_INST) ? L"Pattern is too complex" : NULL;
+	}
+	if ((p.err == NULL) && (!aRegex_build(self) || !aRegex_reverse(self, p.nodes, root)))
+	{
+		p.err = L"Out of memory";
+	}
+	free(p.nodes);
+	if (p.err != NULL)
+	{
+		aRegex_destroy(self);
+		return p.err;
+	}
+	return NULL;
+}
+bool aRegex_empty(const aRegex_t * restrict self)
+{
+	return self->progLen == 0;
+}
+usize aRegex_scan(aRegex_t * restrict self, const char * restrict text, usize len)
+{
+	if (aRegex_empty(self))
+	{
+		return len;
+	}
+	usize lineStart = 0;
+	u32 s = aRegex_start(self, true, 0);
+	if (self->states[s / self->numClasses].flags & arsMATCH)
+	{
+		return lineStart;
+	}
+	for (usize i = 0; i < len; ++i)
+	{
+		const u32 cls = self->classes[(u8)text[i]];
+		u32 e = self->table[s + cls];
+		// Most bytes go to a built state without flags
+		if ((e != 0) && (e < ATTO_REGEX_E_ACCEL))
+		{
+			s = e;
+			continue;
+		}
+		e = (e == 0) ? aRegex_step(self, s, cls) : e;
+
+		if (e & ATTO_REGEX_E_LINE)
+		{
+			if (self->states[s / self->numClasses].flags & arsMATCH_EOL)
+			{
+				return lineStart;
+			}
+			i += ((text[i] == '\r') && ((i + 1) < len) && (text[i + 1] == '\n')) ? 1 : 0;
+			lineStart = i + 1;
+			s = aRegex_start(self, true, 0);
+			if (self->states[s / self->numClasses].flags & arsMATCH)
+			{
+				return lineStart;
+			}
+		}
+		else if (e & ATTO_REGEX_E_MATCH)
+		{
+			return lineStart;
+		}
+		else if (e & ATTO_REGEX_E_ACCEL)
+		{
+			s = e & ~ATTO_REGEX_E_FLAGS;
+			i = aRegex_skip(&self->states[s / self->numClasses], text, len, i + 1) - 1;
+		}
+		else if (e & ATTO_REGEX_E_DEAD)
+		{
+			// Nothing can match until the next line
+			i += aUtf_findEol(text + i, len - i);
+			if (i == len)
+			{
+				return len;
+			}
+			--i;
+			s = e & ~ATTO_REGEX_E_FLAGS;
+		}
+		else
+		{
+			s = e;
+		}
+	}
+	return (self->states[s / self->numClasses].flags & arsMATCH_EOL) ? lineStart : len;
+}
+bool aRegex_matchLine(aRegex_t * restrict self, const char * restrict line, usize len, usize from, usize * restrict start, usize * restrict end)
+{
+	if (aRegex_empty(self) || (from > len))
+	{
+		return false;
+	}
+	// Longest search finds the end of the leftmost match in one pass, runs
+	// until the threads that could still make it longer die
+	u32 s = aRegex_start(self, from == 0, arsLONGEST);
+	bool found = (self->states[s / self->numClasses].flags & arsMATCH) != 0, dead = false;
+	usize matchEnd = from, i = from;
+	for (; i < len; ++i)
+	{
+		const u32 cls = self->classes[(u8)line[i]];
+		u32 e = self->table[s + cls];
+		e = (e == 0) ? aRegex_step(self, s, cls) : e;
+		if (e & ATTO_REGEX_E_LINE)
+		{
+			break;
+		}
+		s = e & ~ATTO_REGEX_E_FLAGS;
+		if (e & ATTO_REGEX_E_MATCH)
+		{
+			found = true;
+			matchEnd = i + 1;
+		}
+		else if (e & ATTO_REGEX_E_ACCEL)
+		{
+			i = aRegex_skip(&self->states[s / self->numClasses], line, len, i + 1) - 1;
+		}
+		else if (e & ATTO_REGEX_E_DEAD)
+		{
+			dead = true;
+			break;
+		}
+	}
+	if (!dead && (self->states[s / self->numClasses].flags & arsMATCH_EOL))
+	{
+		found = true;
+		matchEnd = i;
+	}
+	if (!found)
+	{
+		return false;
+	}
+
+	// Reversed expression runs back from the end, the longest match it finds
+	// starts leftmost
+	aRegex_t * restrict rev = self->rev;
+	s = aRegex_start(rev, matchEnd == len, arsANCHORED);
+	found = (rev->states[s / rev->numClasses].flags & arsMATCH) != 0;
+	dead = false;
+	usize matchStart = matchEnd;
+	for (i = matchEnd; i > from; --i)
+	{
+		const u32 cls = rev->classes[(u8)line[i - 1]];
+		u32 e = rev->table[s + cls];
+		e = (e == 0) ? aRegex_step(rev, s, cls) : e;
+		if (e & ATTO_REGEX_E_LINE)
+		{
+			dead = true;
+			break;
+		}
+		s = e & ~ATTO_REGEX_E_FLAGS;
+		// Matches start at code points
+		if ((e & ATTO_REGEX_E_MATCH) && (((u8)line[i - 1] & 0xC0) != 0x80))
+		{
+			found = true;
+			matchStart = i - 1;
+		}
+		if (e & ATTO_REGEX_E_DEAD)
+		{
+			dead = true;
+			break;
+		}
+	}
+	if (!dead && (i == 0) && (rev->states[s / rev->numClasses].flags & arsMATCH_EOL))
+	{
+		found = true;
+		matchStart = 0;
+	}
+	*start = matchStart;
+	*end   = matchEnd;
+	return found;
+}
+bool aRegex_setLine(aRegex_t * restrict self, const char * restrict line, usize len)
+{
+	// Lines without a match are rejected by the faster scan
+	self->line     = NULL;
+	self->lineLen  = 0;
+	self->lineCol  = 0;
+	self->lineByte = 0;
+	if (aRegex_empty(self) || ((len > 0) && (aRegex_scan(self, line, len) == len)))
+	{
+		return false;
+	}
+	self->line    = line;
+	self->lineLen = len;
+	return true;
+}
+bool aRegex_setLineW(
+	aRegex_t * restrict self,
+	const wchar * restrict head, usize headLen,
+	const wchar * restrict tail, usize tailLen
+)
+{
+	const usize headBytes = aUtf_u8Len(head, headLen), bytes = headBytes + aUtf_u8Len(tail, tailLen);
+	if (self->scratchCap < (bytes + 1))
+	{
+		vptr mem = realloc(self->scratch, bytes + 1);
+		if (mem == NULL)
+		{
+			self->line = NULL;
+			return false;
+		}
+		self->scratch    = mem;
+		self->scratchCap = bytes + 1;
+	}
+	aUtf_toU8(head, headLen, self->scratch);
+	aUtf_toU8(tail, tailLen, self->scratch + headBytes);
+	return aRegex_setLine(self, self->scratch, bytes);
+}
+bool aRegex_find(aRegex_t * restrict self, usize from, usize * restrict start, usize * restrict end)
+{
+	if (self->line == NULL)
+	{
+		return false;
+	}
+	// Columns are counted on from the last match, unless the search goes back
+	if (from < self->lineCol)
+	{
+		self->lineCol  = 0;
+		self->lineByte = 0;
+	}
+	wchar tmp[2];
+	while ((self->lineCol < from) && (self->lineByte < self->lineLen))
+	{
+		self->lineCol += aUtf_decodeCh(self->line, self->lineLen, &self->lineByte, tmp);
+	}
+	// Column inside of a surrogate pair starts the search after it
+	usize s, e;
+	if ((self->lineCol < from) || !aRegex_matchLine(self, self->line, self->lineLen, self->lineByte, &s, &e))
+	{
+		return false;
+	}
+	*start = self->lineCol + aUtf_wLen(self->line + self->lineByte, s - self->lineByte);
+	*end   = *start + aUtf_wLen(self->line + s, e - s);
+	self->lineCol  = *end;
+	self->lineByte = e;
+	return true;
+}
+void aRegex_destroy(aRegex_t * restrict self)
+{
+	if (self->rev != NULL)
+	{
+		aRegex_destroy(self->rev);
+		free(self->rev);
+	}
+	free(self->prog);
+	free(self->sets);
+	free(self->table);
+	free(self->states);
+	free(self->pool);
+	free(self->hash);
+	free(self->list);
+	free(self->eolList);
+	free(self->stack);
+	free(self->mark);
+	free(self->scratch);
+	aRegex_init(self);
+}
@@ -0,0 +1,186 @@
+#ifndef ATTO_REGEX_H
+#define ATTO_REGEX_H
+
+#include "aCommon.h"
+
+/*
+	Regular expressions over UTF-8 bytes, compiled to a Thompson NFA, that is
+	run as a lazily built DFA. A DFA state is a set of NFA instructions,
+	states & their transitions are built only when input needs them & are
+	cached in a table, so most bytes cost a single table lookup. When the
+	cache is full it's flushed & built again from the current state; work
+	per byte is bounded by the size of the program, there's no backtracking.
+
+	A match in a line is found in two passes: threads of the forward DFA are
+	kept in groups by start, so it finds where the leftmost match ends, then
+	the program compiled in reverse runs back from there to its start. Each
+	pass reads a byte once, but the forward one reads past the match as long
+	as it could still get longer, so 'a*b|a' looks through a line of a's to
+	its end for every match in it.
+
+	Syntax: literals, '.', [classes] with ranges & negation, '*', '+', '?',
+	'|', (groups), '^' & '$' at line boundaries, escapes \d \w \s \D \W \S \t.
+	Matches never cross line breaks.
+*/
+
+// Longest program in instructions
+#define ATTO_REGEX_MAX_INST 4096
+// Cached DFA states, cache is flushed when full
+#define ATTO_REGEX_STATES 4096
+// Cached NFA instruction sets of states, in instructions
+#define ATTO_REGEX_POOL (256 * 1024)
+// Most bytes leaving a state, that is skipped through with SIMD
+#define ATTO_REGEX_ACCEL 3
+
+typedef struct aRegexInst
+{
+	u8 op;
+	u32 x, y;
+
+} aRegexInst_t;
+
+typedef struct aRegexState
+{
+	// Instruction set in pool
+	u32 set, len;
+	u8 flags;
+	// Bytes leaving an accelerated state
+	u8 accelLen, accel[ATTO_REGEX_ACCEL];
+
+} aRegexState_t;
+
+typedef struct aRegex
+{
+	// Program & byte sets it matches, as 256-bit masks
+	aRegexInst_t * prog;
+	u32 progLen;
+	u32 (* sets)[8];
+	u32 numSets;
+
+	// Bytes of a class are never told apart, DFA table has a column per class
+	u8 classes[256];
+	u8 classRep[256];
+	u32 numClasses;
+
+	// Lazy DFA, table rows are states, 0 means transition isn't built yet
+	u32 * table;
+	aRegexState_t * states;
+	u32 numStates;
+	u32 * pool;
+	usize poolLen;
+	u32 * hash;
+	// Start states at & after a line start, unanchored, anchored & longest, 0 if not built
+	u32 starts[6];
+	bool flushed;
+	usize flushes;
+	// Reversed program, finds match starts
+	struct aRegex * rev;
+
+	// Work memory of building states
+	u32 * list, * eolList, * stack, * mark;
+	u32 markGen;
+
+	// Line searched with aRegex_find, column & byte index of last match end
+	const char * line;
+	usize lineLen, lineCol, lineByte;
+	// UTF-8 copy of a wchar line
+	char * scratch;
+	usize scratchCap;
+
+} aRegex_t;
+
+/**
+ * @brief Initialises an empty regular expression, which matches nothing
+ *
+ * @param self Pointer to aRegex_t structure
+ */
+void aRegex_init(aRegex_t * restrict self);
+/**
+ * @brief Compiles pattern, empty pattern matches nothing
+ *
+ * @param self Pointer to aRegex_t structure
+ * @param pattern Pointer to wchar character array
+ * @param len Number of wchar units
+ * @return const wchar* NULL on success, error message otherwise, expression becomes empty
+ */
+const wchar * aRegex_compile(aRegex_t * restrict self, const wchar * restrict pattern, usize len);
+/**
+ * @brief Checks whether expression is empty
+ *
+ * @param self Pointer to aRegex_t structure
+ * @return true Expression matches nothing
+ * @return false Expression is compiled
+ */
+bool aRegex_empty(const aRegex_t * restrict self);
+/**
+ * @brief Streams through UTF-8 text of many lines (LF, CRLF or CR line
+ * breaks), finds the first line containing a match
+ *
+ * @param self Pointer to aRegex_t structure
+ * @param text Pointer to UTF-8 character array, starts at the start of a line
+ * @param len Number of bytes
+ * @return usize Byte index of the start of the line, len if nothing matches
+ */
+usize aRegex_scan(aRegex_t * restrict self, const char * restrict text, usize len);
+/**
+ * @brief Finds leftmost match in a single line of UTF-8 text, the longest
+ * match starting there is taken
+ *
+ * @param self Pointer to aRegex_t structure
+ * @param line Pointer to UTF-8 character array, without line break
+ * @param len Number of bytes
+ * @param from Byte index matches can start from
+ * @param start Address of match start byte index
+ * @param end Address of match end byte index
+ * @return true Match has been found
+ * @return false No match
+ */
+bool aRegex_matchLine(aRegex_t * restrict self, const char * restrict line, usize len, usize from, usize * restrict start, usize * restrict end);
+/**
+ * @brief Sets UTF-8 line, that is searched with aRegex_find, line isn't
+ * copied & must stay unchanged while it's searched
+ *
+ * @param self Pointer to aRegex_t structure
+ * @param line Pointer to UTF-8 character array, without line break
+ * @param len Number of bytes
+ * @return true Line may contain a match
+ * @return false Line has no match
+ */
+bool aRegex_setLine(aRegex_t * restrict self, const char * restrict line, usize len);
+/**
+ * @brief Sets line of wchar text, given in two parts like a gap buffer, that is
+ * searched with aRegex_find, line is converted to UTF-8 once
+ *
+ * @param self Pointer to aRegex_t structure
+ * @param head Pointer to first part of line
+ * @param headLen Number of wchar units in first part
+ * @param tail Pointer to second part of line
+ * @param tailLen Number of wchar units in second part
+ * @return true Line may contain a match
+ * @return false Line has no match or memory error
+ */
+bool aRegex_setLineW(
+	aRegex_t * restrict self,
+	const wchar * restrict head, usize headLen,
+	const wchar * restrict tail, usize tailLen
+);
+/**
+ * @brief Finds leftmost match at or after given column in line set last,
+ * columns are counted on from the last match, when searching on after it
+ *
+ * @param self Pointer to aRegex_t structure
+ * @param from Column matches can start from
+ * @param start Address of match start column
+ * @param end Address of match end column
+ * @return true Match has been found
+ * @return false No match
+ */
+bool aRegex_find(aRegex_t * restrict self, usize from, usize * restrict start, usize * restrict end);
+/**
+ * @brief Frees memory, expression becomes empty
+ *
+ * @param self Pointer to aRegex_t structure
+ */
+void aRegex_destroy(aRegex_t * restrict self);
+
+#endif
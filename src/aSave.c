@@ -0,0 +1,375 @@
+#ifndef _WIN32
+	#define _POSIX_C_SOURCE 200112L
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/stat.h>
+
+	#define ATTO_SAVE_MAX_PATH 4096
+#endif
+
+#include "aSave.h"
+#include "aUtf.h"
+
+
+typedef struct aSaveOut
+{
+	char * buf;
+	usize len, total;
+#ifdef _WIN32
+	HANDLE hFile;
+#else
+	int fd;
+#endif
+	bool ok;
+
+} aSaveOut_t;
+
+static bool aSave_raw(aSaveOut_t * restrict out, const char * restrict src, usize len)
+{
+	usize written = 0;
+	while (out->ok && (written < len))
+	{
+#ifdef _WIN32
+		// WriteFile can only write up to 4 GiB at a time
+		const usize chunk = ((len - written) < ((usize)1 << 30)) ? (len - written) : ((usize)1 << 30);
+		DWORD dwWritten = 0;
+		out->ok = WriteFile(out->hFile, src + written, (DWORD)chunk, &dwWritten, NULL) != FALSE;
+		written += dwWritten;
+#else
+		const ssize_t n = write(out->fd, src + written, len - written);
+		out->ok = (n > 0);
+		written += out->ok ? (usize)n : 0;
+#endif
+	}
+	out->total += len;
+	return out->ok;
+}
+static bool aSave_flush(aSaveOut_t * restrict out)
+{
+	const usize len = out->len;
+	out->len = 0;
+	return aSave_raw(out, out->buf, len);
+}
+static void aSave_put(aSaveOut_t * restrict out, const char * restrict src, usize len)
+{
+	// Long runs skip the buffer
+	if ((len >= ATTO_SAVE_BUF) && aSave_flush(out))
+	{
+		aSave_raw(out, src, len);
+		return;
+	}
+	while (out->ok && (len > 0))
+	{
+		const usize n = (len < (ATTO_SAVE_BUF - out->len)) ? len : (ATTO_SAVE_BUF - out->len);
+		memcpy(out->buf + out->len, src, n);
+		out->len += n;
+		src += n;
+		len  -= n;
+		if (out->len == ATTO_SAVE_BUF)
+		{
+			aSave_flush(out);
+		}
+	}
+}
+static void aSave_putConverted(aSaveOut_t * restrict out, const aSave_t * restrict self, const char * restrict src, usize len)
+{
+	for (usize pos = 0; out->ok && (pos < len);)
+	{
+		const usize end = pos + aUtf_findEol(src + pos, len - pos);
+		aSave_put(out, src + pos, end - pos);
+		if (end == len)
+		{
+			break;
+		}
+		aSave_put(out, self->eol, self->eolLen);
+		pos = end + (((src[end] == '\r') && ((end + 1) < len) && (src[end + 1] == '\n')) ? 2 : 1);
+	}
+}
+
+#ifndef _WIN32
+static bool aSave_path(const wchar * restrict name, char * restrict path)
+{
+	// Paths are encoded as UTF-8, whatever the locale
+	const usize len = wcslen(name);
+	if (aUtf_u8Len(name, len) >= ATTO_SAVE_MAX_PATH)
+	{
+		return false;
+	}
+	path[aUtf_toU8(name, len, path)] = '\0';
+	return true;
+}
+static void aSave_syncDir(const char * restrict path)
+{
+	// Rename is only durable once the directory is flushed as well
+	char dir[ATTO_SAVE_MAX_PATH];
+	strcpy(dir, path);
+	char * slash = strrchr(dir, '/');
+	if (slash == NULL)
+	{
+		strcpy(dir, ".");
+	}
+	else
+	{
+		slash[(slash == dir) ? 1 : 0] = '\0';
+	}
+	const int fd = open(dir, O_RDONLY);
+	if (fd != -1)
+	{
+		fsync(fd);
+		close(fd);
+	}
+}
+#endif
+
+static void aSave_work(vptr arg)
+{
+	aSave_t * restrict self = arg;
+	aSaveOut_t out = {
+		.buf   = malloc(ATTO_SAVE_BUF),
+		.len   = 0,
+		.total = 0,
+		.ok    = true
+	};
+	asr_e res = asrOK;
+
+#ifdef _WIN32
+	out.hFile = CreateFileW(self->tempName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	const bool opened = (out.hFile != INVALID_HANDLE_VALUE);
+#else
+	char path[ATTO_SAVE_MAX_PATH];
+	out.fd = aSave_path(self->tempName, path) ? open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666) : -1;
+	const bool opened = (out.fd != -1);
+	// New file gets permissions of the old one
+	struct stat st;
+	if (opened && aSave_path(self->fileName, path) && (stat(path, &st) == 0))
+	{
+		fchmod(out.fd, st.st_mode & 07777);
+	}
+#endif
+
+	if (out.buf == NULL)
+	{
+		res = asrMEM_ERROR;
+	}
+	else if (!opened)
+	{
+		res = asrOPEN_ERROR;
+	}
+	else
+	{
+		for (usize i = 0; (i < self->numRuns) && out.ok; ++i)
+		{
+			aSaveRun_t * restrict run = &self->runs[i];
+			const char * restrict mem = (run->mem != NULL) ? run->mem : (self->bytes + run->offset);
+			run->outOffset = out.total + out.len;
+			if (run->convertEol)
+			{
+				aSave_putConverted(&out, self, mem, run->len);
+			}
+			else
+			{
+				aSave_put(&out, mem, run->len);
+			}
+			run->outLen = out.total + out.len - run->outOffset;
+		}
+		aSave_flush(&out);
+#ifdef _WIN32
+		out.ok = out.ok && FlushFileBuffers(out.hFile);
+#else
+		out.ok = out.ok && (fsync(out.fd) == 0);
+#endif
+		res = out.ok ? asrOK : asrWRITE_ERROR;
+	}
+
+	if (opened)
+	{
+#ifdef _WIN32
+		CloseHandle(out.hFile);
+#else
+		res = ((close(out.fd) != 0) && (res == asrOK)) ? asrWRITE_ERROR : res;
+#endif
+	}
+	free(out.buf);
+
+	aThread_lock(&self->lock);
+	self->written = out.total;
+	self->res     = res;
+	self->done    = true;
+	aThread_unlock(&self->lock);
+}
+
+void aSave_init(aSave_t * restrict self, const char * restrict eol, usize eolLen)
+{
+	*self = (aSave_t){
+		.runs     = NULL,
+		.numRuns  = 0,
+		.maxRuns  = 0,
+		.bytes    = NULL,
+		.numBytes = 0,
+		.maxBytes = 0,
+		.eolLen   = eolLen,
+		.fileName = NULL,
+		.tempName = NULL,
+		.done     = false,
+		.replaced = false,
+		.res      = asrOK,
+		.written  = 0
+	};
+	memcpy(self->eol, eol, eolLen);
+}
+static aSaveRun_t * aSave_addRun(aSave_t * restrict self)
+{
+	if (self->numRuns == self->maxRuns)
+	{
+		const usize newMax = (self->maxRuns == 0) ? 64 : (2 * self->maxRuns);
+		vptr mem = realloc(self->runs, sizeof(aSaveRun_t) * newMax);
+		if (mem == NULL)
+		{
+			return NULL;
+		}
+		self->runs    = mem;
+		self->maxRuns = newMax;
+	}
+	return &self->runs[self->numRuns++];
+}
+char * aSave_reserve(aSave_t * restrict self, usize maxBytes)
+{
+	if ((self->maxBytes - self->numBytes) < maxBytes)
+	{
+		usize newMax = (self->maxBytes == 0) ? ATTO_SAVE_BUF : self->maxBytes;
+		while ((newMax - self->numBytes) < maxBytes)
+		{
+			newMax *= 2;
+		}
+		vptr mem = realloc(self->bytes, newMax);
+		if (mem == NULL)
+		{
+			return NULL;
+		}
+		self->bytes    = mem;
+		self->maxBytes = newMax;
+	}
+	return self->bytes + self->numBytes;
+}
+bool aSave_use(aSave_t * restrict self, usize bytes)
+{
+	// Bytes right after the previous held run extend it
+	aSaveRun_t * restrict last = (self->numRuns > 0) ? &self->runs[self->numRuns - 1] : NULL;
+	if ((last != NULL) && (last->mem == NULL))
+	{
+		last->len += bytes;
+		self->numBytes += bytes;
+		return true;
+	}
+
+	aSaveRun_t * restrict run = aSave_addRun(self);
+	if (run == NULL)
+	{
+		return false;
+	}
+	*run = (aSaveRun_t){
+		.mem        = NULL,
+		.offset     = self->numBytes,
+		.len        = bytes,
+		.convertEol = false,
+		.outOffset  = 0,
+		.outLen     = 0
+	};
+	self->numBytes += bytes;
+	return true;
+}
+bool aSave_addRef(aSave_t * restrict self, const char * restrict mem, usize len, bool convertEol)
+{
+	aSaveRun_t * restrict run = aSave_addRun(self);
+	if (run == NULL)
+	{
+		return false;
+	}
+	*run = (aSaveRun_t){
+		.mem        = mem,
+		.offset     = 0,
+		.len        = len,
+		.convertEol = convertEol,
+		.outOffset  = 0,
+		.outLen     = 0
+	};
+	return true;
+}
+bool aSave_start(aSave_t * restrict self, const wchar * restrict fileName)
+{
+	const usize len = wcslen(fileName), suffixLen = wcslen(ATTO_SAVE_SUFFIX);
+	self->fileName = malloc(sizeof(wchar) * (len + 1));
+	self->tempName = malloc(sizeof(wchar) * (len + suffixLen + 1));
+	if ((self->fileName == NULL) || (self->tempName == NULL))
+	{
+		free(self->fileName);
+		free(self->tempName);
+		self->fileName = NULL;
+		self->tempName = NULL;
+		return false;
+	}
+	memcpy(self->fileName, fileName, sizeof(wchar) * (len + 1));
+	memcpy(self->tempName, fileName, sizeof(wchar) * len);
+	memcpy(self->tempName + len, ATTO_SAVE_SUFFIX, sizeof(wchar) * (suffixLen + 1));
+
+	aThread_lockInit(&self->lock);
+	if (!aThread_create(&self->thread, &aSave_work, self))
+	{
+		aSave_work(self);
+	}
+	return true;
+}
+bool aSave_done(aSave_t * restrict self)
+{
+	aThread_lock(&self->lock);
+	const bool done = self->done;
+	aThread_unlock(&self->lock);
+	return done;
+}
+asr_e aSave_wait(aSave_t * restrict self)
+{
+	aThread_join(&self->thread);
+	return self->res;
+}
+bool aSave_replace(aSave_t * restrict self)
+{
+#ifdef _WIN32
+	self->replaced = MoveFileExW(self->tempName, self->fileName, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != FALSE;
+#else
+	char temp[ATTO_SAVE_MAX_PATH], path[ATTO_SAVE_MAX_PATH];
+	self->replaced = aSave_path(self->tempName, temp) && aSave_path(self->fileName, path) && (rename(temp, path) == 0);
+	if (self->replaced)
+	{
+		aSave_syncDir(path);
+	}
+#endif
+	return self->replaced;
+}
+void aSave_destroy(aSave_t * restrict self, bool removeTemp)
+{
+	if (self->fileName != NULL)
+	{
+		aSave_wait(self);
+		aThread_lockDestroy(&self->lock);
+		if (removeTemp && !self->replaced)
+		{
+#ifdef _WIN32
+			DeleteFileW(self->tempName);
+#else
+			char path[ATTO_SAVE_MAX_PATH];
+			if (aSave_path(self->tempName, path))
+			{
+				unlink(path);
+			}
+#endif
+		}
+	}
+	free(self->fileName);
+	free(self->tempName);
+	free(self->runs);
+	free(self->bytes);
+	self->fileName = NULL;
+	self->tempName = NULL;
+	self->runs     = NULL;
+	self->bytes    = NULL;
+}
@@ -0,0 +1,142 @@
+#ifndef ATTO_SAVE_H
+#define ATTO_SAVE_H
+
+#include "aCommon.h"
+#include "aThread.h"
+
+/*
+	Durable background save. Contents are described by a list of byte runs:
+	runs copied into the save itself and runs referring to memory, which
+	stays unchanged until the save has finished (mapped file contents).
+
+	A worker thread writes the runs to a sibling temporary file and flushes
+	it to disc. aSave_replace then renames it over the target, so the
+	target always holds either the old or the new contents.
+
+	Uses Win32 file functions on Windows and POSIX ones elsewhere.
+*/
+
+// Runs are written through a buffer of this many bytes
+#define ATTO_SAVE_BUF (256 * 1024)
+// Appended to the target's name to get the temporary file's name
+#define ATTO_SAVE_SUFFIX L".atto~"
+
+typedef enum aSave_res
+{
+	asrOK = 0,
+	asrOPEN_ERROR,
+	asrWRITE_ERROR,
+	asrMEM_ERROR
+
+} aSave_res_e, asr_e;
+
+typedef struct aSaveRun
+{
+	// NULL if bytes are held by the save, starting at offset
+	const char * mem;
+	usize offset, len;
+	// EOL sequences inside of the run are replaced with the save's one
+	bool convertEol;
+
+	// Position of the run in the written file, valid once the save is done
+	usize outOffset, outLen;
+
+} aSaveRun_t;
+
+typedef struct aSave
+{
+	aSaveRun_t * runs;
+	usize numRuns, maxRuns;
+	char * bytes;
+	usize numBytes, maxBytes;
+
+	char eol[2];
+	usize eolLen;
+
+	wchar * fileName, * tempName;
+	aThread_t thread;
+	aThreadLock_t lock;
+	bool done, replaced;
+	asr_e res;
+	usize written;
+
+} aSave_t;
+
+/**
+ * @brief Initialises an empty save
+ *
+ * @param self Pointer to aSave_t structure
+ * @param eol EOL sequence, that converting runs get
+ * @param eolLen Length of EOL sequence, 1 or 2
+ */
+void aSave_init(aSave_t * restrict self, const char * restrict eol, usize eolLen);
+/**
+ * @brief Reserves space for bytes held by the save, aSave_use has to follow
+ *
+ * @param self Pointer to aSave_t structure
+ * @param maxBytes Maximum number of bytes to add
+ * @return char* Pointer to space, valid until next call, NULL on failure
+ */
+char * aSave_reserve(aSave_t * restrict self, usize maxBytes);
+/**
+ * @brief Adds reserved bytes to the end of contents
+ *
+ * @param self Pointer to aSave_t structure
+ * @param bytes Number of bytes actually written to reserved space
+ * @return true Success
+ * @return false Failure
+ */
+bool aSave_use(aSave_t * restrict self, usize bytes);
+/**
+ * @brief Adds a run referring to memory to the end of contents
+ *
+ * @param self Pointer to aSave_t structure
+ * @param mem Pointer to memory, must stay unchanged until the save is done
+ * @param len Number of bytes
+ * @param convertEol Whether EOL sequences in the run have to be converted
+ * @return true Success
+ * @return false Failure
+ */
+bool aSave_addRef(aSave_t * restrict self, const char * restrict mem, usize len, bool convertEol);
+/**
+ * @brief Starts writing contents to a temporary file next to fileName on a
+ * worker thread, writes them right away if there's no thread
+ *
+ * @param self Pointer to aSave_t structure
+ * @param fileName Target file name
+ * @return true Save has been started
+ * @return false Memory error, nothing has been written
+ */
+bool aSave_start(aSave_t * restrict self, const wchar * restrict fileName);
+/**
+ * @brief Checks whether worker has finished, doesn't block
+ *
+ * @param self Pointer to aSave_t structure
+ * @return true Temporary file is written or an error has occurred
+ * @return false Still writing
+ */
+bool aSave_done(aSave_t * restrict self);
+/**
+ * @brief Waits for worker to finish
+ *
+ * @param self Pointer to aSave_t structure
+ * @return asr_e Result of writing the temporary file
+ */
+asr_e aSave_wait(aSave_t * restrict self);
+/**
+ * @brief Atomically replaces target with the written temporary file
+ *
+ * @param self Pointer to aSave_t structure, must be done successfully
+ * @return true Success
+ * @return false Failure, temporary file is left in place
+ */
+bool aSave_replace(aSave_t * restrict self);
+/**
+ * @brief Waits for worker, frees all memory
+ *
+ * @param self Pointer to aSave_t structure
+ * @param removeTemp Whether an unreplaced temporary file is deleted
+ */
+void aSave_destroy(aSave_t * restrict self, bool removeTemp);
+
+#endif
@@ -0,0 +1,316 @@
+#include "aScreen.h"
+#include "aUtf.h"
+
+#include <stdio.h>
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+	#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#ifndef DISABLE_NEWLINE_AUTO_RETURN
+	#define DISABLE_NEWLINE_AUTO_RETURN 0x0008
+#endif
+
+
+static bool aScreen_conInit(aScreen_t * restrict self)
+{
+	self->handle = CreateConsoleScreenBuffer(
+		GENERIC_WRITE,
+		0,
+		NULL,
+		CONSOLE_TEXTMODE_BUFFER,
+		NULL
+	);
+	if (self->handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	if (!SetConsoleScreenBufferSize(self->handle, (COORD){ .X = (SHORT)self->w, .Y = (SHORT)self->h }) ||
+		!SetConsoleActiveScreenBuffer(self->handle))
+	{
+		CloseHandle(self->handle);
+		self->handle = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	CONSOLE_SCREEN_BUFFER_INFO csbi;
+	self->conAttr = GetConsoleScreenBufferInfo(self->handle, &csbi) ? csbi.wAttributes : (WORD)0x07;
+	return true;
+}
+static void aScreen_conPut(aScreen_t * restrict self, u32 x, u32 y, const wchar * restrict text, const u8 * restrict attrs, usize len)
+{
+	DWORD dwBytes;
+	WriteConsoleOutputCharacterW(
+		self->handle,
+		text,
+		(DWORD)len,
+		(COORD){ .X = (SHORT)x, .Y = (SHORT)y },
+		&dwBytes
+	);
+	if (attrs == NULL)
+	{
+		return;
+	}
+
+	// Matches swap foreground & background colours
+	const WORD normal = self->conAttr, match = (WORD)(((normal & 0x0F) << 4) | ((normal & 0xF0) >> 4));
+	WORD words[128];
+	for (usize i = 0; i < len;)
+	{
+		const usize n = ((len - i) < (sizeof(words) / sizeof(words[0]))) ? (len - i) : (sizeof(words) / sizeof(words[0]));
+		for (usize j = 0; j < n; ++j)
+		{
+			words[j] = (attrs[i + j] == asaMATCH) ? match : normal;
+		}
+		WriteConsoleOutputAttribute(
+			self->handle,
+			words,
+			(DWORD)n,
+			(COORD){ .X = (SHORT)(x + i), .Y = (SHORT)y },
+			&dwBytes
+		);
+		i += n;
+	}
+}
+static void aScreen_conFlush(aScreen_t * restrict self, u32 cursorX, u32 cursorY)
+{
+	SetConsoleCursorPosition(self->handle, (COORD){ .X = (SHORT)cursorX, .Y = (SHORT)cursorY });
+}
+static void aScreen_conDestroy(aScreen_t * restrict self)
+{
+	if (self->handle != INVALID_HANDLE_VALUE)
+	{
+		SetConsoleActiveScreenBuffer(self->conOut);
+		CloseHandle(self->handle);
+		self->handle = INVALID_HANDLE_VALUE;
+	}
+}
+
+static char * aScreen_vtReserve(aScreen_t * restrict self, usize bytes)
+{
+	if ((self->cap - self->len) < bytes)
+	{
+		usize newCap = (self->cap == 0) ? 4096 : self->cap;
+		while ((newCap - self->len) < bytes)
+		{
+			newCap *= 2;
+		}
+		vptr mem = realloc(self->out, newCap);
+		if (mem == NULL)
+		{
+			return NULL;
+		}
+		self->out = mem;
+		self->cap = newCap;
+	}
+	return self->out + self->len;
+}
+static void aScreen_vtSeq(aScreen_t * restrict self, const char * restrict fmt, u32 a, u32 b)
+{
+	// Longest sequence is CSI, 2 numbers, separator & final byte
+	char * restrict dst = aScreen_vtReserve(self, 32);
+	if (dst != NULL)
+	{
+		self->len += (usize)snprintf(dst, 32, fmt, a, b);
+	}
+}
+static void aScreen_vtMove(aScreen_t * restrict self, u32 x, u32 y)
+{
+	if (self->curKnown && (self->curY == y) && (self->curX == x))
+	{
+		return;
+	}
+	// Moving forward on the same row is shorter than a full position
+	else if (self->curKnown && (self->curY == y) && (self->curX < x))
+	{
+		aScreen_vtSeq(self, ((x - self->curX) == 1) ? "\x1b[C" : "\x1b[%uC", x - self->curX, 0);
+	}
+	else
+	{
+		aScreen_vtSeq(self, (x == 0) ? "\x1b[%uH" : "\x1b[%u;%uH", y + 1, x + 1);
+	}
+	self->curX = x;
+	self->curY = y;
+	self->curKnown = true;
+}
+static void aScreen_vtWrite(aScreen_t * restrict self, const char * restrict src, usize len)
+{
+	for (usize written = 0; written < len;)
+	{
+		DWORD dwWritten = 0;
+		if (!WriteFile(self->conOut, src + written, (DWORD)(len - written), &dwWritten, NULL) || (dwWritten == 0))
+		{
+			break;
+		}
+		written += dwWritten;
+	}
+}
+static bool aScreen_vtInit(aScreen_t * restrict self)
+{
+	if (!GetConsoleMode(self->conOut, &self->oldMode) ||
+		!SetConsoleMode(self->conOut, self->oldMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING | DISABLE_NEWLINE_AUTO_RETURN))
+	{
+		return false;
+	}
+	self->oldCP = GetConsoleOutputCP();
+	SetConsoleOutputCP(CP_UTF8);
+
+	// Alternate screen, cleared with normal attributes
+	static const char start[] = "\x1b[?1049h\x1b[m\x1b[2J";
+	aScreen_vtWrite(self, start, sizeof(start) - 1);
+	return true;
+}
+static void aScreen_vtRun(aScreen_t * restrict self, u32 x, u32 y, const wchar * restrict text, usize len, asa_e attr)
+{
+	if (attr != self->attr)
+	{
+		aScreen_vtSeq(self, (attr == asaMATCH) ? "\x1b[7m" : "\x1b[27m", 0, 0);
+		self->attr = attr;
+	}
+	for (usize i = 0; i < len;)
+	{
+		usize spaces = 0;
+		while (((i + spaces) < len) && (text[i + spaces] == L' '))
+		{
+			++spaces;
+		}
+		const bool toEnd = ((x + i + spaces) == self->w);
+		// Erasing doesn't move the cursor, erased cells are normal
+		if ((attr == asaNORMAL) && ((toEnd && (spaces >= 4)) || (spaces >= ATTO_SCREEN_MIN_ERASE)))
+		{
+			aScreen_vtMove(self, x + (u32)i, y);
+			aScreen_vtSeq(self, toEnd ? "\x1b[K" : "\x1b[%uX", (u32)spaces, 0);
+			i += spaces;
+			continue;
+		}
+
+		// Text goes up to the next long run of spaces
+		usize end = i + spaces;
+		while ((attr == asaNORMAL) && (end < len))
+		{
+			usize run = 0;
+			while (((end + run) < len) && (text[end + run] == L' '))
+			{
+				++run;
+			}
+			if ((run >= ATTO_SCREEN_MIN_ERASE) || ((run >= 4) && ((x + end + run) == self->w)))
+			{
+				break;
+			}
+			end += (run > 0) ? run : 1;
+		}
+		end = (attr == asaNORMAL) ? end : len;
+
+		aScreen_vtMove(self, x + (u32)i, y);
+		char * restrict dst = aScreen_vtReserve(self, ATTO_UTF_MAX_U8 * (end - i));
+		if (dst != NULL)
+		{
+			self->len += aUtf_toU8(text + i, end - i, dst);
+		}
+		self->curX += (u32)(end - i);
+		// Cursor waits at the last column for a wrap, its position isn't certain
+		self->curKnown = (self->curX < self->w);
+		i = end;
+	}
+}
+static void aScreen_vtPut(aScreen_t * restrict self, u32 x, u32 y, const wchar * restrict text, const u8 * restrict attrs, usize len)
+{
+	// Cells are written in runs of the same attribute
+	for (usize i = 0; i < len;)
+	{
+		const asa_e attr = (attrs == NULL) ? asaNORMAL : (asa_e)attrs[i];
+		usize end = i + 1;
+		while ((end < len) && (((attrs == NULL) ? asaNORMAL : (asa_e)attrs[end]) == attr))
+		{
+			++end;
+		}
+		aScreen_vtRun(self, x + (u32)i, y, text + i, end - i, attr);
+		i = end;
+	}
+}
+static void aScreen_vtFlush(aScreen_t * restrict self, u32 cursorX, u32 cursorY)
+{
+	aScreen_vtMove(self, cursorX, cursorY);
+	// Whole frame goes out at once
+	aScreen_vtWrite(self, self->out, self->len);
+	self->len = 0;
+}
+static void aScreen_vtDestroy(aScreen_t * restrict self)
+{
+	static const char end[] = "\x1b[m\x1b[?1049l";
+	aScreen_vtWrite(self, end, sizeof(end) - 1);
+	SetConsoleOutputCP(self->oldCP);
+	SetConsoleMode(self->conOut, self->oldMode);
+	free(self->out);
+	self->out = NULL;
+}
+
+const aScreenBackend_t aScreen_console = {
+	.name    = L"console",
+	.init    = &aScreen_conInit,
+	.put     = &aScreen_conPut,
+	.flush   = &aScreen_conFlush,
+	.destroy = &aScreen_conDestroy
+};
+const aScreenBackend_t aScreen_vt = {
+	.name    = L"vt",
+	.init    = &aScreen_vtInit,
+	.put     = &aScreen_vtPut,
+	.flush   = &aScreen_vtFlush,
+	.destroy = &aScreen_vtDestroy
+};
+
+const aScreenBackend_t * aScreen_pick(void)
+{
+	static const aScreenBackend_t * const backends[] = { &aScreen_console, &aScreen_vt };
+	wchar name[16];
+	const DWORD len = GetEnvironmentVariableW(ATTO_SCREEN_ENV, name, 16);
+	for (usize i = 0; (len > 0) && (len < 16) && (i < (sizeof(backends) / sizeof(backends[0]))); ++i)
+	{
+		if (wcscmp(name, backends[i]->name) == 0)
+		{
+			return backends[i];
+		}
+	}
+	return &aScreen_console;
+}
+bool aScreen_init(aScreen_t * restrict self, const aScreenBackend_t * restrict backend, HANDLE conOut, u32 w, u32 h)
+{
+	*self = (aScreen_t){
+		.backend  = NULL,
+		.conOut   = conOut,
+		.handle   = INVALID_HANDLE_VALUE,
+		.w        = w,
+		.h        = h,
+		.conAttr  = 0x07,
+		.out      = NULL,
+		.len      = 0,
+		.cap      = 0,
+		.curX     = 0,
+		.curY     = 0,
+		.curKnown = false,
+		.attr     = asaNORMAL,
+		.oldMode  = 0,
+		.oldCP    = 0
+	};
+	if (!backend->init(self))
+	{
+		return false;
+	}
+	self->backend = backend;
+	return true;
+}
+void aScreen_put(aScreen_t * restrict self, u32 x, u32 y, const wchar * restrict text, const u8 * restrict attrs, usize len)
+{
+	self->backend->put(self, x, y, text, attrs, len);
+}
+void aScreen_flush(aScreen_t * restrict self, u32 cursorX, u32 cursorY)
+{
+	self->backend->flush(self, cursorX, cursorY);
+}
+void aScreen_destroy(aScreen_t * restrict self)
+{
+	if (self->backend != NULL)
+	{
+		self->backend->destroy(self);
+		self->backend = NULL;
+	}
+}
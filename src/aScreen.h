@@ -0,0 +1,115 @@
+#ifndef ATTO_SCREEN_H
+#define ATTO_SCREEN_H
+
+#include "aCommon.h"
+
+/*
+	Screen backends. aData diffs every frame against the previous one and
+	hands the backend runs of changed cells, then flushes the frame with
+	the cursor position.
+
+	Console backend writes through Win32 console functions to a screen
+	buffer of its own. VT backend turns a frame into VT/ANSI escape
+	sequences: a cursor move only where a run doesn't start at the cursor,
+	erase sequences for runs of spaces, all of it written at once. It suits
+	terminals and slow remote links, where every byte adds latency. It
+	still writes to a Windows console: console mode, code page & input go
+	through the console API, so it doesn't run in Linux terminals.
+*/
+
+// Environment variable choosing the backend by name, console backend is the default
+#define ATTO_SCREEN_ENV L"ATTO_SCREEN"
+// Changed cells closer than this are written as a single run
+#define ATTO_SCREEN_GAP 8
+// Runs of at least this many spaces are erased instead of written (VT)
+#define ATTO_SCREEN_MIN_ERASE 8
+
+typedef enum aScreenAttr
+{
+	asaNORMAL,
+	// Highlighted match, drawn in reverse video
+	asaMATCH
+
+} aScreenAttr_e, asa_e;
+
+struct aScreen;
+
+typedef struct aScreenBackend
+{
+	const wchar * name;
+	bool (*init)(struct aScreen * restrict self);
+	void (*put)(struct aScreen * restrict self, u32 x, u32 y, const wchar * restrict text, const u8 * restrict attrs, usize len);
+	void (*flush)(struct aScreen * restrict self, u32 cursorX, u32 cursorY);
+	void (*destroy)(struct aScreen * restrict self);
+
+} aScreenBackend_t;
+
+typedef struct aScreen
+{
+	const aScreenBackend_t * backend;
+	HANDLE conOut, handle;
+	u32 w, h;
+	// Console attribute of normal cells
+	WORD conAttr;
+
+	// VT frame being assembled & position of the terminal's cursor after it
+	char * out;
+	usize len, cap;
+	u32 curX, curY;
+	bool curKnown;
+	// Attribute set on the terminal
+	asa_e attr;
+	// VT console settings restored on exit
+	DWORD oldMode;
+	UINT oldCP;
+
+} aScreen_t;
+
+extern const aScreenBackend_t aScreen_console, aScreen_vt;
+
+/**
+ * @brief Picks backend named by ATTO_SCREEN_ENV environment variable
+ *
+ * @return const aScreenBackend_t* Pointer to backend, console backend if the variable isn't set
+ */
+const aScreenBackend_t * aScreen_pick(void);
+/**
+ * @brief Initialises screen, takes over the console
+ *
+ * @param self Pointer to aScreen_t structure
+ * @param backend Pointer to backend
+ * @param conOut Console output handle
+ * @param w Screen width in cells
+ * @param h Screen height in cells
+ * @return true Success
+ * @return false Failure, console is left as it was
+ */
+bool aScreen_init(aScreen_t * restrict self, const aScreenBackend_t * restrict backend, HANDLE conOut, u32 w, u32 h);
+/**
+ * @brief Writes a run of cells
+ *
+ * @param self Pointer to aScreen_t structure
+ * @param x Column of the first cell
+ * @param y Row
+ * @param text Pointer to characters of cells
+ * @param attrs Pointer to attributes of cells (asa_e), NULL if they're all normal
+ * & have been normal before
+ * @param len Number of cells, run doesn't go past the end of the row
+ */
+void aScreen_put(aScreen_t * restrict self, u32 x, u32 y, const wchar * restrict text, const u8 * restrict attrs, usize len);
+/**
+ * @brief Ends a frame, puts cursor in place
+ *
+ * @param self Pointer to aScreen_t structure
+ * @param cursorX Column of the cursor
+ * @param cursorY Row of the cursor
+ */
+void aScreen_flush(aScreen_t * restrict self, u32 cursorX, u32 cursorY);
+/**
+ * @brief Gives the console back, frees memory
+ *
+ * @param self Pointer to aScreen_t structure
+ */
+void aScreen_destroy(aScreen_t * restrict self);
+
+#endif
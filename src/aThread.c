@@ -0,0 +1,167 @@
+#ifndef _WIN32
+	#define _POSIX_C_SOURCE 200112L
+	#include <unistd.h>
+	#include <time.h>
+#endif
+
+#include "aThread.h"
+
+
+#ifdef _WIN32
+static DWORD WINAPI aThread_start(LPVOID param)
+{
+	aThread_t * restrict self = param;
+	self->func(self->arg);
+	return 0;
+}
+#else
+static vptr aThread_start(vptr param)
+{
+	aThread_t * restrict self = param;
+	self->func(self->arg);
+	return NULL;
+}
+#endif
+
+bool aThread_create(aThread_t * restrict self, aThreadFunc_t func, vptr arg)
+{
+	self->func    = func;
+	self->arg     = arg;
+	self->running = false;
+
+#ifdef _WIN32
+	self->handle = CreateThread(NULL, 0, &aThread_start, self, 0, NULL);
+	self->running = (self->handle != NULL);
+#else
+	self->running = (pthread_create(&self->handle, NULL, &aThread_start, self) == 0);
+#endif
+
+	return self->running;
+}
+void aThread_join(aThread_t * restrict self)
+{
+	if (!self->running)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	WaitForSingleObject(self->handle, INFINITE);
+	CloseHandle(self->handle);
+#else
+	pthread_join(self->handle, NULL);
+#endif
+	self->running = false;
+}
+usize aThread_cpus(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	const usize cpus = (usize)info.dwNumberOfProcessors;
+#else
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	const usize cpus = (n > 0) ? (usize)n : 1;
+#endif
+	return (cpus > 0) ? cpus : 1;
+}
+
+void aThread_lockInit(aThreadLock_t * restrict self)
+{
+#ifdef _WIN32
+	InitializeCriticalSection(&self->cs);
+#else
+	pthread_mutex_init(&self->m, NULL);
+#endif
+}
+void aThread_lock(aThreadLock_t * restrict self)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&self->cs);
+#else
+	pthread_mutex_lock(&self->m);
+#endif
+}
+void aThread_unlock(aThreadLock_t * restrict self)
+{
+#ifdef _WIN32
+	LeaveCriticalSection(&self->cs);
+#else
+	pthread_mutex_unlock(&self->m);
+#endif
+}
+void aThread_lockDestroy(aThreadLock_t * restrict self)
+{
+#ifdef _WIN32
+	DeleteCriticalSection(&self->cs);
+#else
+	pthread_mutex_destroy(&self->m);
+#endif
+}
+
+bool aThread_signalInit(aThreadSignal_t * restrict self)
+{
+#ifdef _WIN32
+	self->event = CreateEventW(NULL, FALSE, FALSE, NULL);
+	return self->event != NULL;
+#else
+	self->set = false;
+	if (pthread_mutex_init(&self->m, NULL) != 0)
+	{
+		return false;
+	}
+	else if (pthread_cond_init(&self->c, NULL) != 0)
+	{
+		pthread_mutex_destroy(&self->m);
+		return false;
+	}
+	return true;
+#endif
+}
+void aThread_signal(aThreadSignal_t * restrict self)
+{
+#ifdef _WIN32
+	SetEvent(self->event);
+#else
+	pthread_mutex_lock(&self->m);
+	self->set = true;
+	pthread_cond_signal(&self->c);
+	pthread_mutex_unlock(&self->m);
+#endif
+}
+bool aThread_wait(aThreadSignal_t * restrict self, u32 ms)
+{
+#ifdef _WIN32
+	return WaitForSingleObject(self->event, ms) == WAIT_OBJECT_0;
+#else
+	struct timespec until;
+	clock_gettime(CLOCK_REALTIME, &until);
+	until.tv_sec  += (time_t)(ms / 1000);
+	until.tv_nsec += (long)(ms % 1000) * 1000000L;
+	if (until.tv_nsec >= 1000000000L)
+	{
+		++until.tv_sec;
+		until.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock(&self->m);
+	// Stops on timeout, spurious wake-ups keep waiting
+	for (int res = 0; !self->set && (res == 0);)
+	{
+		res = pthread_cond_timedwait(&self->c, &self->m, &until);
+	}
+	const bool set = self->set;
+	self->set = false;
+	pthread_mutex_unlock(&self->m);
+	return set;
+#endif
+}
+void aThread_signalDestroy(aThreadSignal_t * restrict self)
+{
+#ifdef _WIN32
+	CloseHandle(self->event);
+#else
+	pthread_cond_destroy(&self->c);
+	pthread_mutex_destroy(&self->m);
+#endif
+}
@@ -0,0 +1,136 @@
+#ifndef ATTO_THREAD_H
+#define ATTO_THREAD_H
+
+#include "aCommon.h"
+
+#ifndef _WIN32
+	#include <pthread.h>
+#endif
+
+/*
+	Minimal worker thread wrapper. Uses CreateThread on Windows and pthreads
+	elsewhere. The aThread_t structure has to stay in place until the thread
+	is joined.
+
+	aThreadLock_t is a plain mutex, a critical section on Windows.
+	aThreadSignal_t wakes up a single waiting thread, an auto-reset event
+	on Windows.
+*/
+
+typedef void (*aThreadFunc_t)(vptr arg);
+
+typedef struct aThread
+{
+	aThreadFunc_t func;
+	vptr arg;
+
+#ifdef _WIN32
+	HANDLE handle;
+#else
+	pthread_t handle;
+#endif
+	bool running;
+
+} aThread_t;
+
+typedef struct aThreadLock
+{
+#ifdef _WIN32
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t m;
+#endif
+
+} aThreadLock_t;
+
+typedef struct aThreadSignal
+{
+#ifdef _WIN32
+	HANDLE event;
+#else
+	pthread_mutex_t m;
+	pthread_cond_t c;
+	bool set;
+#endif
+
+} aThreadSignal_t;
+
+/**
+ * @brief Starts new thread running func(arg)
+ * 
+ * @param self Pointer to aThread_t structure
+ * @param func Thread function
+ * @param arg Argument passed to thread function
+ * @return true Success
+ * @return false Failure, thread wasn't started
+ */
+bool aThread_create(aThread_t * restrict self, aThreadFunc_t func, vptr arg);
+/**
+ * @brief Waits for thread to finish, does nothing if thread isn't running
+ * 
+ * @param self Pointer to aThread_t structure
+ */
+void aThread_join(aThread_t * restrict self);
+/**
+ * @brief Queries number of logical processors
+ * 
+ * @return usize Number of logical processors, at least 1
+ */
+usize aThread_cpus(void);
+
+/**
+ * @brief Initialises lock
+ * 
+ * @param self Pointer to aThreadLock_t structure
+ */
+void aThread_lockInit(aThreadLock_t * restrict self);
+/**
+ * @brief Acquires lock, waits if another thread holds it
+ * 
+ * @param self Pointer to aThreadLock_t structure
+ */
+void aThread_lock(aThreadLock_t * restrict self);
+/**
+ * @brief Releases lock
+ * 
+ * @param self Pointer to aThreadLock_t structure
+ */
+void aThread_unlock(aThreadLock_t * restrict self);
+/**
+ * @brief Destroys lock, it must not be held
+ * 
+ * @param self Pointer to aThreadLock_t structure
+ */
+void aThread_lockDestroy(aThreadLock_t * restrict self);
+
+/**
+ * @brief Initialises signal, not set
+ * 
+ * @param self Pointer to aThreadSignal_t structure
+ * @return true Success
+ * @return false Failure
+ */
+bool aThread_signalInit(aThreadSignal_t * restrict self);
+/**
+ * @brief Sets signal, wakes up waiting thread
+ * 
+ * @param self Pointer to aThreadSignal_t structure
+ */
+void aThread_signal(aThreadSignal_t * restrict self);
+/**
+ * @brief Waits for signal to be set, resets it
+ * 
+ * @param self Pointer to aThreadSignal_t structure
+ * @param ms Maximum number of milliseconds to wait
+ * @return true Signal has been set
+ * @return false Timed out
+ */
+bool aThread_wait(aThreadSignal_t * restrict self, u32 ms);
+/**
+ * @brief Destroys signal, no thread may be waiting for it
+ * 
+ * @param self Pointer to aThreadSignal_t structure
+ */
+void aThread_signalDestroy(aThreadSignal_t * restrict self);
+
+#endif
@@ -0,0 +1,227 @@
+#include "aUndo.h"
+
+
+static aUndoRec_t * aUndo_addRec(aUndo_t * restrict self)
+{
+	if (self->num == self->maxRecs)
+	{
+		// Records dropped from the front make room, if there are enough of them
+		if (self->first >= (self->maxRecs / 2) && (self->first > 0))
+		{
+			memmove(self->recs, self->recs + self->first, sizeof(aUndoRec_t) * (self->num - self->first));
+			self->cur -= self->first;
+			self->num -= self->first;
+			self->first = 0;
+		}
+		else
+		{
+			const usize newMax = (self->maxRecs == 0) ? 64 : (2 * self->maxRecs);
+			vptr mem = realloc(self->recs, sizeof(aUndoRec_t) * newMax);
+			if (mem == NULL)
+			{
+				return NULL;
+			}
+			self->recs    = mem;
+			self->maxRecs = newMax;
+		}
+	}
+	++self->cur;
+	return &self->recs[self->num++];
+}
+static bool aUndo_reserveText(aUndo_t * restrict self, usize len)
+{
+	while ((self->maxText - (self->textEnd - self->textBase)) < len)
+	{
+		const usize dropped = self->textFirst - self->textBase;
+		if ((dropped >= (self->maxText / 2)) && (dropped > 0))
+		{
+			memmove(self->text, self->text + dropped, sizeof(wchar) * (self->textEnd - self->textFirst));
+			self->textBase = self->textFirst;
+		}
+		else
+		{
+			const usize newMax = (self->maxText == 0) ? 1024 : (2 * self->maxText);
+			vptr mem = realloc(self->text, sizeof(wchar) * newMax);
+			if (mem == NULL)
+			{
+				return false;
+			}
+			self->text    = mem;
+			self->maxText = newMax;
+		}
+	}
+	return true;
+}
+static bool aUndo_addText(aUndo_t * restrict self, wchar ch)
+{
+	if (!aUndo_reserveText(self, 1))
+	{
+		return false;
+	}
+	self->text[self->textEnd - self->textBase] = ch;
+	++self->textEnd;
+	return true;
+}
+static void aUndo_dropRedo(aUndo_t * restrict self)
+{
+	// Edit makes everything after it impossible to redo
+	if (self->cur < self->num)
+	{
+		self->num     = self->cur;
+		self->textEnd = (self->cur > self->first) ? (self->recs[self->cur - 1].text + self->recs[self->cur - 1].len) : self->textFirst;
+		self->open    = false;
+	}
+}
+static void aUndo_trim(aUndo_t * restrict self)
+{
+	// Oldest records go first
+	while ((aUndo_size(self) > self->budget) && (self->first < self->num))
+	{
+		self->textFirst = self->recs[self->first].text + self->recs[self->first].len;
+		++self->first;
+	}
+	if (self->first == self->num)
+	{
+		self->first = self->cur = self->num = 0;
+		self->textBase = self->textFirst = self->textEnd = 0;
+		self->open = false;
+	}
+}
+
+void aUndo_init(aUndo_t * restrict self, usize budget)
+{
+	*self = (aUndo_t){
+		.recs      = NULL,
+		.first     = 0,
+		.cur       = 0,
+		.num       = 0,
+		.maxRecs   = 0,
+		.text      = NULL,
+		.textBase  = 0,
+		.textFirst = 0,
+		.textEnd   = 0,
+		.maxText   = 0,
+		.budget    = budget,
+		.open      = false,
+		.openLine  = 0,
+		.openCol   = 0
+	};
+}
+void aUndo_clear(aUndo_t * restrict self)
+{
+	free(self->recs);
+	free(self->text);
+	aUndo_init(self, self->budget);
+}
+bool aUndo_record(aUndo_t * restrict self, auk_e kind, usize line, usize col, wchar ch)
+{
+	aUndo_dropRedo(self);
+
+	const usize endLine = (ch == L'\n') ? (line + 1) : line, endCol = (ch == L'\n') ? 0 : (col + 1);
+	// Backspacing continues a record, if the character ends where the record starts
+	const bool extend = self->open && (self->recs[self->num - 1].kind == kind) && ((kind == aukBACKSPACE) ?
+		((endLine == self->openLine) && (endCol == self->openCol)) :
+		((line == self->openLine) && (col == self->openCol)));
+
+	aUndoRec_t * restrict rec = extend ? &self->recs[self->num - 1] : aUndo_addRec(self);
+	if (rec == NULL)
+	{
+		aUndo_clear(self);
+		return false;
+	}
+	else if (!extend)
+	{
+		*rec = (aUndoRec_t){
+			.line = line,
+			.col  = col,
+			.text = self->textEnd,
+			.len  = 0,
+			.kind = kind
+		};
+	}
+	if (!aUndo_addText(self, ch))
+	{
+		aUndo_clear(self);
+		return false;
+	}
+	++rec->len;
+
+	if (kind == aukINSERT)
+	{
+		self->openLine = endLine;
+		self->openCol  = endCol;
+	}
+	else
+	{
+		rec->line = self->openLine = line;
+		rec->col  = self->openCol  = col;
+	}
+	self->open = true;
+	aUndo_trim(self);
+	return true;
+}
+bool aUndo_recordText(aUndo_t * restrict self, usize line, usize col, const wchar * restrict text, usize len)
+{
+	aUndo_dropRedo(self);
+	// Text continues an insertion, if it starts where the insertion ends
+	const bool extend = self->open && (self->recs[self->num - 1].kind == aukINSERT) &&
+		(line == self->openLine) && (col == self->openCol);
+
+	aUndoRec_t * restrict rec = extend ? &self->recs[self->num - 1] : aUndo_addRec(self);
+	if ((rec == NULL) || !aUndo_reserveText(self, len))
+	{
+		aUndo_clear(self);
+		return false;
+	}
+	else if (!extend)
+	{
+		*rec = (aUndoRec_t){
+			.line = line,
+			.col  = col,
+			.text = self->textEnd,
+			.len  = 0,
+			.kind = aukINSERT
+		};
+	}
+	memcpy(self->text + (self->textEnd - self->textBase), text, sizeof(wchar) * len);
+	self->textEnd += len;
+	rec->len      += len;
+
+	// Insertion ends after the last line break, if there's any
+	usize lastBrk = len;
+	for (usize i = 0; i < len; ++i)
+	{
+		if (text[i] == L'\n')
+		{
+			++line;
+			lastBrk = i;
+		}
+	}
+	self->openLine = line;
+	self->openCol  = (lastBrk == len) ? (col + len) : (len - lastBrk - 1);
+	self->open     = true;
+	aUndo_trim(self);
+	return true;
+}
+void aUndo_seal(aUndo_t * restrict self)
+{
+	self->open = false;
+}
+const aUndoRec_t * aUndo_undo(aUndo_t * restrict self)
+{
+	self->open = false;
+	return (self->cur > self->first) ? &self->recs[--self->cur] : NULL;
+}
+const aUndoRec_t * aUndo_redo(aUndo_t * restrict self)
+{
+	self->open = false;
+	return (self->cur < self->num) ? &self->recs[self->cur++] : NULL;
+}
+const wchar * aUndo_text(const aUndo_t * restrict self, const aUndoRec_t * restrict rec)
+{
+	return self->text + (rec->text - self->textBase);
+}
+usize aUndo_size(const aUndo_t * restrict self)
+{
+	return sizeof(aUndoRec_t) * (self->num - self->first) + sizeof(wchar) * (self->textEnd - self->textFirst);
+}
@@ -0,0 +1,135 @@
+#ifndef ATTO_UNDO_H
+#define ATTO_UNDO_H
+
+#include "aCommon.h"
+
+/*
+	Undo log: an array of records, each standing for a run of text inserted
+	or deleted at a (line, column) position, L'\n' stands for a line break.
+	Texts of all records are kept back-to-back in a single pool.
+
+	An edit right where the previous one of the same kind ended extends
+	its record instead of adding one, until the log is sealed. Backspacing
+	grows a record to the left, its text is kept in reverse.
+
+	recs[first, cur) can be undone, recs[cur, num) redone. Once the log
+	takes up more than its budget, the oldest records are dropped.
+*/
+
+// Default undo log budget in bytes
+#ifndef ATTO_UNDO_BUDGET
+	#define ATTO_UNDO_BUDGET (16 * 1024 * 1024)
+#endif
+
+typedef enum aUndoKind
+{
+	aukINSERT,
+	// Deleted going forward, cursor stays at the start
+	aukDELETE,
+	// Deleted going backward, text is reversed
+	aukBACKSPACE
+
+} aUndoKind_e, auk_e;
+
+typedef struct aUndoRec
+{
+	// Start of the text in the document
+	usize line, col;
+	// Offset of the text & its length in wchar units
+	usize text, len;
+	auk_e kind;
+
+} aUndoRec_t;
+
+typedef struct aUndo
+{
+	aUndoRec_t * recs;
+	usize first, cur, num, maxRecs;
+
+	// Offsets are counted from the start of the log, text[0] is at textBase
+	wchar * text;
+	usize textBase, textFirst, textEnd, maxText;
+
+	usize budget;
+	// Last record can be extended by an edit at (openLine, openCol)
+	bool open;
+	usize openLine, openCol;
+
+} aUndo_t;
+
+/**
+ * @brief Initialises an empty undo log
+ *
+ * @param self Pointer to aUndo_t structure
+ * @param budget Maximum number of bytes taken up by records & their texts
+ */
+void aUndo_init(aUndo_t * restrict self, usize budget);
+/**
+ * @brief Drops all records, frees all memory, keeps the budget
+ *
+ * @param self Pointer to aUndo_t structure
+ */
+void aUndo_clear(aUndo_t * restrict self);
+/**
+ * @brief Records a single character edit, drops records that could be
+ * redone, extends the last record if possible
+ *
+ * @param self Pointer to aUndo_t structure
+ * @param kind Kind of edit
+ * @param line Line of the character
+ * @param col Column of the character, L'\n' is at the end of its line
+ * @param ch Inserted or deleted character
+ * @return true Success
+ * @return false Memory error, log has been cleared
+ */
+bool aUndo_record(aUndo_t * restrict self, auk_e kind, usize line, usize col, wchar ch);
+/**
+ * @brief Records inserted text in time proportional to its length, drops records
+ * that could be redone, extends the last record if possible
+ *
+ * @param self Pointer to aUndo_t structure
+ * @param line Line of the first character
+ * @param col Column of the first character
+ * @param text Pointer to inserted text, L'\n' breaks lines
+ * @param len Number of characters
+ * @return true Success
+ * @return false Memory error, log has been cleared
+ */
+bool aUndo_recordText(aUndo_t * restrict self, usize line, usize col, const wchar * restrict text, usize len);
+/**
+ * @brief Closes the last record, next edit starts a new one
+ *
+ * @param self Pointer to aUndo_t structure
+ */
+void aUndo_seal(aUndo_t * restrict self);
+/**
+ * @brief Steps back by one record, seals the log
+ *
+ * @param self Pointer to aUndo_t structure
+ * @return const aUndoRec_t* Record to revert, NULL if there's nothing to undo
+ */
+const aUndoRec_t * aUndo_undo(aUndo_t * restrict self);
+/**
+ * @brief Steps forward by one record, seals the log
+ *
+ * @param self Pointer to aUndo_t structure
+ * @return const aUndoRec_t* Record to apply again, NULL if there's nothing to redo
+ */
+const aUndoRec_t * aUndo_redo(aUndo_t * restrict self);
+/**
+ * @brief Gets text of a record, valid until the next aUndo_record
+ *
+ * @param self Pointer to aUndo_t structure
+ * @param rec Pointer to record
+ * @return const wchar* Pointer to rec->len characters, reversed for aukBACKSPACE
+ */
+const wchar * aUndo_text(const aUndo_t * restrict self, const aUndoRec_t * restrict rec);
+/**
+ * @brief Calculates memory taken up by the log
+ *
+ * @param self Pointer to aUndo_t structure
+ * @return usize Number of bytes counted against the budget
+ */
+usize aUndo_size(const aUndo_t * restrict self);
+
+#endif
@@ -0,0 +1,440 @@
+#include "aUtf.h"
+
+#if WCHAR_MAX > 0xFFFF
+	#define ATTO_WCHAR_UTF32 1
+#else
+	#define ATTO_WCHAR_UTF32 0
+#endif
+
+// SSE2 is always there on x64, AVX2 is selected at runtime
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+	#define ATTO_UTF_SSE2 1
+#else
+	#define ATTO_UTF_SSE2 0
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	#include <immintrin.h>
+	#define ATTO_UTF_AVX2 1
+	#define ATTO_UTF_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define ATTO_UTF_AVX2 0
+#endif
+
+
+static u32 aUtf_next(const char * restrict src, usize len, usize * restrict pos)
+{
+	const u8 * restrict s = (const u8 *)src;
+	usize i = *pos;
+	const u32 c = s[i];
+	if (c < 0x80)
+	{
+		*pos = i + 1;
+		return c;
+	}
+
+	usize n;
+	u32 cp, min;
+	if ((c & 0xE0) == 0xC0)
+	{
+		n = 1;
+		cp = c & 0x1F;
+		min = 0x80;
+	}
+	else if ((c & 0xF0) == 0xE0)
+	{
+		n = 2;
+		cp = c & 0x0F;
+		min = 0x800;
+	}
+	else if ((c & 0xF8) == 0xF0)
+	{
+		n = 3;
+		cp = c & 0x07;
+		min = 0x10000;
+	}
+	else
+	{
+		*pos = i + 1;
+		return ATTO_UTF_REPLACEMENT;
+	}
+	if ((i + n) >= len)
+	{
+		*pos = i + 1;
+		return ATTO_UTF_REPLACEMENT;
+	}
+	for (usize k = 1; k <= n; ++k)
+	{
+		const u32 cc = s[i + k];
+		if ((cc & 0xC0) != 0x80)
+		{
+			*pos = i + 1;
+			return ATTO_UTF_REPLACEMENT;
+		}
+		cp = (cp << 6) | (cc & 0x3F);
+	}
+	if ((cp < min) || (cp > 0x10FFFF))
+	{
+		*pos = i + 1;
+		return ATTO_UTF_REPLACEMENT;
+	}
+	*pos = i + n + 1;
+	return cp;
+}
+static usize aUtf_put(u32 cp, wchar * restrict out)
+{
+#if ATTO_WCHAR_UTF32 == 0
+	if (cp >= 0x10000)
+	{
+		cp -= 0x10000;
+		out[0] = (wchar)(0xD800 + (cp >> 10));
+		out[1] = (wchar)(0xDC00 + (cp & 0x3FF));
+		return 2;
+	}
+#endif
+	out[0] = (wchar)cp;
+	return 1;
+}
+static usize aUtf_cpLen(u32 cp)
+{
+#if ATTO_WCHAR_UTF32 == 0
+	return (cp >= 0x10000) ? 2 : 1;
+#else
+	(void)cp;
+	return 1;
+#endif
+}
+static u32 aUtf_nextW(const wchar * restrict src, usize len, usize * restrict pos)
+{
+	const u32 c = (u32)src[*pos];
+	++*pos;
+#if ATTO_WCHAR_UTF32 == 0
+	if ((c >= 0xD800) && (c < 0xDC00) && (*pos < len))
+	{
+		const u32 lo = (u32)src[*pos];
+		if ((lo >= 0xDC00) && (lo < 0xE000))
+		{
+			++*pos;
+			return 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+		}
+	}
+#else
+	(void)len;
+#endif
+	return c;
+}
+
+bool aUtf_hasAvx2(void)
+{
+#if ATTO_UTF_AVX2 == 1
+	static int has = -1;
+	if (has == -1)
+	{
+		__builtin_cpu_init();
+		has = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return has == 1;
+#else
+	return false;
+#endif
+}
+
+#if ATTO_UTF_AVX2 == 1
+ATTO_UTF_TARGET_AVX2 static usize aUtf_widenAvx2(const char * restrict src, usize len, wchar * restrict dst)
+{
+	usize i = 0;
+	for (; (i + 32) <= len; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(const void *)(src + i));
+		if (_mm256_movemask_epi8(v) != 0)
+		{
+			break;
+		}
+		else if (dst != NULL)
+		{
+			const __m128i lo = _mm256_castsi256_si128(v), hi = _mm256_extracti128_si256(v, 1);
+	#if ATTO_WCHAR_UTF32 == 1
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i),      _mm256_cvtepu8_epi32(lo));
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i + 8),  _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i + 16), _mm256_cvtepu8_epi32(hi));
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+	#else
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i),      _mm256_cvtepu8_epi16(lo));
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i + 16), _mm256_cvtepu8_epi16(hi));
+	#endif
+		}
+	}
+	return i;
+}
+ATTO_UTF_TARGET_AVX2 static usize aUtf_narrowAvx2(const wchar * restrict src, usize len, char * restrict dst)
+{
+	usize i = 0;
+	for (; (i + 32) <= len; i += 32)
+	{
+		const __m256i * restrict s = (const __m256i *)(const void *)(src + i);
+	#if ATTO_WCHAR_UTF32 == 1
+		const __m256i a = _mm256_loadu_si256(s),     b = _mm256_loadu_si256(s + 1);
+		const __m256i c = _mm256_loadu_si256(s + 2), d = _mm256_loadu_si256(s + 3);
+		const __m256i all = _mm256_or_si256(_mm256_or_si256(a, b), _mm256_or_si256(c, d));
+		if (!_mm256_testz_si256(all, _mm256_set1_epi32(~0x7F)))
+		{
+			break;
+		}
+		else if (dst != NULL)
+		{
+			// Packing works per 128-bit lane, dwords have to be put back in order
+			const __m256i r = _mm256_packus_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+			_mm256_storeu_si256(
+				(__m256i *)(void *)(dst + i),
+				_mm256_permutevar8x32_epi32(r, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7))
+			);
+		}
+	#else
+		const __m256i a = _mm256_loadu_si256(s), b = _mm256_loadu_si256(s + 1);
+		if (!_mm256_testz_si256(_mm256_or_si256(a, b), _mm256_set1_epi16(~0x7F)))
+		{
+			break;
+		}
+		else if (dst != NULL)
+		{
+			_mm256_storeu_si256((__m256i *)(void *)(dst + i), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+		}
+	#endif
+	}
+	return i;
+}
+ATTO_UTF_TARGET_AVX2 static usize aUtf_findEolAvx2(const char * restrict src, usize len)
+{
+	const __m256i cr = _mm256_set1_epi8('\r'), lf = _mm256_set1_epi8('\n');
+	usize i = 0;
+	for (; (i + 32) <= len; i += 32)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(const void *)(src + i));
+		const u32 mask = (u32)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+		if (mask != 0)
+		{
+			return i + (usize)__builtin_ctz(mask);
+		}
+	}
+	return i;
+}
+#endif
+
+static usize aUtf_widen(const char * restrict src, usize len, wchar * restrict dst)
+{
+	// Converts (or only counts, if dst is NULL) leading ASCII bytes
+	usize i = 0;
+#if ATTO_UTF_AVX2 == 1
+	if ((len >= 32) && aUtf_hasAvx2())
+	{
+		i = aUtf_widenAvx2(src, len, dst);
+	}
+#endif
+#if ATTO_UTF_SSE2 == 1
+	const __m128i zero = _mm_setzero_si128();
+	for (; (i + 16) <= len; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+		if (_mm_movemask_epi8(v) != 0)
+		{
+			break;
+		}
+		else if (dst != NULL)
+		{
+			__m128i * restrict d = (__m128i *)(void *)(dst + i);
+			const __m128i lo = _mm_unpacklo_epi8(v, zero), hi = _mm_unpackhi_epi8(v, zero);
+	#if ATTO_WCHAR_UTF32 == 1
+			_mm_storeu_si128(d,     _mm_unpacklo_epi16(lo, zero));
+			_mm_storeu_si128(d + 1, _mm_unpackhi_epi16(lo, zero));
+			_mm_storeu_si128(d + 2, _mm_unpacklo_epi16(hi, zero));
+			_mm_storeu_si128(d + 3, _mm_unpackhi_epi16(hi, zero));
+	#else
+			_mm_storeu_si128(d,     lo);
+			_mm_storeu_si128(d + 1, hi);
+	#endif
+		}
+	}
+#endif
+	for (; (i < len) && ((u8)src[i] < 0x80); ++i)
+	{
+		if (dst != NULL)
+		{
+			dst[i] = (wchar)src[i];
+		}
+	}
+	return i;
+}
+static usize aUtf_narrow(const wchar * restrict src, usize len, char * restrict dst)
+{
+	// Converts (or only counts, if dst is NULL) leading ASCII units
+	usize i = 0;
+#if ATTO_UTF_AVX2 == 1
+	if ((len >= 32) && aUtf_hasAvx2())
+	{
+		i = aUtf_narrowAvx2(src, len, dst);
+	}
+#endif
+#if ATTO_UTF_SSE2 == 1
+	for (; (i + 16) <= len; i += 16)
+	{
+		const __m128i * restrict s = (const __m128i *)(const void *)(src + i);
+	#if ATTO_WCHAR_UTF32 == 1
+		const __m128i a = _mm_loadu_si128(s),     b = _mm_loadu_si128(s + 1);
+		const __m128i c = _mm_loadu_si128(s + 2), d = _mm_loadu_si128(s + 3);
+		const __m128i all = _mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(all, _mm_set1_epi32(~0x7F)), _mm_setzero_si128())) != 0xFFFF)
+		{
+			break;
+		}
+		else if (dst != NULL)
+		{
+			_mm_storeu_si128(
+				(__m128i *)(void *)(dst + i),
+				_mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d))
+			);
+		}
+	#else
+		const __m128i a = _mm_loadu_si128(s), b = _mm_loadu_si128(s + 1);
+		if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16(~0x7F)), _mm_setzero_si128())) != 0xFFFF)
+		{
+			break;
+		}
+		else if (dst != NULL)
+		{
+			_mm_storeu_si128((__m128i *)(void *)(dst + i), _mm_packus_epi16(a, b));
+		}
+	#endif
+	}
+#endif
+	for (; (i < len) && ((u32)src[i] < 0x80); ++i)
+	{
+		if (dst != NULL)
+		{
+			dst[i] = (char)src[i];
+		}
+	}
+	return i;
+}
+
+usize aUtf_findEol(const char * restrict src, usize len)
+{
+	usize i = 0;
+#if ATTO_UTF_AVX2 == 1
+	if ((len >= 32) && aUtf_hasAvx2())
+	{
+		i = aUtf_findEolAvx2(src, len);
+		if ((i < len) && ((src[i] == '\r') || (src[i] == '\n')))
+		{
+			return i;
+		}
+	}
+#endif
+#if (ATTO_UTF_SSE2 == 1) && defined(__GNUC__)
+	const __m128i cr = _mm_set1_epi8('\r'), lf = _mm_set1_epi8('\n');
+	for (; (i + 16) <= len; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)(const void *)(src + i));
+		const u32 mask = (u32)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+		if (mask != 0)
+		{
+			return i + (usize)__builtin_ctz(mask);
+		}
+	}
+#endif
+	while ((i < len) && (src[i] != '\r') && (src[i] != '\n'))
+	{
+		++i;
+	}
+	return i;
+}
+usize aUtf_u8Len(const wchar * restrict src, usize len)
+{
+	usize bytes = 0;
+	for (usize i = 0; i < len;)
+	{
+		if ((u32)src[i] < 0x80)
+		{
+			const usize n = aUtf_narrow(src + i, len - i, NULL);
+			bytes += n;
+			i     += n;
+			continue;
+		}
+		const u32 cp = aUtf_nextW(src, len, &i);
+		bytes += (cp < 0x800) ? 2 : (cp < 0x10000) ? 3 : 4;
+	}
+	return bytes;
+}
+usize aUtf_toU8(const wchar * restrict src, usize len, char * restrict dst)
+{
+	u8 * restrict d = (u8 *)dst;
+	for (usize i = 0; i < len;)
+	{
+		if ((u32)src[i] < 0x80)
+		{
+			const usize n = aUtf_narrow(src + i, len - i, (char *)d);
+			d += n;
+			i += n;
+			continue;
+		}
+		const u32 cp = aUtf_nextW(src, len, &i);
+		if (cp < 0x800)
+		{
+			*d++ = (u8)(0xC0 | (cp >> 6));
+			*d++ = (u8)(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000)
+		{
+			*d++ = (u8)(0xE0 | (cp >> 12));
+			*d++ = (u8)(0x80 | ((cp >> 6) & 0x3F));
+			*d++ = (u8)(0x80 | (cp & 0x3F));
+		}
+		else
+		{
+			*d++ = (u8)(0xF0 | (cp >> 18));
+			*d++ = (u8)(0x80 | ((cp >> 12) & 0x3F));
+			*d++ = (u8)(0x80 | ((cp >> 6) & 0x3F));
+			*d++ = (u8)(0x80 | (cp & 0x3F));
+		}
+	}
+	return (usize)(d - (u8 *)dst);
+}
+usize aUtf_wLen(const char * restrict src, usize len)
+{
+	usize units = 0;
+	for (usize i = 0; i < len;)
+	{
+		if ((u8)src[i] < 0x80)
+		{
+			const usize n = aUtf_widen(src + i, len - i, NULL);
+			units += n;
+			i     += n;
+			continue;
+		}
+		units += aUtf_cpLen(aUtf_next(src, len, &i));
+	}
+	return units;
+}
+usize aUtf_toW(const char * restrict src, usize len, wchar * restrict dst)
+{
+	wchar * restrict d = dst;
+	for (usize i = 0; i < len;)
+	{
+		if ((u8)src[i] < 0x80)
+		{
+			const usize n = aUtf_widen(src + i, len - i, d);
+			d += n;
+			i += n;
+			continue;
+		}
+		d += aUtf_put(aUtf_next(src, len, &i), d);
+	}
+	return (usize)(d - dst);
+}
+usize aUtf_decodeCh(const char * restrict src, usize len, usize * restrict pos, wchar * restrict out)
+{
+	if (*pos >= len)
+	{
+		return 0;
+	}
+	return aUtf_put(aUtf_next(src, len, pos), out);
+}
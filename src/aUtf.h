@@ -0,0 +1,87 @@
+#ifndef ATTO_UTF_H
+#define ATTO_UTF_H
+
+#include "aCommon.h"
+
+/*
+	UTF-8 <-> wchar transcoding helpers. wchar is UTF-16 on Windows and
+	UTF-32 elsewhere, column counts are always in wchar units.
+
+	Invalid UTF-8 bytes decode to U+FFFD, one byte at a time. Unpaired
+	UTF-16 surrogates are encoded as 3-byte sequences, so any wchar string
+	survives a round-trip.
+
+	Runs of ASCII are converted 16 (SSE2) or 32 (AVX2, if the CPU has it)
+	characters at a time, everything else goes through the scalar path.
+*/
+
+#define ATTO_UTF_REPLACEMENT 0xFFFD
+// Maximum number of UTF-8 bytes a single wchar unit can take
+#if WCHAR_MAX > 0xFFFF
+	#define ATTO_UTF_MAX_U8 4
+#else
+	#define ATTO_UTF_MAX_U8 3
+#endif
+
+/**
+ * @brief Checks whether AVX2 code paths can be used, the CPU is queried only once
+ *
+ * @return true AVX2 is compiled in & supported by the CPU
+ * @return false Only SSE2 or scalar code paths can be used
+ */
+bool aUtf_hasAvx2(void);
+/**
+ * @brief Calculates number of UTF-8 bytes needed to encode wchar string
+ *
+ * @param src Pointer to wchar character array
+ * @param len Number of wchar units
+ * @return usize Number of UTF-8 bytes
+ */
+usize aUtf_u8Len(const wchar * restrict src, usize len);
+/**
+ * @brief Encodes wchar string to UTF-8, no null-terminator is added
+ *
+ * @param src Pointer to wchar character array
+ * @param len Number of wchar units
+ * @param dst Pointer to destination, must hold at least aUtf_u8Len bytes
+ * @return usize Number of bytes written
+ */
+usize aUtf_toU8(const wchar * restrict src, usize len, char * restrict dst);
+/**
+ * @brief Calculates number of wchar units needed to decode UTF-8 string
+ *
+ * @param src Pointer to UTF-8 character array
+ * @param len Number of bytes
+ * @return usize Number of wchar units
+ */
+usize aUtf_wLen(const char * restrict src, usize len);
+/**
+ * @brief Decodes UTF-8 string to wchar string, no null-terminator is added
+ *
+ * @param src Pointer to UTF-8 character array
+ * @param len Number of bytes
+ * @param dst Pointer to destination, must hold at least aUtf_wLen units
+ * @return usize Number of wchar units written
+ */
+usize aUtf_toW(const char * restrict src, usize len, wchar * restrict dst);
+/**
+ * @brief Finds first CR or LF byte in UTF-8 string, checks 16 or 32 bytes
+ * at a time
+ *
+ * @param src Pointer to UTF-8 character array
+ * @param len Number of bytes
+ * @return usize Index of first CR or LF, len if there is none
+ */
+usize aUtf_findEol(const char * restrict src, usize len);
+/**
+ * @brief Decodes a single code point from UTF-8 string
+ *
+ * @param src Pointer to UTF-8 character array
+ * @param len Number of bytes in src
+ * @param pos Address of byte position, advanced past the decoded code point
+ * @param out Pointer to destination, must hold at least 2 wchar units
+ * @return usize Number of wchar units written, 0 if *pos >= len
+ */
+usize aUtf_decodeCh(const char * restrict src, usize len, usize * restrict pos, wchar * restrict out);
+
+#endif
@@ -1,4 +1,5 @@
 #include "atto.h"
+#include "aProf.h"
 
 
 i32 min_i32(i32 a, i32 b)
@@ -43,11 +44,16 @@ void atto_exitHandler(void)
 
 const wchar * atto_getFileName(int argc, const wchar * const * const restrict argv)
 {
-	return (argc > 1) ? argv[1] : NULL;
+	const int arg = atto_getPieceTable(argc, argv) ? 2 : 1;
+	return (argc > arg) ? argv[arg] : NULL;
+}
+bool atto_getPieceTable(int argc, const wchar * const * const restrict argv)
+{
+	return (argc > 1) && (wcscmp(argv[1], L"-p") == 0);
 }
 void atto_printHelp(const wchar * restrict app)
 {
-	fwprintf(stderr, L"Correct usage:\n%S [file]\n", app);
+	fwprintf(stderr, L"Correct usage:\n%S [-p] [file]\n  -p  Edit in a piece table instead of lines\n", app);
 }
 
 static const char * atto_errCodes[aerrNUM_OF_ELEMS] = {
@@ -61,457 +67,788 @@ void atto_printErr(aErr_e errCode)
 	fprintf(stderr, "%s\n", atto_errCodes[errCode]);
 }
 
-bool atto_loop(aData_t * restrict peditor)
+void atto_loadStatus(const aFile_t * restrict pfile, const wchar * restrict what, wchar * restrict tempstr)
+{
+	if (aFile_loading(pfile))
+	{
+		swprintf_s(tempstr, MAX_STATUS, L"Loading file... %zu%%", aFile_loadProgress(pfile));
+	}
+	else if (aFile_mixedEol(pfile))
+	{
+		swprintf_s(
+			tempstr,
+			MAX_STATUS,
+			L"File %s, mixed EOL sequences: %zu CRLF, %zu LF, %zu CR, saving as %s%s",
+			what,
+			pfile->eols.crlf,
+			pfile->eols.lf,
+			pfile->eols.cr,
+			(pfile->eolSeq & eolCR) ? L"CR" : L"",
+			(pfile->eolSeq & eolLF) ? L"LF" : L""
+		);
+	}
+	else
+	{
+		swprintf_s(
+			tempstr,
+			MAX_STATUS,
+			L"File %s successfully! %s%s EOL sequences",
+			what,
+			(pfile->eolSeq & eolCR) ? L"CR" : L"",
+			(pfile->eolSeq & eolLF) ? L"LF" : L""
+		);
+	}
+}
+
+bool atto_openJournal(aFile_t * restrict pfile, wchar * restrict tempstr)
+{
+	usize recovered;
+	const wchar * res = aFile_openJournal(pfile, &recovered);
+	if (res != NULL)
+	{
+		wcscpy_s(tempstr, MAX_STATUS, res);
+	}
+	else if (recovered > 0)
+	{
+		swprintf_s(tempstr, MAX_STATUS, L"Recovered %zu edits from journal, save to keep them", recovered);
+	}
+	return (res != NULL) || (recovered > 0);
+}
+
+static void atto_saveStatus(isize saved, wchar * restrict tempstr)
+{
+	switch (saved)
+	{
+	case afwrNOTHING_NEW:
+		wcscpy_s(tempstr, MAX_STATUS, L"Nothing new to save");
+		break;
+	case afwrOPEN_ERROR:
+		wcscpy_s(tempstr, MAX_STATUS, L"File open error!");
+		break;
+	case afwrWRITE_ERROR:
+		wcscpy_s(tempstr, MAX_STATUS, L"File is write-protected!");
+		break;
+	case afwrMEM_ERROR:
+		wcscpy_s(tempstr, MAX_STATUS, L"Memory allocation error!");
+		break;
+	case afwrDISK_CHANGED:
+		wcscpy_s(tempstr, MAX_STATUS, L"File has been changed on disc! Save again to overwrite");
+		break;
+	case afwrSAVING:
+		wcscpy_s(tempstr, MAX_STATUS, L"Saving file...");
+		break;
+	default:
+		swprintf_s(tempstr, MAX_STATUS, L"Wrote %zd bytes", saved);
+	}
+}
+static void atto_pollSave(aData_t * restrict peditor)
+{
+	const isize saved = aFile_pollSave(&peditor->file);
+	if (saved != afwrSAVING)
+	{
+		wchar tempstr[MAX_STATUS];
+		atto_saveStatus(saved, tempstr);
+		aData_statusDraw(peditor, tempstr);
+	}
+}
+static void atto_pollLoad(aData_t * restrict peditor)
 {
 	aFile_t * restrict pfile = &peditor->file;
-	enum specialASCIIcodes
+	wchar tempstr[MAX_STATUS];
+	const wchar * res = aFile_pollLoad(pfile);
+	if (res != NULL)
+	{
+		wcscpy_s(tempstr, MAX_STATUS, res);
+	}
+	else
 	{
-		sacCTRL_Q = 17,
-		sacCTRL_R = 18,
-		sacCTRL_S = 19,
-		sacCTRL_E = 5,
+		atto_loadStatus(pfile, L"loaded", tempstr);
+	}
+	// Loaded lines don't count as changes
+	aData_invalidate(peditor);
+	aData_refresh(peditor);
+	aData_statusDraw(peditor, tempstr);
+}
 
-		sacLAST_CODE = 31
-	};
+typedef struct attoBatch
+{
+	// Whether the frame & status bar have to be drawn after the batch
+	bool refresh, draw;
+	// Characters inserted by the batch
+	usize typed;
+	wchar status[MAX_STATUS];
+	// Typed text not inserted yet
+	wchar text[ATTO_INPUT_BATCH];
+	usize textLen;
+
+} attoBatch_t;
+
+enum specialASCIIcodes
+{
+	sacCTRL_Q = 17,
+	sacCTRL_R = 18,
+	sacCTRL_S = 19,
+	sacCTRL_E = 5,
+	sacCTRL_D = 4,
+	sacCTRL_Z = 26,
+	sacCTRL_Y = 25,
+	sacCTRL_J = 10,
+	sacCTRL_F = 6,
+
+	sacLAST_CODE = 31
+};
 
-	INPUT_RECORD ir;
-	DWORD evRead;
-	if (!ReadConsoleInputW(peditor->conIn, &ir, 1, &evRead) || !evRead)
+static void atto_textFlush(aData_t * restrict peditor, attoBatch_t * restrict batch)
+{
+	// Pasted text goes in at once, a single key still extends the open undo run
+	aFile_t * restrict pfile = &peditor->file;
+	const wchar * restrict text = batch->text;
+	const usize len = batch->textLen;
+	batch->textLen = 0;
+
+	bool ok;
+	if (len == 0)
+	{
+		return;
+	}
+	else if (len == 1)
+	{
+		ok = (text[0] == L'\n') ? aFile_addNewLine(pfile) : aFile_addNormalCh(pfile, text[0]);
+	}
+	else
+	{
+		ok = aFile_insertText(pfile, text, len);
+	}
+	if (ok)
+	{
+		batch->refresh = true;
+		batch->typed  += len;
+	}
+}
+static void atto_textAdd(aData_t * restrict peditor, attoBatch_t * restrict batch, wchar ch)
+{
+	if (batch->textLen == ATTO_INPUT_BATCH)
+	{
+		atto_textFlush(peditor, batch);
+	}
+	batch->text[batch->textLen] = ch;
+	++batch->textLen;
+}
+static void atto_findSet(aData_t * restrict peditor)
+{
+	// Query is compiled as whatever find is looking for
+	peditor->find.error = NULL;
+	if (peditor->find.useRegex)
+	{
+		peditor->find.error = aRegex_compile(&peditor->find.regex, peditor->find.query, peditor->find.len);
+	}
+	else
+	{
+		aFind_set(&peditor->find.needle, peditor->find.query, peditor->find.len);
+	}
+}
+static void atto_findRun(aData_t * restrict peditor, bool skip, attoBatch_t * restrict batch)
+{
+	const bool found = peditor->find.useRegex ?
+		aFile_findRegex(&peditor->file, &peditor->find.regex, skip) :
+		aFile_find(&peditor->file, &peditor->find.needle, skip);
+	const wchar * note = (peditor->find.error != NULL) ? peditor->find.error : (found ? NULL : L"not found");
+	swprintf_s(
+		batch->status,
+		MAX_STATUS,
+		L"%s: %.*s%s%s%s",
+		peditor->find.useRegex ? L"Regex" : L"Find",
+		(int)min_usize(peditor->find.len, MAX_STATUS - 64),
+		peditor->find.query,
+		(note != NULL) ? L" (" : L"",
+		(note != NULL) ? note : L"",
+		(note != NULL) ? L")" : L""
+	);
+	batch->refresh = true;
+	batch->draw    = true;
+}
+static void atto_findStart(aData_t * restrict peditor, attoBatch_t * restrict batch)
+{
+	peditor->find.len    = 0;
+	peditor->find.active = true;
+	peditor->find.show   = true;
+	peditor->find.line   = aFile_curLine(&peditor->file);
+	peditor->find.col    = aFile_curCol(&peditor->file);
+	atto_findSet(peditor);
+
+	aData_invalidate(peditor);
+	wcscpy_s(batch->status, MAX_STATUS, peditor->find.useRegex ? L"Regex: " : L"Find: ");
+	batch->refresh = true;
+	batch->draw    = true;
+}
+static bool atto_findKey(aData_t * restrict peditor, wchar key, wchar wVirtKey, attoBatch_t * restrict batch)
+{
+	aFile_t * restrict pfile = &peditor->file;
+	if (wVirtKey == VK_F3)
 	{
+		atto_findRun(peditor, true, batch);
 		return true;
 	}
-
-	if (ir.EventType == KEY_EVENT)
+	else if ((wVirtKey == VK_RETURN) || (wVirtKey == VK_ESCAPE))
+	{
+		// Escape goes back to where find was started
+		peditor->find.active = false;
+		if (wVirtKey == VK_ESCAPE)
+		{
+			peditor->find.show = false;
+			aFile_gotoLine(pfile, peditor->find.line);
+			aFile_moveCursor(pfile, (isize)peditor->find.col);
+			aData_invalidate(peditor);
+			batch->refresh = true;
+		}
+		wcscpy_s(batch->status, MAX_STATUS, (wVirtKey == VK_ESCAPE) ? L"Find cancelled" : L"Find done, F3 finds the next match");
+		batch->draw = true;
+		return true;
+	}
+	else if (key == sacCTRL_F)
+	{
+		// Switches between literal text & regular expressions
+		peditor->find.useRegex = !peditor->find.useRegex;
+	}
+	else if ((wVirtKey == VK_BACK) && (peditor->find.len > 0))
+	{
+		--peditor->find.len;
+	}
+	else if ((key >= L' ') && (peditor->find.len < ATTO_FIND_MAX))
+	{
+		peditor->find.query[peditor->find.len] = key;
+		++peditor->find.len;
+	}
+	else if ((wVirtKey == VK_BACK) || (key >= L' '))
 	{
-		static wchar prevkey, prevwVirtKey;
+		return true;
+	}
+	else
+	{
+		// Any other key ends find & is handled as usual
+		peditor->find.active = false;
+		peditor->find.show   = false;
+		aData_invalidate(peditor);
+		batch->refresh = true;
+		return false;
+	}
 
-		static u32 keyCount = 1;
-		static bool waitingEnc = false;
+	// Query has changed, search again from where find was started
+	atto_findSet(peditor);
+	aFile_gotoLine(pfile, peditor->find.line);
+	aFile_moveCursor(pfile, (isize)peditor->find.col);
+	aData_invalidate(peditor);
+	atto_findRun(peditor, false, batch);
+	return true;
+}
+static bool atto_key(aData_t * restrict peditor, const KEY_EVENT_RECORD * restrict ev, attoBatch_t * restrict batch)
+{
+	aFile_t * restrict pfile = &peditor->file;
+
+	static wchar prevkey, prevwVirtKey;
+
+	static u32 keyCount = 1;
+	static bool waitingEnc = false;
 
-		wchar key      = ir.Event.KeyEvent.uChar.UnicodeChar;
-		wchar wVirtKey = ir.Event.KeyEvent.wVirtualKeyCode;
-		const bool keydown = ir.Event.KeyEvent.bKeyDown != 0;
+	wchar key      = ev->uChar.UnicodeChar;
+	wchar wVirtKey = ev->wVirtualKeyCode;
+	const bool keydown = ev->bKeyDown != 0;
 
-		if (keydown)
+	if (keydown)
+	{
+		keyCount = ((key == prevkey) && (wVirtKey == prevwVirtKey)) ? (keyCount + 1) : 1;
+
+		// Status message is written only if it's drawn
+		wchar * restrict tempstr = batch->status;
+		bool draw = true;
+
+		// Typed text is inserted before any other key takes effect
+		const bool text = !peditor->find.active && !waitingEnc &&
+			((key > sacLAST_CODE) || ((wVirtKey == VK_RETURN) && (key == L'\r')));
+		if (!text)
 		{
-			keyCount = ((key == prevkey) && (wVirtKey == prevwVirtKey)) ? (keyCount + 1) : 1;
-	
-			wchar tempstr[MAX_STATUS];
-			bool draw = true;
+			atto_textFlush(peditor, batch);
+		}
 
-			if (((wVirtKey == VK_ESCAPE) && (prevwVirtKey != VK_ESCAPE)) || ((key == sacCTRL_Q) && (key != sacCTRL_Q)))	// Exit on Escape or Ctrl+Q
+		if (peditor->find.active && atto_findKey(peditor, key, wVirtKey, batch))	// Typing find query
+		{
+			draw = false;
+		}
+		else if (((wVirtKey == VK_ESCAPE) && (prevwVirtKey != VK_ESCAPE)) || ((key == sacCTRL_Q) && (key != sacCTRL_Q)))	// Exit on Escape or Ctrl+Q
+		{
+			return false;
+		}
+		else if (waitingEnc && (key != sacCTRL_E))
+		{
+			bool done = true;
+			switch (wVirtKey)
 			{
-				return false;
+			// CRLF
+			case L'F':
+				aFile_setEol(pfile, eolCRLF);
+				break;
+			// LF
+			case L'L':
+				aFile_setEol(pfile, eolLF);
+				break;
+			// CR
+			case L'C':
+				aFile_setEol(pfile, eolCR);
+				break;
+			default:
+				wcscpy_s(tempstr, MAX_STATUS, L"Unknown EOL combination!");
+				done = false;
 			}
-			else if (waitingEnc && (key != sacCTRL_E))
+			if (done)
 			{
-				bool done = true;
-				switch (wVirtKey)
-				{
-				// CRLF
-				case L'F':
-					pfile->eolSeq = eolCRLF;
-					break;
-				// LF
-				case L'L':
-					pfile->eolSeq = eolLF;
-					break;
-				// CR
-				case L'C':
-					pfile->eolSeq = eolCR;
-					break;
-				default:
-					wcscpy_s(tempstr, MAX_STATUS, L"Unknown EOL combination!");
-					done = false;
-				}
-				if (done)
-				{
-					swprintf_s(
-						tempstr,
-						MAX_STATUS,
-						L"Using %s%s EOL sequences",
-						(pfile->eolSeq & eolCR) ? L"CR" : L"",
-						(pfile->eolSeq & eolLF) ? L"LF" : L""
-					);
-				}
+				swprintf_s(
+					tempstr,
+					MAX_STATUS,
+					L"Using %s%s EOL sequences",
+					(pfile->eolSeq & eolCR) ? L"CR" : L"",
+					(pfile->eolSeq & eolLF) ? L"LF" : L""
+				);
+			}
 
-				waitingEnc = false;
+			waitingEnc = false;
+		}
+		else if ((key == sacCTRL_R) && (prevkey != sacCTRL_R))	// Reload file
+		{
+			const wchar * res;
+			if ((res = aFile_read(pfile)) != NULL)
+			{
+				wcscpy_s(tempstr, MAX_STATUS, res);
 			}
-			else if ((key == sacCTRL_R) && (prevkey != sacCTRL_R))	// Reload file
+			else if (!atto_openJournal(pfile, tempstr))
 			{
-				const wchar * res;
-				if ((res = aFile_read(pfile)) != NULL)
-				{
-					wcscpy_s(tempstr, MAX_STATUS, res);
-				}
-				else
-				{
-					swprintf_s(
-						tempstr,
-						MAX_STATUS,
-						L"File reloaded successfully! %s%s EOL sequences",
-						(pfile->eolSeq & eolCR) ? L"CR" : L"",
-						(pfile->eolSeq & eolLF) ? L"LF" : L""
-					);
-				}
-				aData_refresh(peditor);
+				atto_loadStatus(pfile, L"reloaded", tempstr);
 			}
-			else if ((key == sacCTRL_S) && (prevkey != sacCTRL_S))	// Save file
+			aData_invalidate(peditor);
+			batch->refresh = true;
+		}
+		else if ((key == sacCTRL_S) && (prevkey != sacCTRL_S))	// Save file
+		{
+			atto_saveStatus(pfile->durableSave ? aFile_startSave(pfile) : aFile_write(pfile), tempstr);
+		}
+		else if ((key == sacCTRL_D) && (prevkey != sacCTRL_D))	// Toggle durable saving
+		{
+			pfile->durableSave = !pfile->durableSave;
+			wcscpy_s(
+				tempstr,
+				MAX_STATUS,
+				pfile->durableSave ? L"Saving through a temporary file in the background" : L"Saving in place"
+			);
+		}
+		else if (key == sacCTRL_Z)	// Undo
+		{
+			if (aFile_undo(pfile))
 			{
-				const isize saved = aFile_write(pfile);
-				switch (saved)
-				{
-				case afwrNOTHING_NEW:
-					wcscpy_s(tempstr, MAX_STATUS, L"Nothing new to save");
-					break;
-				case afwrOPEN_ERROR:
-					wcscpy_s(tempstr, MAX_STATUS, L"File open error!");
-					break;
-				case afwrWRITE_ERROR:
-					wcscpy_s(tempstr, MAX_STATUS, L"File is write-protected!");
-					break;
-				case afwrMEM_ERROR:
-					wcscpy_s(tempstr, MAX_STATUS, L"Memory allocation error!");
-					break;
-				default:
-					swprintf_s(tempstr, MAX_STATUS, L"Wrote %zd bytes", saved);
-				}
+				wcscpy_s(tempstr, MAX_STATUS, L"Undo");
+				batch->refresh = true;
 			}
-			else if ((key == sacCTRL_E) && (prevkey != sacCTRL_E))
+			else
 			{
-				waitingEnc = true;
-				wcscpy_s(tempstr, MAX_STATUS, L"Waiting for EOL combination (F = CRLF, L = LF, C = CR)...");
+				wcscpy_s(tempstr, MAX_STATUS, L"Nothing to undo");
 			}
-			// Normal keys
-			else if (key > sacLAST_CODE)
+		}
+		else if (key == sacCTRL_Y)	// Redo
+		{
+			if (aFile_redo(pfile))
 			{
-				swprintf_s(tempstr, MAX_STATUS, L"'%c' #%u", key, keyCount);
-				if (aFile_addNormalCh(pfile, key))
-				{
-					aData_refresh(peditor);
-				}
+				wcscpy_s(tempstr, MAX_STATUS, L"Redo");
+				batch->refresh = true;
 			}
-			// Special keys
 			else
 			{
-				switch (wVirtKey)
-				{
-				case VK_TAB:
-					if (GetAsyncKeyState(VK_SHIFT) & 0x8000)
-					{
-						wcscpy_s(tempstr, MAX_STATUS, L"\u2191 + 'TAB'");
-						wVirtKey = VK_OEM_BACKTAB;
-						break;
-					}
-					/* fall through */
-				case VK_RETURN:	// Enter key
-				case VK_BACK:	// Backspace
-				case VK_DELETE:	// Delete
-				case VK_LEFT:	// Left arrow
-				case VK_RIGHT:	// Right arrow
-				case VK_UP:		// Up arrow
-				case VK_DOWN:	// Down arrow
+				wcscpy_s(tempstr, MAX_STATUS, L"Nothing to redo");
+			}
+		}
+		else if ((key == sacCTRL_J) && (wVirtKey == 'J') && (prevkey != sacCTRL_J))	// Journal statistics, Ctrl+Enter sends the same code
+		{
+			aJournalStats_t stats;
+			aJournal_stats(&pfile->data.journal, &stats);
+			swprintf_s(
+				tempstr,
+				MAX_STATUS,
+				L"Journal%s: %zu edits, %.2f us/edit; %zu commits, %zu bytes, %.2f ms/commit",
+				stats.failed ? L" (write failed!)" : L"",
+				stats.edits,
+				(stats.timed > 0) ? ((f64)stats.addNs / 1000.0 / (f64)stats.timed) : 0.0,
+				stats.commits,
+				stats.bytes,
+				(stats.commits > 0) ? ((f64)stats.commitNs / 1000000.0 / (f64)stats.commits) : 0.0
+			);
+		}
+		else if ((key == sacCTRL_F) && (prevkey != sacCTRL_F))	// Find
+		{
+			atto_findStart(peditor, batch);
+			draw = false;
+		}
+		else if (wVirtKey == VK_F3)	// Find next
+		{
+			if (peditor->find.len > 0)
+			{
+				peditor->find.show = true;
+				aData_invalidate(peditor);
+				atto_findRun(peditor, true, batch);
+			}
+			draw = false;
+		}
+		else if ((key == sacCTRL_E) && (prevkey != sacCTRL_E))
+		{
+			waitingEnc = true;
+			wcscpy_s(tempstr, MAX_STATUS, L"Waiting for EOL combination (F = CRLF, L = LF, C = CR)...");
+		}
+		// Normal keys
+		else if (key > sacLAST_CODE)
+		{
+			swprintf_s(tempstr, MAX_STATUS, L"'%c' #%u", key, keyCount);
+			atto_textAdd(peditor, batch, key);
+		}
+		// Special keys
+		else
+		{
+			switch (wVirtKey)
+			{
+			case VK_TAB:
+				if (GetAsyncKeyState(VK_SHIFT) & 0x8000)
 				{
-					static const wchar * buf[] = {
-						[VK_TAB]    = L"'TAB'",
-						[VK_RETURN] = L"'RET'",
-						[VK_BACK]   = L"'BS'",
-						[VK_DELETE] = L"'DEL'",
-						[VK_LEFT]   = L"\u2190",
-						[VK_RIGHT]  = L"\u2192",
-						[VK_UP]     = L"\u2191",
-						[VK_DOWN]   = L"\u2193"
-					};
-					wcscpy_s(tempstr, MAX_STATUS, buf[wVirtKey]);
-					break;
-				}
-				case VK_CAPITAL:
-					wcscpy_s(tempstr, MAX_STATUS, (GetKeyState(VK_CAPITAL) & 0x0001) ? L"'CAPS' On" : L"'CAPS' Off");
-					break;
-				case VK_NUMLOCK:
-					wcscpy_s(tempstr, MAX_STATUS, (GetKeyState(VK_NUMLOCK) & 0x0001) ? L"'NUMLOCK' On" : L"'NUMLOCK' Off");
-					break;
-				case VK_SCROLL:
-					wcscpy_s(tempstr, MAX_STATUS, (GetKeyState(VK_SCROLL) & 0x0001) ? L"'SCRLOCK' On" : L"'SCRLOCK' Off");
+					wcscpy_s(tempstr, MAX_STATUS, L"\u2191 + 'TAB'");
+					wVirtKey = VK_OEM_BACKTAB;
 					break;
-				default:
-					draw = false;
 				}
+				/* fall through */
+			case VK_RETURN:	// Enter key
+			case VK_BACK:	// Backspace
+			case VK_DELETE:	// Delete
+			case VK_LEFT:	// Left arrow
+			case VK_RIGHT:	// Right arrow
+			case VK_UP:		// Up arrow
+			case VK_DOWN:	// Down arrow
+			{
+				static const wchar * buf[] = {
+					[VK_TAB]    = L"'TAB'",
+					[VK_RETURN] = L"'RET'",
+					[VK_BACK]   = L"'BS'",
+					[VK_DELETE] = L"'DEL'",
+					[VK_LEFT]   = L"\u2190",
+					[VK_RIGHT]  = L"\u2192",
+					[VK_UP]     = L"\u2191",
+					[VK_DOWN]   = L"\u2193"
+				};
+				wcscpy_s(tempstr, MAX_STATUS, buf[wVirtKey]);
+				break;
+			}
+			case VK_CAPITAL:
+				wcscpy_s(tempstr, MAX_STATUS, (GetKeyState(VK_CAPITAL) & 0x0001) ? L"'CAPS' On" : L"'CAPS' Off");
+				break;
+			case VK_NUMLOCK:
+				wcscpy_s(tempstr, MAX_STATUS, (GetKeyState(VK_NUMLOCK) & 0x0001) ? L"'NUMLOCK' On" : L"'NUMLOCK' Off");
+				break;
+			case VK_SCROLL:
+				wcscpy_s(tempstr, MAX_STATUS, (GetKeyState(VK_SCROLL) & 0x0001) ? L"'SCRLOCK' On" : L"'SCRLOCK' Off");
+				break;
+			default:
+				draw = false;
+			}
 
-				if (aFile_addSpecialCh(pfile, wVirtKey))
-				{
-					aData_refresh(peditor);
-				}
+			if (text)
+			{
+				atto_textAdd(peditor, batch, L'\n');
 			}
-			
-			if (draw)
+			else if (aFile_addSpecialCh(pfile, wVirtKey))
 			{
-				aData_statusDraw(peditor, tempstr);
+				batch->refresh = true;
+				batch->typed += (wVirtKey == VK_TAB) ? 1 : 0;
 			}
 		}
-		else
-		{
-			key = wVirtKey = 0;
-		}
-
-		prevkey = key;
-		prevwVirtKey = wVirtKey;
+		
+		batch->draw = batch->draw || draw;
+	}
+	else
+	{
+		key = wVirtKey = 0;
 	}
 
+	prevkey = key;
+	prevwVirtKey = wVirtKey;
+
 	return true;
 }
-void atto_updateScrbuf(aData_t * restrict peditor)
+bool atto_loop(aData_t * restrict peditor)
 {
 	aFile_t * restrict pfile = &peditor->file;
-	aFile_updateCury(pfile, peditor->scrbuf.h - 2);
-	isize delta = (isize)pfile->data.currentNode->curx - (isize)peditor->scrbuf.w - (isize)pfile->data.curx;
-	if (delta >= 0)
-	{
-		pfile->data.curx += (usize)(delta + 1);
-	}
-	else if (pfile->data.curx > pfile->data.currentNode->curx)
+
+	// Take in lines of a file, that's still loading
+	if (aFile_loading(pfile))
 	{
-		pfile->data.curx = max_usize(1, pfile->data.currentNode->curx) - 1;
+		atto_pollLoad(peditor);
 	}
-	for (usize i = 0, size = (usize)peditor->scrbuf.w * (usize)peditor->scrbuf.h; i < size; ++i)
+	if (aFile_saving(pfile))
 	{
-		peditor->scrbuf.mem[i] = L' ';
+		atto_pollSave(peditor);
 	}
-	aLine_t * node = pfile->data.pcury;
-	for (u32 i = 0, h1 = peditor->scrbuf.h - 1; i < h1 && node != NULL; ++i)
+
+	// Do housekeeping while user is idle
+	const bool busy = aFile_loading(pfile) || aFile_saving(pfile);
+	if (WaitForSingleObject(peditor->conIn, busy ? ATTO_LOAD_POLL_MS : ATTO_IDLE_MS) == WAIT_TIMEOUT)
 	{
-		// if line is active line
-		if (node == pfile->data.currentNode)
+		if (aFile_loading(pfile))
 		{
-			// Update cursor position
-			peditor->cursorpos = (COORD){
-				.X = (SHORT)min_usize(node->curx - pfile->data.curx, (usize)peditor->scrbuf.w - 1),
-				.Y = (SHORT)i
-			};
-			SetConsoleCursorPosition(peditor->scrbuf.handle, peditor->cursorpos);
+			return true;
 		}
-		wchar * restrict destination = &peditor->scrbuf.mem[(usize)i * (usize)peditor->scrbuf.w];
-
-		// Drawing
-
-		// Advance idx by file.data.curx
-		usize idx = 0;
-		for (usize j = pfile->data.curx; j > 0 && idx < node->lineEndx;)
+		// Pause in typing ends an undo record
+		if (!busy)
 		{
-			if (idx == node->curx && node->freeSpaceLen > 0)
-			{
-				idx += node->freeSpaceLen;
-				continue;
-			}
-			++idx;
-			--j;
+			aFile_sealUndo(pfile);
 		}
-		for (usize j = 0; idx < node->lineEndx && j < peditor->scrbuf.w;)
+
+		const usize reclaimed = aFile_compact(pfile);
+		if (reclaimed > 0)
 		{
-			if (idx == node->curx && node->freeSpaceLen > 0)
-			{
-				idx += node->freeSpaceLen;
-				continue;
-			}
-			destination[j] = node->line[idx];
-			++idx;
-			++j;
+			wchar tempstr[MAX_STATUS];
+			swprintf_s(tempstr, MAX_STATUS, L"Reclaimed %zu bytes of line memory", reclaimed);
+			aData_statusDraw(peditor, tempstr);
 		}
-
-		node = node->nextNode;
+		return true;
 	}
-}
 
-u32 atto_toutf16(const char * restrict utf8, int numBytes, wchar ** restrict putf16, usize * restrict sz)
-{
-	// Query the needed size
-	const u32 size = (numBytes == 0) ? 1 : (u32)MultiByteToWideChar(
-		CP_UTF8,
-		MB_PRECOMPOSED,
-		utf8,
-		numBytes,
-		NULL,
-		0
-	);
-	// Try to allocate memory
-	if ((sz != NULL) && (*sz < (usize)size))
+	// All pending input is applied before drawing once, pasted text would
+	// otherwise redraw the screen after every character
+	attoBatch_t batch = {
+		.refresh = false,
+		.draw    = false,
+		.typed   = 0,
+		.textLen = 0
+	};
+	const i64 start = aProf_now();
+	INPUT_RECORD irs[ATTO_INPUT_BATCH];
+	DWORD evRead, evPending;
+	do
 	{
-		vptr mem = realloc(*putf16, (usize)size * sizeof(wchar));
-		if (mem == NULL)
+		if (!ReadConsoleInputW(peditor->conIn, irs, ATTO_INPUT_BATCH, &evRead))
 		{
-			return 0;
+			break;
 		}
-		*putf16 = mem;
-		*sz     = (usize)size;
-	}
-	else if ((*putf16 == NULL) || (sz == NULL))
-	{
-		*putf16 = malloc((usize)size * sizeof(wchar));
-		if (*putf16 == NULL)
+		for (DWORD i = 0; i < evRead; ++i)
 		{
-			return 0;
+			if ((irs[i].EventType == KEY_EVENT) && !atto_key(peditor, &irs[i].Event.KeyEvent, &batch))
+			{
+				return false;
+			}
 		}
-	}
+	} while (GetNumberOfConsoleInputEvents(peditor->conIn, &evPending) && (evPending > 0));
+	atto_textFlush(peditor, &batch);
 
-	if (numBytes != 0)
+	if (batch.refresh)
+	{
+		aData_refresh(peditor);
+	}
+	if (batch.typed >= ATTO_PASTE_MIN)
 	{
-		// Make conversion
-		MultiByteToWideChar(
-			CP_UTF8,
-			MB_PRECOMPOSED,
-			utf8,
-			numBytes,
-			*putf16,
-			(int)size
+		const i64 ns = aProf_now() - start;
+		const f64 secs = (f64)((ns > 0) ? ns : 1) / 1000000000.0;
+		swprintf_s(
+			batch.status,
+			MAX_STATUS,
+			L"Pasted %zu characters in %.2f ms, %.0f chars/s",
+			batch.typed,
+			secs * 1000.0,
+			(f64)batch.typed / secs
 		);
+		batch.draw = true;
 	}
-	else
+	if (batch.draw)
 	{
-		(*putf16)[0] = L'\0';
+		aData_statusDraw(peditor, batch.status);
 	}
-	return size;
-}
-u32 atto_toutf8(const wchar * restrict utf16, int numChars, char ** restrict putf8, usize * restrict sz)
-{
-	const u32 size = (numChars == 0) ? 1 : (u32)WideCharToMultiByte(
-		CP_UTF8,
-		0,
-		utf16,
-		numChars,
-		NULL,
-		0,
-		NULL,
-		NULL
-	);
 
-	// Alloc mem
-	if ((sz != NULL) && (*sz < size))
+	return true;
+}
+static void atto_highlight(aData_t * restrict peditor, aLine_t * restrict node, u8 * restrict attr)
+{
+	aFile_t * restrict pfile = &peditor->file;
+	const aFind_t * restrict needle = &peditor->find.needle;
+	const usize left = pfile->data.curx, right = left + peditor->scrbuf.w;
+	usize col, colEnd;
+	// Line is given to the regular expression once, it's then searched on
+	if (peditor->find.useRegex && !aLine_setRegex(node, &peditor->find.regex))
 	{
-		vptr mem = realloc(*putf8, (usize)size * sizeof(char));
-		if (mem == NULL)
-		{
-			return 0;
-		}
-		*putf8 = mem;
-		*sz    = size;
+		return;
 	}
-	else if ((*putf8 == NULL) || (sz == NULL))
+	for (usize from = 0;; from = (colEnd > col) ? colEnd : (col + 1))
 	{
-		*putf8 = malloc((usize)size * sizeof(char));
-		if (*putf8 == NULL)
+		if (peditor->find.useRegex ?
+			!aRegex_find(&peditor->find.regex, from, &col, &colEnd) :
+			!aLine_find(node, needle, from, &col))
 		{
-			return 0;
+			break;
 		}
-	}
+		colEnd = peditor->find.useRegex ? colEnd : (col + needle->wlen);
 
-	// Convert
-	if (numChars != 0)
-	{
-		WideCharToMultiByte(
-			CP_UTF8,
-			0,
-			utf16,
-			numChars,
-			*putf8,
-			(int)size,
-			NULL,
-			NULL
-		);
-	}
-	else
-	{
-		(*putf8)[0] = '\0';
+		const usize start = aLine_toScreenCol(&pfile->data.arena, node, col);
+		if (start >= right)
+		{
+			break;
+		}
+		const usize end = min_usize(aLine_toScreenCol(&pfile->data.arena, node, colEnd), right);
+		for (usize x = max_usize(start, left); x < end; ++x)
+		{
+			attr[x - left] = asaMATCH;
+		}
 	}
-	return size;
 }
-usize atto_strnToLines(wchar * restrict utf16, usize chars, wchar *** restrict lines, eolSeq_e * restrict eolSeq)
+static void atto_highlightText(aData_t * restrict peditor, const wchar * restrict text, usize len, u8 * restrict attr)
 {
-	// Count number of newline characters (to count number of lines - 1)
-	usize newlines = 1;
-	
-	// Set default EOL sequence
-	*eolSeq = eolDEF;
-	for (usize i = 0; i < chars; ++i)
+	// Same as atto_highlight, for a line fetched from a piece table
+	const aFind_t * restrict needle = &peditor->find.needle;
+	const usize left = peditor->file.data.curx, right = left + peditor->scrbuf.w;
+	usize col, colEnd;
+	if (peditor->find.useRegex && !aRegex_setLineW(&peditor->find.regex, text, len, text + len, 0))
 	{
-		if (utf16[i] == L'\r')
+		return;
+	}
+	for (usize from = 0;; from = (colEnd > col) ? colEnd : (col + 1))
+	{
+		if (peditor->find.useRegex ?
+			!aRegex_find(&peditor->find.regex, from, &col, &colEnd) :
+			!aLine_textFind(text, len, needle, from, &col))
 		{
-			*eolSeq = ((i + 1 < chars) && (utf16[i+1] == L'\n')) ? eolCRLF : eolCR;
-			++newlines;
-			i += (*eolSeq == eolCRLF);
+			break;
 		}
-		else if (utf16[i] == L'\n')
+		colEnd = peditor->find.useRegex ? colEnd : (col + needle->wlen);
+
+		const usize start = aLine_textToScreenCol(text, len, col);
+		if (start >= right)
 		{
-			*eolSeq = eolLF;
-			++newlines;
+			break;
+		}
+		const usize end = min_usize(aLine_textToScreenCol(text, len, colEnd), right);
+		for (usize x = max_usize(start, left); x < end; ++x)
+		{
+			attr[x - left] = asaMATCH;
 		}
 	}
-	*lines = malloc(newlines * sizeof(wchar *));
-	if (*lines == NULL)
+}
+static void atto_scroll(aData_t * restrict peditor, usize cursorCol)
+{
+	// Scrolling works in screen columns, tabs take up more than one
+	aFile_t * restrict pfile = &peditor->file;
+	isize delta = (isize)cursorCol - (isize)peditor->scrbuf.w - (isize)pfile->data.curx;
+	if (delta >= 0)
+	{
+		pfile->data.curx += (usize)(delta + 1);
+	}
+	else if (pfile->data.curx > cursorCol)
 	{
-		return 0;
+		pfile->data.curx = max_usize(1, cursorCol) - 1;
 	}
+}
+static void atto_updatePieces(aData_t * restrict peditor)
+{
+	// Rows are fetched from the piece table & drawn again every frame
+	aFile_t * restrict pfile = &peditor->file;
+	aFile_updateCury(pfile, peditor->scrbuf.h - 2);
+	const usize cur = aFile_curLine(pfile), top = pfile->data.ptTop;
+	usize len;
+	const wchar * restrict text = aFile_pieceLine(pfile, cur, &len);
+	const usize cursorCol = (text != NULL) ? aLine_textToScreenCol(text, len, aFile_curCol(pfile)) : 0;
+	atto_scroll(peditor, cursorCol);
+	peditor->cursorpos = (COORD){
+		.X = (SHORT)min_usize(cursorCol - pfile->data.curx, (usize)peditor->scrbuf.w - 1),
+		.Y = (SHORT)(cur - top)
+	};
 
-	bool isCRLF = (*eolSeq == eolCRLF);
-	usize starti = 0, j = 0;
-	for (usize i = 0; i < chars; ++i)
+	const u32 h1 = peditor->scrbuf.h - 1;
+	for (u32 i = 0; i < h1; ++i)
 	{
-		if (utf16[i] == L'\n' || utf16[i] == L'\r')
+		wchar * restrict destination = &peditor->scrbuf.mem[(usize)i * (usize)peditor->scrbuf.w];
+		u8 * restrict attr = &peditor->scrbuf.attr[(usize)i * (usize)peditor->scrbuf.w];
+		memset(attr, asaNORMAL, sizeof(u8) * peditor->scrbuf.w);
+
+		usize cols = 0;
+		text = ((top + i) < pfile->data.ptable.totalLines) ? aFile_pieceLine(pfile, top + i, &len) : NULL;
+		if (text != NULL)
 		{
-			utf16[i] = L'\0';
-			(*lines)[j] = &utf16[starti];
-			starti = i + 1 + isCRLF;
-			i += isCRLF;
-			++j;
+			cols = aLine_textScreenCols(text, len, pfile->data.curx, destination, peditor->scrbuf.w);
+			if (peditor->find.show)
+			{
+				atto_highlightText(peditor, text, len, attr);
+			}
+		}
+		for (usize j = cols; j < peditor->scrbuf.w; ++j)
+		{
+			destination[j] = L' ';
 		}
 	}
-	(*lines)[j] = &utf16[starti];
-
-	return newlines;
 }
-usize atto_tabsToSpaces(wchar ** restrict str, usize * restrict len)
+void atto_updateScrbuf(aData_t * restrict peditor)
 {
-	usize realLen = (((len == NULL) || (*len == 0)) ? (wcslen(*str) + 1) : *len), realCap = realLen;
+	aFile_t * restrict pfile = &peditor->file;
+	if (pfile->pieceTable)
+	{
+		atto_updatePieces(peditor);
+		return;
+	}
+	aFile_updateCury(pfile, peditor->scrbuf.h - 2);
+	const usize cursorCol = aLine_toScreenCol(&pfile->data.arena, pfile->data.currentNode, pfile->data.currentNode->curx);
+	atto_scroll(peditor, cursorCol);
 
-	// Conversion happens here
-	wchar * restrict s = *str;
+	// Same view & only one line edited since the last frame: just its row is drawn again,
+	// nothing is drawn if only the cursor has moved
+	const bool sameView = peditor->drawn.valid && (peditor->drawn.pcury == pfile->data.pcury) && (peditor->drawn.curx == pfile->data.curx);
+	const aLine_t * edited = sameView ? aFile_editedLine(pfile, peditor->drawn.gen) : NULL;
+	const bool drawAll = !sameView || ((edited == NULL) && (peditor->drawn.gen != pfile->gen));
 
-	for (usize i = 0; i < realLen;)
+	aLine_t * node = pfile->data.pcury;
+	u32 i = 0;
+	const u32 h1 = peditor->scrbuf.h - 1;
+	for (; i < h1 && node != NULL; ++i)
 	{
-		if (s[i] == L'\t')
+		// if line is active line
+		if (node == pfile->data.currentNode)
 		{
-			if ((realLen + 3) > realCap)
+			// Update cursor position
+			peditor->cursorpos = (COORD){
+				.X = (SHORT)min_usize(cursorCol - pfile->data.curx, (usize)peditor->scrbuf.w - 1),
+				.Y = (SHORT)i
+			};
+		}
+		if (drawAll || (node == edited))
+		{
+			wchar * restrict destination = &peditor->scrbuf.mem[(usize)i * (usize)peditor->scrbuf.w];
+
+			// Drawing
+			const usize cols = aLine_getScreenCols(&pfile->data.arena, node, pfile->data.curx, destination, peditor->scrbuf.w);
+			for (usize j = cols; j < peditor->scrbuf.w; ++j)
 			{
-				realCap = (realLen + 3) * 2;
-				s = realloc(s, sizeof(wchar) * realCap);
-				if (s == NULL)
-				{
-					return 0;
-				}
+				destination[j] = L' ';
 			}
-			memmove(&s[i + 3], &s[i], sizeof(wchar) * (realLen - i));
-			for (u8 j = 0; j < 4; ++i, ++j)
+
+			// Find matches
+			u8 * restrict attr = &peditor->scrbuf.attr[(usize)i * (usize)peditor->scrbuf.w];
+			memset(attr, asaNORMAL, sizeof(u8) * peditor->scrbuf.w);
+			if (peditor->find.show)
 			{
-				s[i] = L' ';
+				atto_highlight(peditor, node, attr);
 			}
-			realLen += 3;
 		}
-		else
-		{
-			++i;
-		}
-	}
 
-	*str = s;
-	// Shrink string
-	s = realloc(s, sizeof(wchar) * realLen);
-	if (s != NULL)
-	{
-		*str = s;
+		// Lines below the screen are left as they are
+		node = ((i + 1) < h1) ? aFile_nextLine(pfile, node) : NULL;
 	}
-	
-	if (len != NULL)
+	// Rows past the last line
+	if (drawAll)
 	{
-		*len = realLen;
+		for (usize j = (usize)i * (usize)peditor->scrbuf.w, end = (usize)h1 * (usize)peditor->scrbuf.w; j < end; ++j)
+		{
+			peditor->scrbuf.mem[j]  = L' ';
+			peditor->scrbuf.attr[j] = asaNORMAL;
+		}
 	}
-	return realLen;
+
+	peditor->drawn.pcury = pfile->data.pcury;
+	peditor->drawn.curx  = pfile->data.curx;
+	peditor->drawn.gen   = pfile->gen;
+	peditor->drawn.valid = true;
 }
@@ -5,6 +5,14 @@
 #include "aData.h"
 
 #define MAX_STATUS 256
+// Milliseconds without input, after which idle tasks are run
+#define ATTO_IDLE_MS 500
+// Background loading & saving is checked on this often
+#define ATTO_LOAD_POLL_MS 20
+// Input events read at once, all pending events are handled before drawing
+#define ATTO_INPUT_BATCH 256
+// Batches inserting at least this many characters report paste throughput
+#define ATTO_PASTE_MIN 32
 
 
 i32 min_i32(i32 a, i32 b);
@@ -28,13 +36,22 @@ void atto_exitHandlerSetVars(aData_t * restrict pdata);
 void atto_exitHandler(void);
 
 /**
- * @brief Gets file name from argument vector
+ * @brief Gets file name from argument vector, options come before it
  * 
  * @param argc Argument vector count
  * @param argv Wide-stringed argument vector
  * @return const wchar* File name argument
  */
 const wchar * atto_getFileName(int argc, const wchar * const * const restrict argv);
+/**
+ * @brief Checks argument vector for the piece-table engine option (-p)
+ * 
+ * @param argc Argument vector count
+ * @param argv Wide-stringed argument vector
+ * @return true Document is edited in a piece table
+ * @return false Document is edited in line nodes
+ */
+bool atto_getPieceTable(int argc, const wchar * const * const restrict argv);
 void atto_printHelp(const wchar * restrict app);
 
 typedef enum aErr
@@ -52,6 +69,25 @@ typedef enum aErr
  * @param errCode Error code
  */
 void atto_printErr(aErr_e errCode);
+/**
+ * @brief Generates status message after file has been loaded, reports
+ * mixed EOL sequences
+ * 
+ * @param pfile Pointer to aFile_t structure
+ * @param what Action performed, e.g. L"loaded"
+ * @param tempstr Pointer to receiving character array, at least MAX_STATUS characters
+ */
+void atto_loadStatus(const aFile_t * restrict pfile, const wchar * restrict what, wchar * restrict tempstr);
+/**
+ * @brief Starts journaling edits of a (re)loaded file, recovers edits of a
+ * session that didn't exit cleanly
+ * 
+ * @param pfile Pointer to aFile_t structure
+ * @param tempstr Pointer to receiving character array, at least MAX_STATUS characters
+ * @return true Status message has been generated
+ * @return false Nothing to report
+ */
+bool atto_openJournal(aFile_t * restrict pfile, wchar * restrict tempstr);
 /**
  * @brief Performs text editor loop tasks
  * 
@@ -67,49 +103,4 @@ bool atto_loop(aData_t * restrict pdata);
  */
 void atto_updateScrbuf(aData_t * restrict peditor);
 
-/**
- * @brief Convert UTF-8 string to UTF-16 string, allocates memory only if
- * *putf16 is too small or sz == NULL
- * 
- * @param utf8 Pointer to UTF-8 character array
- * @param numBytes Maximum number of bytes to convert (including null-terminator)
- * @param putf16 Address of wchar pointer, the pointer itself can be initally NULL
- * @param sz Address of UTF-16 array size, can be NULL
- * @return u32 Number of characters converted
- */
-u32 atto_toutf16(const char * restrict utf8, int numBytes, wchar ** restrict putf16, usize * restrict sz);
-/**
- * @brief Convert UTF-16 string to UTF-8 string, allocates memory only if
- * *putf8 is too small or sz == NULL
- * 
- * @param utf16 Pointer to UTF-16 character array
- * @param numChars Maximum number of bytes to convert (including null-terminator)
- * @param putf8 Address of char pointer, the pointer itself can be initally NULL
- * @param sz Address of UTF-8 array size, can be NULL
- * @return u32 Number of characters converted
- */
-u32 atto_toutf8(const wchar * restrict utf16, int numChars, char ** restrict putf8, usize * restrict sz);
-/**
- * @brief Convert UTF-16 string to lines array, modifies original string. After
- * creation the double-pointer's "lines" can be safely freed with a single free.
- * It's just an array of pointer pointing to parts of the original string
- * 
- * @param utf16 Pointer to UTF-16 character array
- * @param chars Maximum number of bytes to scan
- * @param lines Address of wchar double-pointer, double-pointer hosts wchar
- * pointer array, where each pointer is a character array representing line in the text file.
- * Initial value of double-pointer is irrelevant
- * @param eolSeq Address of eolSequence enumerator, receives the EOL format used
- * @return usize Number of lines found
- */
-usize atto_strnToLines(wchar * restrict utf16, usize chars, wchar *** restrict lines, eolSeq_e * restrict eolSeq);
-/**
- * @brief Converts all tabs in string to spaces, modifies original string
- * 
- * @param str Address of a pointer to UTF-16 character array
- * @param len Address of string length (including null-terminator), can be NULL
- * @return usize New length of converted string (including null-terminator), same as *len, if len != NULL
- */
-usize atto_tabsToSpaces(wchar ** restrict str, usize * restrict len);
-
 #endif
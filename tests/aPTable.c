@@ -0,0 +1,310 @@
+#include "../src/aPTable.h"
+
+/*
+	Headless test of the piece-table engine: random edits are applied to the
+	table & to a plain character array, both have to hold the same text,
+	lines & cursor after every edit. Build with "make test".
+*/
+
+#define TEST_ROUNDS 1500
+#define TEST_MAX_LEN 512
+
+static usize test_failures = 0;
+
+#define TEST_CHECK(cond) do { \
+	if (!(cond)) \
+	{ \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+		++test_failures; \
+		return false; \
+	} \
+} while (0)
+
+typedef struct testModel
+{
+	wchar text[TEST_MAX_LEN];
+	usize len, cursor;
+
+} testModel_t;
+
+static u32 test_seed = 12345;
+static usize test_rand(usize n)
+{
+	test_seed = test_seed * 1103515245u + 12345u;
+	return (usize)(test_seed >> 8) % n;
+}
+
+static void testModel_insert(testModel_t * restrict m, usize pos, wchar ch)
+{
+	memmove(m->text + pos + 1, m->text + pos, sizeof(wchar) * (m->len - pos));
+	m->text[pos] = ch;
+	++m->len;
+}
+static void testModel_erase(testModel_t * restrict m, usize pos, usize len)
+{
+	memmove(m->text + pos, m->text + pos + len, sizeof(wchar) * (m->len - pos - len));
+	m->len -= len;
+}
+static usize testModel_eolLen(const testModel_t * restrict m, usize pos)
+{
+	if ((pos < m->len) && (m->text[pos] == L'\n'))
+	{
+		return 1;
+	}
+	return (((pos + 1) < m->len) && (m->text[pos] == L'\r') && (m->text[pos + 1] == L'\n')) ? 2 : 0;
+}
+static usize testModel_lineStart(const testModel_t * restrict m, usize line)
+{
+	usize pos = 0;
+	for (; (line > 0) && (pos < m->len); ++pos)
+	{
+		line -= (m->text[pos] == L'\n') ? 1 : 0;
+	}
+	return pos;
+}
+static usize testModel_lineLen(const testModel_t * restrict m, usize start)
+{
+	// Without EOL characters, trailing L'\r' is stripped as by aPTable_getLine
+	usize len = 0;
+	while (((start + len) < m->len) && (m->text[start + len] != L'\n'))
+	{
+		++len;
+	}
+	return ((len > 0) && (m->text[start + len - 1] == L'\r')) ? (len - 1) : len;
+}
+static usize testModel_lines(const testModel_t * restrict m)
+{
+	usize lines = 1;
+	for (usize i = 0; i < m->len; ++i)
+	{
+		lines += (m->text[i] == L'\n') ? 1 : 0;
+	}
+	return lines;
+}
+
+static bool test_same(const aPTable_t * restrict pt, const testModel_t * restrict m, const wchar * restrict orig, usize origLen)
+{
+	TEST_CHECK(pt->totalLen == m->len);
+	TEST_CHECK(pt->cursor == m->cursor);
+	TEST_CHECK(pt->totalLines == testModel_lines(m));
+	// Original text is never written to
+	TEST_CHECK(pt->orig.len == origLen);
+	TEST_CHECK((origLen == 0) || (memcmp(pt->orig.mem, orig, sizeof(wchar) * origLen) == 0));
+
+	wchar * text = aPTable_getText(pt);
+	TEST_CHECK(text != NULL);
+	const bool sameText = (memcmp(text, m->text, sizeof(wchar) * m->len) == 0) && (text[m->len] == L'\0');
+	free(text);
+	TEST_CHECK(sameText);
+
+	wchar * line = NULL;
+	usize lineCap = 0;
+	bool ok = true;
+	for (usize i = 0, lines = pt->totalLines; ok && (i < lines); ++i)
+	{
+		const usize start = testModel_lineStart(m, i), len = testModel_lineLen(m, start);
+
+		ok = aPTable_getLine(pt, i, &line, &lineCap) &&
+			(aPTable_lineStart(pt, i) == start) &&
+			(aPTable_lineLen(pt, i) == len) &&
+			(wcslen(line) == len) &&
+			(memcmp(line, m->text + start, sizeof(wchar) * len) == 0);
+	}
+	free(line);
+	TEST_CHECK(ok);
+
+	const usize curLine = aPTable_curLine(pt);
+	TEST_CHECK(aPTable_lineOf(pt, m->cursor) == curLine);
+	TEST_CHECK(aPTable_curCol(pt) == (m->cursor - testModel_lineStart(m, curLine)));
+	return true;
+}
+
+static bool test_edit(aPTable_t * restrict pt, testModel_t * restrict m)
+{
+	static const wchar chars[] = L"abc xyz\té中";
+	switch (test_rand(7))
+	{
+	case 0:
+	case 1:
+	{
+		const wchar ch = chars[test_rand((sizeof chars / sizeof *chars) - 1)];
+		if ((m->len + 1) >= TEST_MAX_LEN)
+		{
+			break;
+		}
+		TEST_CHECK(aPTable_addNormalCh(pt, ch));
+		testModel_insert(m, m->cursor, ch);
+		++m->cursor;
+		break;
+	}
+	case 2:
+		if ((m->len + 1) >= TEST_MAX_LEN)
+		{
+			break;
+		}
+		TEST_CHECK(aPTable_addNewLine(pt));
+		testModel_insert(m, m->cursor, L'\n');
+		++m->cursor;
+		break;
+	case 3:
+	{
+		// Line break is deleted whole, L"\r\n" included
+		const usize eol = testModel_eolLen(m, m->cursor);
+		const usize n = (eol > 0) ? eol : ((m->cursor < m->len) ? 1 : 0);
+		TEST_CHECK(aPTable_deleteForward(pt) == (n > 0));
+		testModel_erase(m, m->cursor, n);
+		break;
+	}
+	case 4:
+	{
+		usize n = (m->cursor > 0) ? 1 : 0;
+		if ((m->cursor >= 2) && (m->text[m->cursor - 1] == L'\n') && (m->text[m->cursor - 2] == L'\r'))
+		{
+			n = 2;
+		}
+		TEST_CHECK(aPTable_deleteBackward(pt) == (n > 0));
+		m->cursor -= n;
+		testModel_erase(m, m->cursor, n);
+		break;
+	}
+	case 5:
+	{
+		const usize lines = testModel_lines(m), line = test_rand(lines);
+		TEST_CHECK(aPTable_mergeNext(pt, line) == ((line + 1) < lines));
+		if ((line + 1) < lines)
+		{
+			const usize next = testModel_lineStart(m, line + 1);
+			const usize eol = ((next >= 2) && (m->text[next - 2] == L'\r')) ? 2 : 1, pos = next - eol;
+			testModel_erase(m, pos, eol);
+			if (m->cursor >= next)
+			{
+				m->cursor -= eol;
+			}
+			else if (m->cursor > pos)
+			{
+				m->cursor = pos;
+			}
+		}
+		break;
+	}
+	case 6:
+		// Keeps L"\r\n" pairs in the document, cursor steps over them at once
+		if ((m->len + 2) >= TEST_MAX_LEN)
+		{
+			break;
+		}
+		TEST_CHECK(aPTable_insert(pt, m->cursor, L"\r\n", 2));
+		aPTable_moveCursor(pt, 1);
+		testModel_insert(m, m->cursor, L'\n');
+		testModel_insert(m, m->cursor, L'\r');
+		m->cursor += 2;
+		break;
+	}
+
+	// Cursor is moved somewhere else now & then
+	if (test_rand(4) == 0)
+	{
+		const usize line = test_rand(testModel_lines(m)), col = test_rand(8);
+		aPTable_setCursor(pt, line, col);
+		const usize start = testModel_lineStart(m, line), len = testModel_lineLen(m, start);
+		m->cursor = start + ((col < len) ? col : len);
+	}
+	return true;
+}
+
+static bool test_run(const wchar * restrict init)
+{
+	// Table takes ownership of its copy of the original text
+	const usize origLen = wcslen(init);
+	wchar * orig = malloc(sizeof(wchar) * (origLen + 1));
+	TEST_CHECK(orig != NULL);
+	memcpy(orig, init, sizeof(wchar) * (origLen + 1));
+
+	static testModel_t model;
+	testModel_t * restrict m = &model;
+	aPTable_t pt;
+	TEST_CHECK(aPTable_init(&pt, orig, origLen));
+	memcpy(m->text, init, sizeof(wchar) * origLen);
+	m->len    = origLen;
+	m->cursor = 0;
+
+	bool ok = test_same(&pt, m, init, origLen);
+	for (usize i = 0; ok && (i < TEST_ROUNDS); ++i)
+	{
+		const usize addLen = pt.add.len;
+		ok = test_edit(&pt, m) && test_same(&pt, m, init, origLen) && (pt.add.len >= addLen);
+	}
+
+	aPTable_destroy(&pt);
+	return ok;
+}
+
+static bool test_fixed(void)
+{
+	// Editing operations on a small document, step by step
+	static const wchar init[] = L"ab\r\ncd\nef";
+	const usize origLen = (sizeof init / sizeof *init) - 1;
+	wchar * orig = malloc(sizeof init);
+	TEST_CHECK(orig != NULL);
+	memcpy(orig, init, sizeof init);
+
+	aPTable_t pt;
+	TEST_CHECK(aPTable_init(&pt, orig, origLen));
+	TEST_CHECK(pt.totalLines == 3);
+
+	wchar * text = NULL;
+	usize cap = 0;
+	bool ok = aPTable_getLine(&pt, 0, &text, &cap) && (wcscmp(text, L"ab") == 0);
+
+	// Typing goes to the add buffer, the typed run is a single piece
+	aPTable_setCursor(&pt, 1, 1);
+	ok = ok && aPTable_addNormalCh(&pt, L'X') && aPTable_addNormalCh(&pt, L'Y') && (pt.numPieces == 3);
+	ok = ok && aPTable_getLine(&pt, 1, &text, &cap) && (wcscmp(text, L"cXYd") == 0);
+
+	// New line splits the line, cursor is at the start of the new line
+	ok = ok && aPTable_addNewLine(&pt) && (pt.totalLines == 4) && (aPTable_curLine(&pt) == 2) && (aPTable_curCol(&pt) == 0);
+
+	// Backspace at the start of a line merges it with the line above
+	ok = ok && aPTable_deleteBackward(&pt) && (pt.totalLines == 3);
+	ok = ok && aPTable_getLine(&pt, 1, &text, &cap) && (wcscmp(text, L"cXYd") == 0);
+
+	// Delete at the end of a line removes L"\r\n" at once
+	aPTable_setCursor(&pt, 0, 99);
+	ok = ok && (pt.cursor == 2) && aPTable_deleteForward(&pt) && (pt.totalLines == 2);
+	ok = ok && aPTable_getLine(&pt, 0, &text, &cap) && (wcscmp(text, L"abcXYd") == 0);
+
+	// Last line can't be merged
+	ok = ok && aPTable_mergeNext(&pt, 0) && !aPTable_mergeNext(&pt, 0) && (pt.totalLines == 1);
+	ok = ok && aPTable_getLine(&pt, 0, &text, &cap) && (wcscmp(text, L"abcXYdef") == 0);
+	ok = ok && (wmemcmp(pt.orig.mem, init, origLen) == 0);
+
+	free(text);
+	aPTable_destroy(&pt);
+	TEST_CHECK(ok);
+	return true;
+}
+
+int main(void)
+{
+	static const wchar * const docs[] = {
+		L"",
+		L"single line",
+		L"first\nsecond\n\nfourth\n",
+		L"crlf\r\nlines\r\n\r\nmixed\nwith lf\r\nand a lone \r in it",
+		L"\ttabs\tand\né 中 unicode\n"
+	};
+
+	test_fixed();
+	for (usize i = 0; i < (sizeof docs / sizeof *docs); ++i)
+	{
+		test_run(docs[i]);
+	}
+
+	if (test_failures > 0)
+	{
+		fprintf(stderr, "aPTable: %zu test(s) failed\n", test_failures);
+		return 1;
+	}
+	printf("aPTable: all tests passed\n");
+	return 0;
+}